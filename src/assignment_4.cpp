@@ -1,9 +1,22 @@
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include "mygl/shader.h"
 #include "mygl/mesh.h"
+#include "mygl/mesharena.h"
 #include "mygl/camera.h"
+#include "mygl/loader.h"
+#include "mygl/material.h"
+#include "mygl/frame.h"
+#include "mygl/renderqueue.h"
+#include "mygl/culling.h"
+#include "mygl/gpuculling.h"
+#include "mygl/impostor.h"
+#include "mygl/occlusion.h"
+#include "mygl/pvs.h"
+#include "mygl/parallel.h"
 
 #include "planet.h"
 #include "plane.h"
@@ -24,6 +37,44 @@ enum eRenderMode
     MODE_COUNT,
 };
 
+/* vertex/index data uploaded per frame while assets are loading */
+const std::size_t UPLOAD_BUDGET_BYTES = 256 * 1024;
+
+/* largest simplification error on screen (in pixels) before a finer level of detail is selected */
+const float LOD_PIXEL_ERROR = 1.0f;
+
+/* parts covering fewer pixels (projected bounding sphere diameter) are not drawn, a size on screen holds for every
+ * camera, so it is not scaled with the distance of BASE_CAM_POSITION */
+const float CONTRIBUTION_PIXELS = 2.0f;
+
+/* instances of props farther away than this (world units to their bounding sphere) are drawn as impostors, the
+ * distance is scaled with - and = at runtime. It is measured from the current camera, the follow camera close to the
+ * plane and the orbit camera starting at BASE_CAM_POSITION both use it */
+const float IMPOSTOR_DISTANCE = 40.0f;
+
+/* pixels per tile side of the impostor atlas */
+const unsigned int IMPOSTOR_TILE_SIZE = 64;
+
+/* planet props with at least this bounding radius keep their triangles on the CPU as occluders, the largest ones on
+ * screen are rasterized into the software depth buffer every frame */
+const float OCCLUDER_RADIUS = 1.5f;
+const std::size_t OCCLUDER_COUNT = 16;
+
+/* threads rasterizing the occluders, kept alive between the frames, the buffer only has OCCLUSION_HEIGHT rows */
+const unsigned int OCCLUSION_THREADS = 4;
+
+/* the potentially visible sets of the planet parts are baked for cameras between the closest triangle of the body and
+ * PVS_BAND_RANGE times its reach from the planet center, split into PVS_BANDS geometrically growing bands, cameras
+ * outside of them keep every part. The sets are sampled and approximate (see Pvs), so they are off by default */
+const unsigned int PVS_BANDS = 4;
+const float PVS_BAND_RANGE = 3.0f;
+
+/* frames a GPU timer query is read back after it was issued */
+const unsigned int GPU_TIMER_LATENCY = 2;
+
+/* interval of the triangle count report in seconds */
+const float LOD_REPORT_INTERVAL = 1.0f;
+
 /* plane light directions */
 const std::vector<Vector3D> planeLightDirs = {
     { 1.0f, 0.0f, 0.0f },  // left wing, red
@@ -44,28 +95,191 @@ const std::vector<Vector3D> planeLightPositions = {
     { 0.0f,    1.4022f, -3.5f  }   // rudder, red strobe
 };
 
+/* shader program of the scene with the handles of the uniforms that are set every frame */
+struct SceneProgram
+{
+    ShaderProgram shader;
+
+    /* per draw uniforms, set by the render queue */
+    RenderProgram render;
+
+    /* normal.frag only */
+    UniformHandle isFlag;
+
+    /* flag.vert only */
+    UniformHandle amplitudes[3], phases[3], frequencies[3], directions[3];
+    UniformHandle zPosMin, accumTime;
+};
+
+/* ScenePart::pvsPart of the parts that have no bit in the planet PVS, pvsVisible(...) keeps them visible */
+const std::size_t NO_PVS_PART = std::numeric_limits<std::size_t>::max();
+
+/* part of an object drawn in the current frame */
+struct ScenePart
+{
+    const SceneProgram* program;
+    const SceneProgram* depthProgram;  // of the depth pre-pass, nullptr if the pre-pass is off
+    const Model* model;
+    Matrix4D transformation;
+    unsigned int matrix;     // transform id in the render queue, instances get theirs only if they are visible on the CPU
+    bool instance;           // one of the instances of its model, the parts of all instances are consecutive
+    bool impostor;           // instance drawn as impostor, they follow the other instances of their model
+    std::size_t firstRange;  // index of the volume of its first material range in the range cull list
+    std::size_t pvsPart;     // bit of the part in the planet PVS, parts that are not in it have no bit
+};
+
+/* sets the per frame uniforms of a scene program */
+void sceneProgramBind(const SceneProgram& program, bool normal, bool flag);
+
+/* looks up the uniform handles of a scene program, uniforms are required depending on the shaders it is built from */
+SceneProgram sceneProgramCreate(const ShaderProgram& shader, bool normal, bool flag)
+{
+    SceneProgram program;
+    program.shader = shader;
+
+    program.render.id = shader.id;
+    program.render.posScale = shaderUniformHandle(shader, "uPosScale");
+    program.render.posOffset = shaderUniformHandle(shader, "uPosOffset");
+    program.render.packedVertex = shaderUniformHandle(shader, "uPackedVertex", normal && !flag);
+
+    program.isFlag = shaderUniformHandle(shader, "isFlag", normal);
+
+    for (int i = 0; i < 3; i++)
+    {
+        const std::string index = "[" + std::to_string(i) + "]";
+        program.amplitudes[i] = shaderUniformHandle(shader, "amplitudes" + index, flag);
+        program.phases[i] = shaderUniformHandle(shader, "phases" + index, flag);
+        program.frequencies[i] = shaderUniformHandle(shader, "frequencies" + index, flag);
+        program.directions[i] = shaderUniformHandle(shader, "directions" + index, flag);
+    }
+    program.zPosMin = shaderUniformHandle(shader, "zPosMin", flag);
+    program.accumTime = shaderUniformHandle(shader, "accumTime", flag);
+
+    /* per frame uniforms, set when the render queue binds the program */
+    program.render.bind = [program, normal, flag]() { sceneProgramBind(program, normal, flag); };
+
+    return program;
+}
+
 /* struct holding all necessary state variables of the scene */
 struct
 {
     /* camera */
     Camera camera;
+    FrameUniforms frame;   // camera matrices and time shared by all programs
+    float time;
     eCameraFollow cameraFollow;
     float zoomSpeedMultiplier;
 
+    /* background loading of meshes and shaders */
+    AssetLoader loader;
+    bool loading;
+    double loadStart;
+
+    /* shared buffers of the planet and plane meshes */
+    MeshArena arena;
+
+    /* triangles drawn per level of detail since the last report */
+    std::vector<std::size_t> lodTriangles;
+    unsigned int lodFrames;
+    float lodReportTime;
+    float reportInterval;  // seconds between reports
+
+    /* single submission path of all draws, statistics summed since the last report */
+    RenderQueue queue;
+    RenderQueueStats queueStats;
+
+    /* frustum and horizon culling of the parts and material ranges (toggled with C), statistics since the last report */
+    bool culling;
+    std::vector<ScenePart> parts;
+    CullList cullParts;
+    CullList cullRanges;
+    std::size_t cullRangesVisible;
+    std::size_t cullRangesTotal;
+    std::size_t cullPartsHorizon;     // parts inside the frustum but behind the planet
+    std::size_t cullPartsSmall;       // parts below CONTRIBUTION_PIXELS
+    std::size_t cullPartsPvs;         // parts not in the PVS of the camera cell, instances also outside the frustum
+    std::size_t cullPartsTotal;
+
+    /* instances of instanced models are culled on the GPU instead (toggled with G), statistics since the last report */
+    bool gpuCulling;
+    GpuCuller gpuCuller;
+    std::size_t gpuInstancesVisible;  // counted GPU_CULL_LATENCY frames late
+    std::size_t gpuInstancesTotal;
+
+    /* single parts with meshlets are culled per meshlet (toggled with M), statistics since the last report */
+    bool meshletCulling;
+    CullList cullMeshlets;
+    std::vector<IndexRange> meshletRuns;
+    MeshletCullStats meshletStats;
+
+    /* software occlusion culling against the largest props on screen (toggled with O), statistics in its buffer */
+    bool occlusionCulling;
+    OcclusionBuffer occlusion;
+    ParallelPool occlusionWorkers;
+    CullList cullOccluders;
+    std::vector<std::pair<float, std::size_t>> occluders;
+
+    /* parts of the planet that are potentially visible from the cell of the camera (toggled with V), baked or loaded
+     * from the cache once the planet is loaded */
+    bool pvsCulling;
+    Pvs pvs;
+
+    /* distant instances of props are drawn as impostors (toggled with I), statistics since the last report */
+    bool impostorsEnabled;
+    float impostorDistance;
+    ImpostorAtlas impostors;
+    ShaderProgram shaderImpostor;
+    RenderProgram impostorProgram;
+    UniformHandle impostorNormals;
+    std::size_t impostorInstances;
+
+    /* depth pre-pass (toggled with Z), GPU time of the render queue submission since the last report */
+    bool depthPrepass;
+    GLuint gpuTimers[GPU_TIMER_LATENCY];
+    unsigned int gpuTimerFrame;
+    double gpuTime;             // in ms
+    unsigned int gpuTimeFrames;
+
     /* planet */
     Planet planet;
 
     /* plane */
     Plane plane;
+    std::vector<Matrix4D> palette;  // part transforms of the current frame
 
     /* shader */
-    ShaderProgram shaderColor;
-    ShaderProgram shaderNormal;
-    ShaderProgram shaderFlagColor; // TODO: Add shaders for rendering the Flag
-    ShaderProgram shaderFlagNormal;
+    SceneProgram shaderColor;
+    SceneProgram shaderNormal;
+    SceneProgram shaderFlagColor;
+    SceneProgram shaderFlagNormal;
+    SceneProgram shaderDepth;
+    SceneProgram shaderFlagDepth;
     eRenderMode renderMode;
 } sScene;
 
+void sceneProgramBind(const SceneProgram& program, bool normal, bool flag)
+{
+    /* the normal shader flips flag normals that face away from the camera */
+    if (normal)
+    {
+        shaderUniform(program.isFlag, flag);
+    }
+
+    /* wave parameters and time for the displacement in flag.vert */
+    if (flag)
+    {
+        for (int i = 0; i < 3; i++) {
+            shaderUniform(program.amplitudes[i], sScene.plane.flagSim.parameter[i].amplitude);
+            shaderUniform(program.phases[i], sScene.plane.flagSim.parameter[i].phi);
+            shaderUniform(program.frequencies[i], sScene.plane.flagSim.parameter[i].omega);
+            shaderUniform(program.directions[i], sScene.plane.flagSim.parameter[i].direction);
+        }
+        shaderUniform(program.zPosMin, sScene.plane.flag.minPosZ);
+        shaderUniform(program.accumTime, sScene.plane.flagSim.accumTime);
+    }
+}
+
 /* struct holding all state variables for input */
 struct
 {
@@ -153,6 +367,70 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
     {
         sScene.renderMode = static_cast<eRenderMode>((static_cast<int>(sScene.renderMode) + 1) % eRenderMode::MODE_COUNT);
     }
+
+    /* toggle culling to compare the submitted ranges */
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+    {
+        sScene.culling = !sScene.culling;
+        std::cout << "[Culling] frustum and horizon culling " << (sScene.culling ? "on" : "off") << std::endl;
+    }
+
+    /* toggle culling of the instances on the GPU to compare it with the CPU culling */
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+    {
+        sScene.gpuCulling = !sScene.gpuCulling;
+        std::cout << "[Culling] GPU culling of instances " << (sScene.gpuCulling ? "on" : "off")
+                  << (sScene.gpuCuller.indirect ? "" : " (not supported, culled on the CPU)") << std::endl;
+    }
+
+    /* toggle culling of single parts per meshlet to compare it with culling whole material ranges */
+    if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    {
+        sScene.meshletCulling = !sScene.meshletCulling;
+        std::cout << "[Culling] meshlet culling " << (sScene.meshletCulling ? "on" : "off") << std::endl;
+    }
+
+    /* toggle the software occlusion buffer */
+    if (key == GLFW_KEY_O && action == GLFW_PRESS)
+    {
+        sScene.occlusionCulling = !sScene.occlusionCulling;
+        std::cout << "[Culling] occlusion culling " << (sScene.occlusionCulling ? "on" : "off") << std::endl;
+    }
+
+    /* toggle the lookup of the potentially visible sets */
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    {
+        sScene.pvsCulling = !sScene.pvsCulling;
+        std::cout << "[Culling] potentially visible sets (approximate) " << (sScene.pvsCulling ? "on" : "off") << std::endl;
+    }
+
+    /* toggle impostors and move the distance they start at */
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    {
+        sScene.impostorsEnabled = !sScene.impostorsEnabled;
+        std::cout << "[Impostor] impostors " << (sScene.impostorsEnabled ? "on" : "off") << std::endl;
+    }
+    if ((key == GLFW_KEY_MINUS || key == GLFW_KEY_EQUAL) && action == GLFW_PRESS)
+    {
+        sScene.impostorDistance *= key == GLFW_KEY_EQUAL ? 1.25f : 0.8f;
+        std::cout << "[Impostor] impostors beyond " << sScene.impostorDistance << " units" << std::endl;
+    }
+
+    /* toggle merging of draws with identical state to compare it with one draw call per range */
+    if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    {
+        sScene.queue.merge = !sScene.queue.merge;
+        std::cout << "[RenderQueue] multi draw merging " << (sScene.queue.merge ? "on" : "off") << std::endl;
+    }
+
+    /* toggle the depth pre-pass to compare the shading it saves with the vertex work it adds */
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+    {
+        sScene.depthPrepass = !sScene.depthPrepass;
+        sScene.gpuTime = 0.0;
+        sScene.gpuTimeFrames = 0;
+        std::cout << "[Depth] depth pre-pass " << (sScene.depthPrepass ? "on" : "off") << std::endl;
+    }
 }
 
 /* GLFW callback function for mouse position events */
@@ -194,30 +472,258 @@ void windowResizeCallback(GLFWwindow *window, int width, int height)
     sScene.camera.height = static_cast<float>(height);
 }
 
-/* function to setup and initialize the whole scene */
-void sceneInit(float width, float height)
+/* function to setup and initialize the whole scene, the meshes only get position streams if the depth pre-pass starts
+ * enabled, toggling it on later draws the depth pass from the interleaved vertices */
+void sceneInit(float width, float height, bool depthPrepass)
 {
     /* initialize camera */
     sScene.camera = cameraCreate(width, height, BASE_FOV, 0.1f, 350.0f, sScene.plane.basePosition + BASE_CAM_FOLLOW_OFFSET, sScene.plane.basePosition);
     sScene.cameraFollow = eCameraFollow::PLANE;
     sScene.zoomSpeedMultiplier = 0.05f;
+    sScene.frame = frameUniformsCreate();
+    sScene.time = 0.0f;
+
+    /* setup objects in scene, shaders and meshes are loaded in the background and appear once they are uploaded */
+    sScene.arena = meshArenaCreate(VertexPacked, 1 << 16, 1 << 20, depthPrepass);
+    sScene.plane = planeCreate();
+    sScene.loading = true;
+    sScene.loadStart = glfwGetTime();
+    sScene.culling = true;
+    sScene.gpuCulling = true;
+    sScene.meshletCulling = true;
+    sScene.occlusionCulling = true;
+    sScene.occlusion = occlusionBufferCreate(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+    parallelPoolStart(sScene.occlusionWorkers, std::min(parallelThreadCount(), OCCLUSION_THREADS));
+    sScene.pvsCulling = false;
+    sScene.impostorsEnabled = true;
+    sScene.impostorDistance = IMPOSTOR_DISTANCE;
+    sScene.depthPrepass = depthPrepass;
+    sScene.reportInterval = LOD_REPORT_INTERVAL;
+    glGenQueries(GPU_TIMER_LATENCY, sScene.gpuTimers);
+    sScene.gpuTimerFrame = 0;
+    sScene.gpuTime = 0.0;
+    sScene.gpuTimeFrames = 0;
+    loaderStart(sScene.loader);
 
-    /* setup objects in scene and create opengl buffers for meshes */
-    sScene.plane = planeLoad("assets/plane/cartoon-plane.obj", "assets/plane/flag_uibk.obj");
-    sScene.planet = planetLoad("assets/planet/cute-little-planet.obj");
+    /* the culling programs are small and compiled right away */
+    sScene.gpuCuller = gpuCullerCreate(shaderLoadFeedback("shader/cull.vert", "shader/cull.geom", {"tTransformId"}),
+                                       shaderLoadFeedback("shader/cullcommand.vert", "",
+                                                          {"tCount", "tInstanceCount", "tFirstIndex", "tBaseVertex", "tBaseInstance"}));
+    if (!sScene.gpuCuller.indirect)
+    {
+        std::cout << "[Culling] no GL_ARB_draw_indirect, instances are culled on the CPU" << std::endl;
+    }
 
     /* load shader from file */
-    sScene.shaderColor = shaderLoad("shader/default.vert", "shader/color.frag");
-    sScene.shaderNormal = shaderLoad("shader/default.vert", "shader/normal.frag");
-    sScene.shaderFlagColor = shaderLoad("shader/flag.vert", "shader/color.frag");
-    sScene.shaderFlagNormal = shaderLoad("shader/flag.vert", "shader/normal.frag");
+    loaderRequestShader(sScene.loader, "shader/default.vert", "shader/color.frag", [](const ShaderProgram& shader) { sScene.shaderColor = sceneProgramCreate(shader, false, false); });
+    loaderRequestShader(sScene.loader, "shader/default.vert", "shader/normal.frag", [](const ShaderProgram& shader) { sScene.shaderNormal = sceneProgramCreate(shader, true, false); });
+    loaderRequestShader(sScene.loader, "shader/flag.vert", "shader/color.frag", [](const ShaderProgram& shader) { sScene.shaderFlagColor = sceneProgramCreate(shader, false, true); });
+    loaderRequestShader(sScene.loader, "shader/flag.vert", "shader/normal.frag", [](const ShaderProgram& shader) { sScene.shaderFlagNormal = sceneProgramCreate(shader, true, true); });
+    loaderRequestShader(sScene.loader, "shader/impostor.vert", "shader/impostor.frag", [](const ShaderProgram& shader)
+    {
+        sScene.shaderImpostor = shader;
+        sScene.impostorProgram.id = shader.id;
+        sScene.impostorProgram.posScale = shaderUniformHandle(shader, "uPosScale", false);
+        sScene.impostorProgram.posOffset = shaderUniformHandle(shader, "uPosOffset", false);
+        sScene.impostorNormals = shaderUniformHandle(shader, "uNormals");
+        sScene.impostorProgram.bind = []()
+        {
+            impostorAtlasBind(sScene.impostors);
+            shaderUniform(sScene.impostorNormals, sScene.renderMode == eRenderMode::NORMAL);
+        };
+    });
+    loaderRequestShader(sScene.loader, "shader/depth.vert", "shader/depth.frag", [](const ShaderProgram& shader)
+    {
+        sScene.shaderDepth = sceneProgramCreate(shader, false, false);
+        sScene.shaderDepth.render.positionStream = true;
+    });
+    loaderRequestShader(sScene.loader, "shader/flag.vert", "shader/depth.frag", [](const ShaderProgram& shader)
+    {
+        sScene.shaderFlagDepth = sceneProgramCreate(shader, false, true);
+        sScene.shaderFlagDepth.render.positionStream = true;
+    });
+
+    /* load meshes */
+    ModelLoadOptions arenaOptions;
+    arenaOptions.arena = &sScene.arena;
+    ModelLoadOptions planetOptions = arenaOptions;
+    planetOptions.sharedQuantization = true;  // all parts decode with the same uniforms, required for batching
+    planetOptions.instanceObjects = true;     // props are placed many times with different transformations
+    planetOptions.buildMeshlets = true;       // the planet body and the large props are culled per meshlet
+    planetOptions.occluderRadius = OCCLUDER_RADIUS;
+    loaderRequestModel(sScene.loader, "assets/plane/cartoon-plane.obj", planeLoadOptions(&sScene.arena), [](const Model& model) { planeSetModel(sScene.plane, model); });
+    loaderRequestModel(sScene.loader, "assets/plane/flag_uibk.obj", flagLoadOptions(), [](const Model& model) { sScene.plane.flag = flagCreate(model); });
+    loaderRequestModel(sScene.loader, "assets/planet/cute-little-planet.obj", planetOptions, [](const Model& model) { planetAddPart(sScene.planet, model); });
 
     sScene.renderMode = eRenderMode::COLOR;
 }
 
+/* renders the views of every prop that is placed more than once, once all models and shaders are loaded */
+void sceneBakeImpostors()
+{
+    std::vector<const Model*> props;
+    for (const auto& model : sScene.planet.partModel)
+    {
+        if (model.instances.size() > 1)
+        {
+            props.push_back(&model);
+        }
+    }
+
+    const double start = glfwGetTime();
+    sScene.impostors = impostorAtlasCreate(props, sScene.shaderColor.render, sScene.shaderNormal.render, IMPOSTOR_TILE_SIZE);
+    std::cout << "[Impostor] rendered " << IMPOSTOR_YAW_STEPS * IMPOSTOR_PITCH_STEPS << " views of " << props.size()
+              << " props in " << (glfwGetTime() - start) * 1000.0 << " ms" << std::endl;
+}
+
+/* loads the potentially visible sets of the planet parts from the cache next to the planet or bakes them on a loader
+ * worker, the parts are in the order recordScene(...) adds them. Every part stays visible until the sets are installed.
+ * The bake only reads the CPU copies of the models (bounding boxes and occluder triangles), which stay unchanged after
+ * loading. */
+void sceneBakePvs()
+{
+    if (sScene.planet.bodyPart < 0)
+    {
+        return;
+    }
+
+    std::vector<PvsPart> parts;
+    for (const auto& model : sScene.planet.partModel)
+    {
+        if (model.instances.empty())
+        {
+            parts.push_back({&model, Matrix4D::identity()});
+        }
+        for (const auto& instance : model.instances)
+        {
+            parts.push_back({&model, instance});
+        }
+    }
+
+    /* the bands start at the surface, so cameras close to it have a cell, samples below it keep every part */
+    const Model& body = sScene.planet.partModel[sScene.planet.bodyPart];
+    const float inner = body.originDistance;
+    const float outer = PVS_BAND_RANGE * (length(body.mesh.boundsCenter) + body.mesh.boundsRadius);
+    std::vector<float> bands;
+    for (unsigned int i = 0; i <= PVS_BANDS; i++)
+    {
+        bands.push_back(inner * std::pow(outer / inner, static_cast<float>(i) / PVS_BANDS));
+    }
+
+    sScene.pvs = Pvs{};
+    loaderRequestTask(sScene.loader, [parts, bands](const std::atomic<bool>& stop) -> std::function<void()>
+    {
+        /* one core less than available, the OpenGL thread keeps rendering meanwhile */
+        const unsigned int threadCount = std::max(parallelThreadCount(), 2u) - 1;
+        auto pvs = std::make_shared<Pvs>(pvsLoad(pvsCachePath("assets/planet/cute-little-planet.obj"), parts, bands, PVS_FACE_CELLS,
+                                                 threadCount, &stop));
+        return [pvs] { sScene.pvs = std::move(*pvs); };
+    });
+}
+
+/* clears the statistics summed since the last report */
+void sceneResetStats()
+{
+    std::fill(sScene.lodTriangles.begin(), sScene.lodTriangles.end(), 0);
+    sScene.lodFrames = 0;
+    sScene.lodReportTime = 0.0f;
+    sScene.queueStats = RenderQueueStats{};
+    sScene.cullRangesVisible = 0;
+    sScene.cullRangesTotal = 0;
+    sScene.cullPartsHorizon = 0;
+    sScene.cullPartsSmall = 0;
+    sScene.cullPartsPvs = 0;
+    sScene.impostorInstances = 0;
+    sScene.cullPartsTotal = 0;
+    sScene.gpuInstancesVisible = 0;
+    sScene.gpuInstancesTotal = 0;
+    sScene.meshletStats = MeshletCullStats{};
+    sScene.occlusion.stats = OcclusionStats{};
+    sScene.gpuTime = 0.0;
+    sScene.gpuTimeFrames = 0;
+}
+
+/* prints the statistics summed since the last report as averages per frame and starts the next interval */
+void sceneReportStats()
+{
+    std::size_t total = 0;
+    std::cout << "[LOD] triangles per frame:";
+    for (std::size_t lod = 0; lod < sScene.lodTriangles.size(); lod++)
+    {
+        std::cout << " LOD" << lod << " " << sScene.lodTriangles[lod] / sScene.lodFrames;
+        total += sScene.lodTriangles[lod];
+    }
+    std::cout << ", total " << total / sScene.lodFrames << std::endl;
+
+    const RenderQueueStats& stats = sScene.queueStats;
+    std::cout << "[RenderQueue] per frame: " << stats.commands / sScene.lodFrames << " commands in "
+              << stats.drawCalls / sScene.lodFrames << " draw calls (" << stats.instances / sScene.lodFrames
+              << " instances, " << stats.indirectDraws / sScene.lodFrames << " indirect), " << stats.stateChanges / sScene.lodFrames
+              << " state changes (" << (stats.unsortedStateChanges - stats.stateChanges) / sScene.lodFrames
+              << " avoided by sorting)" << std::endl;
+    std::cout << "[Culling] ranges per frame: " << sScene.cullRangesVisible / sScene.lodFrames << " visible of "
+              << sScene.cullRangesTotal / sScene.lodFrames << " submitted, "
+              << sScene.cullPartsHorizon / sScene.lodFrames << " of " << sScene.cullPartsTotal / sScene.lodFrames
+              << " parts behind the planet horizon, " << sScene.cullPartsSmall / sScene.lodFrames << " below "
+              << CONTRIBUTION_PIXELS << " pixels, " << sScene.cullPartsPvs / sScene.lodFrames
+              << " not potentially visible" << std::endl;
+    if (sScene.impostorInstances > 0)
+    {
+        std::cout << "[Impostor] instances per frame drawn as impostors: " << sScene.impostorInstances / sScene.lodFrames
+                  << std::endl;
+    }
+    if (sScene.gpuInstancesTotal > 0)
+    {
+        std::cout << "[Culling] instances per frame culled on the GPU: " << sScene.gpuInstancesVisible / sScene.lodFrames
+                  << " visible of " << sScene.gpuInstancesTotal / sScene.lodFrames << std::endl;
+    }
+    if (sScene.occlusion.stats.occluders > 0)
+    {
+        const OcclusionStats& occlusion = sScene.occlusion.stats;
+        std::cout << "[Culling] occlusion per frame: " << occlusion.occluders / sScene.lodFrames << " occluders with "
+                  << occlusion.triangles / sScene.lodFrames << " triangles in " << occlusion.rasterMs / sScene.lodFrames
+                  << " ms, " << occlusion.occluded / sScene.lodFrames << " of " << occlusion.tested / sScene.lodFrames
+                  << " tested volumes hidden" << std::endl;
+    }
+    if (sScene.meshletStats.tested > 0)
+    {
+        const MeshletCullStats& meshlets = sScene.meshletStats;
+        std::cout << "[Culling] meshlets per frame: " << meshlets.tested / sScene.lodFrames << " tested, "
+                  << meshlets.backfacing / sScene.lodFrames << " backfacing, " << meshlets.outside / sScene.lodFrames
+                  << " outside the frustum" << std::endl;
+    }
+    if (sScene.gpuTimeFrames > 0)
+    {
+        std::cout << "[Depth] GPU time per frame " << sScene.gpuTime / sScene.gpuTimeFrames << " ms, pre-pass "
+                  << (sScene.depthPrepass ? "on (" : "off (") << stats.depthCommands / sScene.lodFrames
+                  << " depth commands)" << std::endl;
+    }
+
+    sceneResetStats();
+}
+
 /* function to move and update objects in scene (e.g., rotate cube according to user input) */
 void sceneUpdate(float dt)
 {
+    /* upload assets that finished loading in the background, also after loading for the results of later tasks */
+    const bool loading = loaderUpdate(sScene.loader, UPLOAD_BUDGET_BYTES);
+    if (sScene.loading && !loading)
+    {
+        sScene.loading = false;
+
+        MeshArenaStats arenaStats = meshArenaStats(sScene.arena);
+        std::cout << "[Scene] loaded in " << glfwGetTime() - sScene.loadStart << " s" << std::endl;
+        std::cout << "[MeshArena] " << arenaStats.meshCount << " meshes, vertices " << arenaStats.vertexBytesUsed / 1024 << "/"
+                  << arenaStats.vertexBytesCapacity / 1024 << " KB, indices " << arenaStats.indexBytesUsed / 1024 << "/"
+                  << arenaStats.indexBytesCapacity / 1024 << " KB, fragmentation " << arenaStats.vertexFragmentation << "/"
+                  << arenaStats.indexFragmentation << std::endl;
+
+        sceneBakeImpostors();
+        sceneBakePvs();
+    }
+
+    sScene.time += dt;
+
     planeMove(sScene.plane, sInput.keyPressed, dt);
     planetRotate(sScene.planet, getPlaneTurningVector(sScene.plane), sScene.plane.speed, dt);
 
@@ -237,136 +743,591 @@ void sceneUpdate(float dt)
         sScene.camera.lookAt = inverse(Matrix3D(sScene.planet.rotation)) * sScene.plane.position;
         setCameraRotation(sScene.camera, Matrix3D(sScene.planet.rotation));
     }
+
+    /* select the level of detail of every part from its distance to the camera */
+    sScene.plane.model.lod = modelLodSelect(sScene.plane.model, sScene.plane.transformation, sScene.camera, LOD_PIXEL_ERROR);
+    for (auto& model : sScene.planet.partModel)
+    {
+        if (model.instances.empty())
+        {
+            model.lod = modelLodSelect(model, sScene.planet.transformation, sScene.camera, LOD_PIXEL_ERROR);
+            continue;
+        }
+
+        /* instances share the level of the closest one */
+        unsigned int lod = static_cast<unsigned int>(model.lods.size());
+        for (const auto& instance : model.instances)
+        {
+            lod = std::min(lod, modelLodSelect(model, sScene.planet.transformation * instance, sScene.camera, LOD_PIXEL_ERROR));
+        }
+        model.lod = lod;
+    }
+
+    /* average triangles per frame and level of detail, once per interval (once at the end with --frames) */
+    sScene.lodReportTime += dt;
+    if (sScene.lodReportTime >= sScene.reportInterval && sScene.lodFrames > 0)
+    {
+        sceneReportStats();
+    }
+}
+
+/* adds drawn triangles to the per LOD statistics */
+void countTriangles(unsigned int lod, std::size_t triangles)
+{
+    if (sScene.lodTriangles.size() <= lod)
+    {
+        sScene.lodTriangles.resize(lod + 1, 0);
+    }
+    sScene.lodTriangles[lod] += triangles;
+}
+
+/* view depth of the bounding sphere center of a mesh relative to the far plane, the sort key orders draws by it */
+float drawDepth(const Matrix4D& model, const Mesh& mesh)
+{
+    Vector4D center = sScene.frame.data.view * (model * Vector4D(mesh.boundsCenter, 1.0f));
+    return -center.z / sScene.camera.farPlane;
+}
+
+/* adds a part to the parts of the frame, its model matrix is stored in the render queue */
+void addPart(const SceneProgram& program, const SceneProgram* depthProgram, const Model& model, const Matrix4D& transformation,
+             unsigned int matrix)
+{
+    sScene.parts.push_back({&program, depthProgram, &model, transformation, matrix, false, false, 0, NO_PVS_PART});
+}
+
+/* adds a part for every instance of an instanced model, or a single part with the given transform id */
+void addInstances(const SceneProgram& program, const SceneProgram* depthProgram, const Model& model, const Matrix4D& transformation,
+                  unsigned int matrix)
+{
+    if (model.instances.empty())
+    {
+        addPart(program, depthProgram, model, transformation, matrix);
+        return;
+    }
+    for (const auto& instance : model.instances)
+    {
+        sScene.parts.push_back({&program, depthProgram, &model, transformation * instance, 0, true, false, 0, NO_PVS_PART});
+    }
+}
+
+/* replaces the draw range of a material of a single part by its visible meshlets, consecutive visible meshlets are
+ * joined into one range and the render queue merges the ranges into one multi draw */
+void cullMeshlets(const Frustum& frustum, const ScenePart& part, std::size_t material, std::vector<IndexRange>& ranges)
+{
+    const Model& model = *part.model;
+    const IndexRange span = model.lods[model.lod].meshlets[material];
+    const Meshlet* meshlets = model.meshlets.data() + span.offset;
+    meshletCull(sScene.cullMeshlets, frustum, part.transformation, cameraPosition(sScene.camera), meshlets, span.count,
+                sScene.meshletStats);
+
+    ranges.clear();
+    for (std::size_t i = 0; i < span.count; i++)
+    {
+        if (!sScene.cullMeshlets.visible[i])
+        {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().offset + ranges.back().count == meshlets[i].range.offset)
+        {
+            ranges.back().count += meshlets[i].range.count;
+        }
+        else
+        {
+            ranges.push_back(meshlets[i].range);
+        }
+    }
 }
 
-void renderPlanetAndPlane(ShaderProgram& shader, bool renderNormal) {
-    /* setup camera and model matrices */
-    Matrix4D proj = cameraProjection(sScene.camera); // perspective projection (3D -> 2D coordinates on the screen)
-    Matrix4D view = cameraView(sScene.camera);
+/* records the visible ranges of the parts [begin, end), the parts of instances are drawn with one instanced draw per
+ * range using the consecutive transform ids of their visible instances */
+void recordPartRanges(const Frustum& frustum, std::size_t begin, std::size_t end)
+{
+    const CullList& parts = sScene.cullParts;
+    const CullList& ranges = sScene.cullRanges;
+    const Model& model = *sScene.parts[begin].model;
 
-    glUseProgram(shader.id);
-    shaderUniform(shader, "uProj",  proj);
-    shaderUniform(shader, "uView",  view);
-    shaderUniform(shader, "uModel",  sScene.plane.transformation);
-    if (renderNormal)
+    unsigned int matrix = 0;
+    unsigned int instances = 0;
+    float depth = 1.0f;
+    for (std::size_t p = begin; p < end; p++)
     {
-        shaderUniform(shader, "uViewPos", cameraPosition(sScene.camera));
-        shaderUniform(shader, "isFlag", false);
+        const ScenePart& part = sScene.parts[p];
+        if (!parts.visible[p])
+        {
+            continue;
+        }
+
+        const unsigned int id = part.instance ? renderQueueMatrix(sScene.queue, part.transformation) : part.matrix;
+        matrix = instances == 0 ? id : matrix;
+        instances++;
+        depth = std::min(depth, drawDepth(part.transformation, model.mesh));
     }
 
-    /* render plane */
-    for (unsigned int i = 0; i < sScene.plane.partModel.size(); i++)
+    /* merged models move their parts within the meshlets, instances would need the meshlets of each of them */
+    const bool meshlets = sScene.culling && sScene.meshletCulling && end == begin + 1 && !sScene.parts[begin].instance &&
+                          model.parts.empty() && model.lod < model.lods.size() && !model.lods[model.lod].meshlets.empty();
+
+    for (std::size_t m = 0; m < model.material.size() && instances > 0; m++)
     {
-        auto& model = sScene.plane.partModel[i];
-        auto& transform = sScene.plane.partTransformations[i];
-        glBindVertexArray(model.mesh.vao);
+        /* a range is drawn for all visible instances as soon as it is visible in one of them */
+        std::size_t visible = 0;
+        for (std::size_t p = begin; p < end; p++)
+        {
+            visible += parts.visible[p] && ranges.visible[sScene.parts[p].firstRange + m];
+        }
+        if (visible == 0)
+        {
+            continue;
+        }
 
-        shaderUniform(shader, "uModel", sScene.plane.transformation * transform);
+        std::vector<IndexRange>& ranges = sScene.meshletRuns;
+        if (meshlets)
+        {
+            cullMeshlets(frustum, sScene.parts[begin], m, ranges);
+        }
+        else
+        {
+            ranges.assign(1, modelLodRange(model, model.lod, m));
+        }
 
-        for(auto& material : model.material)
+        for (const auto& range : ranges)
         {
-            if (!renderNormal)
+            RenderCommand command;
+            command.program = &sScene.parts[begin].program->render;
+            command.mesh = &model.mesh;
+            command.matrix = matrix;
+            command.instanceCount = instances;
+            command.range = range;
+            command.materialId = model.material[m].materialId;
+            renderQueuePush(sScene.queue, RenderPassOpaque, command, depth);
+
+            /* the depth pass ignores materials, so ranges of different materials merge into one draw */
+            if (sScene.parts[begin].depthProgram)
             {
-                /* set material properties */
-                shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
+                command.program = &sScene.parts[begin].depthProgram->render;
+                command.materialId = 0;
+                renderQueuePush(sScene.queue, RenderPassDepth, command, depth);
             }
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT, (const void*) (material.indexOffset*sizeof(unsigned int)) );
+
+            countTriangles(model.lod, command.range.count / 3 * instances);
         }
+        sScene.cullRangesVisible += visible;
     }
+}
 
-    /* render planet */
-    for(unsigned int i=0; i < sScene.planet.partModel.size(); i++)
+/* records all ranges of the instances [begin, end) that were culled on the GPU, each range is drawn with one indirect
+ * draw over the visible instances of the group */
+void recordCulledInstances(std::size_t begin, std::size_t end, std::size_t groupIndex)
+{
+    const ScenePart& first = sScene.parts[begin];
+    const Model& model = *first.model;
+    const GpuCullGroup& group = sScene.gpuCuller.groups[groupIndex];
+    sScene.gpuInstancesTotal += group.count;
+    if (group.count == 0)
+    {
+        return;
+    }
+
+    /* which instances are visible is only known on the GPU, the command pass writes their count into the indirect draws,
+     * and the closest of the candidates orders the draws */
+    float depth = 1.0f;
+    for (std::size_t p = begin; p < end; p++)
     {
-        auto& model = sScene.planet.partModel[i];
-        glBindVertexArray(model.mesh.vao);
+        depth = std::min(depth, drawDepth(sScene.parts[p].transformation, model.mesh));
+    }
 
-        shaderUniform(shader, "uModel", sScene.planet.transformation);
+    for (std::size_t m = 0; m < model.material.size(); m++)
+    {
+        RenderCommand command;
+        command.program = &first.program->render;
+        command.mesh = &model.mesh;
+        command.matrix = first.matrix;
+        command.instanceCount = static_cast<unsigned int>(group.count);
+        command.visibleList = static_cast<unsigned int>(group.first) + 1;
+        command.range = modelLodRange(model, model.lod, m);
+        command.indirectCommand = gpuCullAddDraw(sScene.gpuCuller, groupIndex, model.mesh, command.range);
+        command.materialId = model.material[m].materialId;
+        renderQueuePush(sScene.queue, RenderPassOpaque, command, depth);
 
-        for(auto& material : model.material)
+        if (first.depthProgram)
+        {
+            command.program = &first.depthProgram->render;
+            command.materialId = 0;
+            renderQueuePush(sScene.queue, RenderPassDepth, command, depth);
+        }
+
+        countTriangles(model.lod, command.range.count / 3 * group.count);
+        sScene.cullRangesVisible += group.count;
+    }
+}
+
+/* end of the consecutive instances of a model starting at begin, begin + 1 for parts that are no instances, impostors
+ * and full instances of a model are separate runs */
+std::size_t instancesEnd(std::size_t begin)
+{
+    std::size_t end = begin + 1;
+    while (sScene.parts[begin].instance && end < sScene.parts.size() && sScene.parts[end].instance &&
+           sScene.parts[end].model == sScene.parts[begin].model && sScene.parts[end].impostor == sScene.parts[begin].impostor)
+    {
+        end++;
+    }
+    return end;
+}
+
+/* records the impostors of the instances [begin, end), with GPU culling as an indirect draw over the visible instances of
+ * their group, else (group -1) with the consecutive transform ids of the instances that passed the CPU culling */
+void recordImpostors(std::size_t begin, std::size_t end, int group)
+{
+    const ScenePart& first = sScene.parts[begin];
+    const int entry = impostorAtlasFind(sScene.impostors, first.model);
+
+    RenderCommand command;
+    command.program = &sScene.impostorProgram;
+    command.mesh = &sScene.impostors.quads;
+    command.range = sScene.impostors.ranges[entry];
+    float depth = 1.0f;
+    if (group >= 0)
+    {
+        const GpuCullGroup& candidates = sScene.gpuCuller.groups[group];
+        sScene.gpuInstancesTotal += candidates.count;
+        command.matrix = first.matrix;
+        command.instanceCount = static_cast<unsigned int>(candidates.count);
+        command.visibleList = static_cast<unsigned int>(candidates.first) + 1;
+        command.indirectCommand = candidates.count > 0 ? gpuCullAddDraw(sScene.gpuCuller, group, *command.mesh, command.range) : 0;
+        for (std::size_t p = begin; p < end; p++)
+        {
+            depth = std::min(depth, drawDepth(sScene.parts[p].transformation, first.model->mesh));
+        }
+    }
+    else
+    {
+        command.instanceCount = 0;
+        for (std::size_t p = begin; p < end; p++)
         {
-            if (!renderNormal)
+            const ScenePart& part = sScene.parts[p];
+            if (!sScene.cullParts.visible[p])
             {
-                /* set material properties */
-                shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
+                continue;
             }
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT, (const void*) (material.indexOffset*sizeof(unsigned int)) );
+            const unsigned int id = renderQueueMatrix(sScene.queue, part.transformation);
+            command.matrix = command.instanceCount == 0 ? id : command.matrix;
+            command.instanceCount++;
+            depth = std::min(depth, drawDepth(part.transformation, first.model->mesh));
         }
     }
+    if (command.instanceCount == 0)
+    {
+        return;
+    }
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    renderQueuePush(sScene.queue, RenderPassOpaque, command, depth);
+    if (first.depthProgram)
+    {
+        renderQueuePush(sScene.queue, RenderPassDepth, command, depth);
+    }
+    sScene.impostorInstances += command.instanceCount;
 }
 
-void renderFlag(ShaderProgram& shader, bool renderNormal) {
+/* flags the instances of props in the impostor atlas that are farther away than the impostor distance and moves them
+ * behind the other instances of their model, so both stay consecutive */
+void markImpostors()
+{
+    if (!sScene.impostorsEnabled || sScene.impostors.models.empty())
+    {
+        return;
+    }
+
+    const Vector3D eye = cameraPosition(sScene.camera);
+    for (std::size_t begin = 0, end = 0; begin < sScene.parts.size(); begin = end)
+    {
+        end = instancesEnd(begin);
+        if (!sScene.parts[begin].instance || impostorAtlasFind(sScene.impostors, sScene.parts[begin].model) < 0)
+        {
+            continue;
+        }
 
-    /* setup camera and model matrices */
-    Matrix4D proj = cameraProjection(sScene.camera); // perspective projection (3D -> 2D coordinates on the screen)
-    Matrix4D view = cameraView(sScene.camera);
+        for (std::size_t p = begin; p < end; p++)
+        {
+            ScenePart& part = sScene.parts[p];
+            const Mesh& mesh = part.model->mesh;
+            const Vector3D center = Vector3D(part.transformation * Vector4D(mesh.boundsCenter, 1.0f));
+            const float radius = mesh.boundsRadius * length(Vector3D(part.transformation * Vector4D(1.0f, 0.0f, 0.0f, 0.0f)));
+            part.impostor = length(center - eye) - radius > sScene.impostorDistance;
+        }
+        std::stable_partition(sScene.parts.begin() + static_cast<std::ptrdiff_t>(begin),
+                              sScene.parts.begin() + static_cast<std::ptrdiff_t>(end),
+                              [](const ScenePart& part) { return !part.impostor; });
+    }
+}
+
+/* rasterizes the parts with occluder triangles that cover the most of the screen into the occlusion buffer, parts
+ * drawn as impostors only match their model roughly and are skipped */
+void rasterizeOccluders()
+{
+    occlusionClear(sScene.occlusion, sScene.frame.data.viewProj);
 
-    glUseProgram(shader.id);
-    shaderUniform(shader, "uProj",  proj);
-    shaderUniform(shader, "uView",  view);
-    shaderUniform(shader, "uModel",  sScene.plane.transformation);
-    if (renderNormal)
+    CullList& candidates = sScene.cullOccluders;
+    cullListClear(candidates);
+    for (const auto& part : sScene.parts)
     {
-        shaderUniform(shader, "uViewPos", cameraPosition(sScene.camera));
-        shaderUniform(shader, "isFlag", false);
+        cullListAddSphere(candidates, part.transformation, part.model->mesh.boundsCenter, part.model->mesh.boundsRadius);
     }
+    frustumCull(frustumCreate(sScene.frame.data.viewProj), candidates);
 
-    /* render flag */
+    /* angular size of the bounding spheres, the closest parts are kept even if the camera is inside them */
+    const Vector3D eye = cameraPosition(sScene.camera);
+    sScene.occluders.clear();
+    for (std::size_t p = 0; p < sScene.parts.size(); p++)
     {
-        auto& model = sScene.plane.flag.model;
-        // uModel: Transforms local vertices to world space coordinates!
-        shaderUniform(shader, "uModel", sScene.plane.transformation * sScene.plane.flagModelMatrix * sScene.plane.flagNegativeRotation);
-        glBindVertexArray(model.mesh.vao);
+        const ScenePart& part = sScene.parts[p];
+        if (!candidates.visible[p] || part.impostor || part.model->occluderIndices.empty())
+        {
+            continue;
+        }
+        const Vector3D center(candidates.centerX[p], candidates.centerY[p], candidates.centerZ[p]);
+        sScene.occluders.push_back({candidates.radius[p] / std::max(length(center - eye), 1e-3f), p});
+    }
 
-        // TODO: Pass the wave parameter and time as uniforms to the shader for displacement calculations
-        for (int i = 0; i < 3; i++) {
-            shaderUniform(shader, "amplitudes[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].amplitude);
-            shaderUniform(shader, "phases[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].phi);
-            shaderUniform(shader, "frequencies[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].omega);
-            shaderUniform(shader, "directions[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].direction);
+    const std::size_t count = std::min(sScene.occluders.size(), OCCLUDER_COUNT);
+    std::partial_sort(sScene.occluders.begin(), sScene.occluders.begin() + static_cast<std::ptrdiff_t>(count),
+                      sScene.occluders.end(), std::greater<>());
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const ScenePart& part = sScene.parts[sScene.occluders[i].second];
+        const Model& model = *part.model;
+        occlusionAddOccluder(sScene.occlusion, part.transformation, model.occluderPositions.data(), model.occluderIndices.data(),
+                             model.occluderIndices.size());
+    }
+    occlusionRasterize(sScene.occlusion, &sScene.occlusionWorkers);
+}
+
+/* culling of the parts of the frame: first the bounding sphere of every part against the frustum and the planet
+ * horizon, then the boxes of the material ranges of the visible parts against the frustum, only the ranges that pass
+ * all tests are recorded, split into the meshlets that are inside the frustum and not backfacing. Parts below
+ * CONTRIBUTION_PIXELS, behind the occluders or not in the PVS of the camera cell are dropped and distant instances of
+ * props are drawn as impostors. With GPU culling the spheres of the instances are tested by the culling pass instead,
+ * their ranges are not culled on their own, only instances behind the occluders or not in the PVS are left out of the
+ * pass */
+void recordParts()
+{
+    markImpostors();
+
+    const bool occlusion = sScene.culling && sScene.occlusionCulling;
+    if (occlusion)
+    {
+        rasterizeOccluders();
+    }
+
+    const Frustum frustum = frustumCreate(sScene.frame.data.viewProj);
+    /* without indirect draws the instances are culled on the CPU */
+    const bool gpuCulling = sScene.culling && sScene.gpuCulling && sScene.gpuCuller.indirect;
+
+    /* cell of the camera in planet space, -1 keeps every part */
+    int cell = -1;
+    if (sScene.culling && sScene.pvsCulling)
+    {
+        const Vector4D eye = inverse(sScene.planet.transformation) * Vector4D(cameraPosition(sScene.camera), 1.0f);
+        cell = pvsCell(sScene.pvs, Vector3D(eye));
+    }
+
+    CullList& parts = sScene.cullParts;
+    cullListClear(parts);
+    for (const auto& part : sScene.parts)
+    {
+        if (gpuCulling && part.instance)
+        {
+            /* empty boxes are never visible on the CPU */
+            cullListAddBox(parts, part.transformation, MeshBox{});
+        }
+        else
+        {
+            cullListAddSphere(parts, part.transformation, part.model->mesh.boundsCenter, part.model->mesh.boundsRadius);
+        }
+        sScene.cullRangesTotal += part.model->material.size();
+    }
+    sScene.cullPartsTotal += sScene.parts.size();
+
+    if (sScene.culling)
+    {
+        frustumCull(frustum, parts);
+        for (std::size_t p = 0; p < sScene.parts.size(); p++)
+        {
+            if (parts.visible[p] && !pvsVisible(sScene.pvs, cell, sScene.parts[p].pvsPart))
+            {
+                parts.visible[p] = 0;
+                sScene.cullPartsPvs++;
+            }
         }
-        shaderUniform(shader, "zPosMin", sScene.plane.flag.minPosZ);
-        shaderUniform(shader, "accumTime", sScene.plane.flagSim.accumTime);
 
-        for(auto& material : model.material)
+        /* the planet body hides everything behind its horizon, including parts of the plane */
+        sScene.cullPartsHorizon += horizonCull(parts, cameraPosition(sScene.camera), sScene.planet.position,
+                                                planetOccluderRadius(sScene.planet));
+        sScene.cullPartsSmall += contributionCull(parts, cameraPosition(sScene.camera), cameraPixelScale(sScene.camera),
+                                                  CONTRIBUTION_PIXELS);
+        if (occlusion)
+        {
+            occlusionCull(sScene.occlusion, parts);
+        }
+    }
+    else
+    {
+        parts.visible.assign(sScene.parts.size(), 1);
+    }
+
+    CullList& ranges = sScene.cullRanges;
+    cullListClear(ranges);
+    for (std::size_t p = 0; p < sScene.parts.size(); p++)
+    {
+        ScenePart& part = sScene.parts[p];
+        part.firstRange = ranges.radius.size();
+        for (std::size_t m = 0; m < part.model->material.size() && parts.visible[p]; m++)
         {
-            if (!renderNormal)
+            /* parts of merged models move against each other (e.g. the propeller spins within the bounding sphere of
+             * the plane), so their ranges are only culled as a whole */
+            if (part.model->parts.empty())
             {
-                /* set material properties */
-                shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
-                // TODO: Add the wave parameters as uniforms (they act as constants within a draw call)
-                // shaderUniform()sScene.plane.flag.vertices
+                cullListAddBox(ranges, part.transformation, part.model->materialBounds[m].box);
             }
             else
             {
-                shaderUniform(shader, "isFlag", true);
+                cullListAddSphere(ranges, part.transformation, part.model->mesh.boundsCenter, part.model->mesh.boundsRadius);
             }
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT, (const void*) (material.indexOffset*sizeof(unsigned int)) );
         }
     }
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    if (sScene.culling)
+    {
+        frustumCull(frustum, ranges);
+        if (occlusion)
+        {
+            occlusionCull(sScene.occlusion, ranges);
+        }
+    }
+    else
+    {
+        ranges.visible.assign(ranges.radius.size(), 1);
+    }
+
+    /* one group per instanced model, every instance gets a transform id whether it is visible or not */
+    GpuCuller& culler = sScene.gpuCuller;
+    if (gpuCulling)
+    {
+        gpuCullClear(culler);
+        for (std::size_t begin = 0, end = 0; begin < sScene.parts.size(); begin = end)
+        {
+            end = instancesEnd(begin);
+            if (!sScene.parts[begin].instance)
+            {
+                continue;
+            }
+
+            gpuCullAddGroup(culler);
+            for (std::size_t p = begin; p < end; p++)
+            {
+                if (!pvsVisible(sScene.pvs, cell, sScene.parts[p].pvsPart))
+                {
+                    sScene.cullPartsPvs++;
+                    continue;
+                }
+
+                /* the spheres of the occluder candidates are the world spheres of all parts, only filled with occlusion
+                 * culling on */
+                if (occlusion)
+                {
+                    const CullList& spheres = sScene.cullOccluders;
+                    const Vector3D center(spheres.centerX[p], spheres.centerY[p], spheres.centerZ[p]);
+                    const Vector3D extent(spheres.radius[p], spheres.radius[p], spheres.radius[p]);
+                    if (!occlusionTest(sScene.occlusion, center, extent))
+                    {
+                        continue;
+                    }
+                }
+
+                ScenePart& part = sScene.parts[p];
+                part.matrix = renderQueueMatrix(sScene.queue, part.transformation);
+                gpuCullAddSphere(culler, part.transformation, part.model->mesh.boundsCenter, part.model->mesh.boundsRadius, part.matrix);
+            }
+        }
+        sScene.gpuInstancesVisible += gpuCull(culler, frustum, cameraPosition(sScene.camera), sScene.planet.position,
+                                              planetOccluderRadius(sScene.planet), cameraPixelScale(sScene.camera), CONTRIBUTION_PIXELS);
+    }
+
+    /* consecutive instances of a model are recorded together */
+    std::size_t group = 0;
+    for (std::size_t begin = 0, end = 0; begin < sScene.parts.size(); begin = end)
+    {
+        end = instancesEnd(begin);
+        if (sScene.parts[begin].impostor)
+        {
+            recordImpostors(begin, end, gpuCulling ? static_cast<int>(group++) : -1);
+            continue;
+        }
+        if (gpuCulling && sScene.parts[begin].instance)
+        {
+            recordCulledInstances(begin, end, group++);
+            continue;
+        }
+        recordPartRanges(frustum, begin, end);
+    }
+
+    /* the instance counts of the recorded draws stay on the GPU */
+    if (gpuCulling)
+    {
+        gpuCullCommands(culler);
+    }
 }
 
-/* Function to set correct shader programs for the different rendering settings */
-void renderColor(bool renderNormal) {
-    ShaderProgram shaderScene;
-    ShaderProgram shaderFlag;
-    if (renderNormal) {
-        shaderScene = sScene.shaderNormal;
-        shaderFlag = sScene.shaderFlagNormal;
-    } else {
-        shaderScene = sScene.shaderColor;
-        shaderFlag = sScene.shaderFlagColor;
+/* Function to record the draws with the correct shader programs for the different rendering settings */
+void recordScene(bool renderNormal) {
+    const SceneProgram& shaderScene = renderNormal ? sScene.shaderNormal : sScene.shaderColor;
+    const SceneProgram& shaderFlag = renderNormal ? sScene.shaderFlagNormal : sScene.shaderFlagColor;
+
+    sScene.lodFrames++;
+    sScene.parts.clear();
+
+    /* the color pass only shades fragments covered by the depth pass, so all parts need a depth program */
+    const bool depthPrepass = sScene.depthPrepass && sScene.shaderDepth.shader.id != 0 && sScene.shaderFlagDepth.shader.id != 0;
+    const SceneProgram* shaderDepth = depthPrepass ? &sScene.shaderDepth : nullptr;
+    const SceneProgram* shaderFlagDepth = depthPrepass ? &sScene.shaderFlagDepth : nullptr;
+
+    /* shaders that are still loading are skipped */
+    if (shaderScene.shader.id != 0)
+    {
+        /* the plane is a single model, its parts select their transform from a palette of consecutive transform ids */
+        if (!sScene.plane.partSlots.empty())
+        {
+            planePalette(sScene.plane, sScene.palette);
+            const unsigned int palette = renderQueueMatrix(sScene.queue, sScene.palette[0]);
+            for (std::size_t i = 1; i < sScene.palette.size(); i++)
+            {
+                renderQueueMatrix(sScene.queue, sScene.palette[i]);
+            }
+            addPart(shaderScene, shaderDepth, sScene.plane.model, sScene.plane.transformation, palette);
+        }
+
+        /* planet parts share the transformation and quantization, so ranges of the same material are merged, copies
+         * of the same prop are drawn instanced */
+        const unsigned int planetMatrix = renderQueueMatrix(sScene.queue, sScene.planet.transformation);
+        const std::size_t planetBegin = sScene.parts.size();
+        for (const auto& model : sScene.planet.partModel)
+        {
+            addInstances(shaderScene, shaderDepth, model, sScene.planet.transformation, planetMatrix);
+        }
+
+        /* the bits of the PVS follow the parts of the planet in the same order as in sceneBakePvs() */
+        for (std::size_t p = planetBegin; p < sScene.parts.size(); p++)
+        {
+            sScene.parts[p].pvsPart = p - planetBegin;
+        }
+    }
+    if (shaderFlag.shader.id != 0 && sScene.plane.flag.model.mesh.vao != 0)
+    {
+        // uModel: Transforms local vertices to world space coordinates!
+        const Matrix4D transformation = sScene.plane.transformation * sScene.plane.flagModelMatrix * sScene.plane.flagNegativeRotation;
+        addPart(shaderFlag, shaderFlagDepth, sScene.plane.flag.model, transformation, renderQueueMatrix(sScene.queue, transformation));
     }
 
-    renderPlanetAndPlane(shaderScene, renderNormal);
-    renderFlag(shaderFlag, renderNormal);
+    recordParts();
 }
 
 /* function to draw all objects in the scene */
@@ -376,35 +1337,91 @@ void sceneDraw()
     glClearColor(135.0 / 255, 206.0 / 255, 235.0 / 255, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    /* material changes (e.g. switched lights) and the camera are uploaded once per frame */
+    materialUpload();
+    frameUniformsUpdate(sScene.frame, sScene.camera, sScene.time);
+
     /*------------ render scene -------------*/
     {
+        renderQueueClear(sScene.queue);
         if (sScene.renderMode == eRenderMode::COLOR)
         {
-            renderColor(false); // Changed the renderColor function prototype so that flag can be created with an individual vertex shader!
+            recordScene(false);
         }
         else if (sScene.renderMode == eRenderMode::NORMAL)
         {
-            renderColor(true);
+            recordScene(true);
         }
+
+        /* one sorted submission for all objects, leaves no program or VAO bound, timed on the GPU and read back
+         * GPU_TIMER_LATENCY frames later to not stall on the result */
+        renderQueueSort(sScene.queue);
+        GLuint timer = sScene.gpuTimers[sScene.gpuTimerFrame % GPU_TIMER_LATENCY];
+        if (sScene.gpuTimerFrame >= GPU_TIMER_LATENCY)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &elapsed);
+            sScene.gpuTime += static_cast<double>(elapsed) * 1e-6;
+            sScene.gpuTimeFrames++;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, timer);
+        renderQueueSubmit(sScene.queue, sScene.frame.data.viewProj);
+        glEndQuery(GL_TIME_ELAPSED);
+        sScene.gpuTimerFrame++;
+
+        const RenderQueueStats& stats = sScene.queue.stats;
+        sScene.queueStats.commands += stats.commands;
+        sScene.queueStats.drawCalls += stats.drawCalls;
+        sScene.queueStats.instances += stats.instances;
+        sScene.queueStats.indirectDraws += stats.indirectDraws;
+        sScene.queueStats.stateChanges += stats.stateChanges;
+        sScene.queueStats.unsortedStateChanges += stats.unsortedStateChanges;
+        sScene.queueStats.depthCommands += stats.depthCommands;
     }
     glCheckError();
-
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
 }
 
 int main(int argc, char **argv)
 {
+    /* measure OBJ parsing throughput, no window or OpenGL context required */
+    if (argc > 1 && std::string(argv[1]) == "--benchmark")
+    {
+        modelBenchmark("assets/planet/cute-little-planet.obj", 20);
+        modelBenchmark("assets/plane/cartoon-plane.obj", 20);
+        return EXIT_SUCCESS;
+    }
+
+    /* --depth-prepass starts with the depth pre-pass and uploads the position streams it reads, --frames N renders N
+     * frames after loading in a hidden window, prints their statistics and exits */
+    bool depthPrepass = false;
+    int frames = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--depth-prepass")
+        {
+            depthPrepass = true;
+        }
+        else if (std::string(argv[i]) == "--frames" && i + 1 < argc)
+        {
+            frames = std::max(std::atoi(argv[++i]), 0);
+        }
+    }
+
     /* create window/context */
     int width = 1280;
     int height = 720;
-    GLFWwindow *window = windowCreate("Assignment 4 - Shader Programming", width, height);
+    GLFWwindow *window = windowCreate("Assignment 4 - Shader Programming", width, height, frames == 0);
     if (!window)
     {
         return EXIT_FAILURE;
     }
 
+    /* a hidden window is never presented, swaps should not wait for the display */
+    if (frames > 0)
+    {
+        glfwSwapInterval(0);
+    }
+
     /* set window callbacks */
     glfwSetKeyCallback(window, keyCallback);
     glfwSetCursorPosCallback(window, mousePosCallback);
@@ -416,11 +1433,16 @@ int main(int argc, char **argv)
     glEnable(GL_DEPTH_TEST);
 
     /* setup scene */
-    sceneInit(static_cast<float>(width), static_cast<float>(height));
+    sceneInit(static_cast<float>(width), static_cast<float>(height), depthPrepass);
+    if (frames > 0)
+    {
+        sScene.reportInterval = std::numeric_limits<float>::infinity();
+    }
 
     /*-------------- main loop ----------------*/
     double timeStamp = glfwGetTime();
     double timeStampNew = 0.0;
+    int framesDrawn = -1;  // with --frames, frames drawn since loading finished, -1 while loading
 
     /* loop until user closes window */
     while (!glfwWindowShouldClose(window))
@@ -433,19 +1455,48 @@ int main(int argc, char **argv)
         sceneUpdate(static_cast<float>(timeStampNew - timeStamp));
         timeStamp = timeStampNew;
 
+        /* the statistics of --frames leave out the frames drawn while loading */
+        if (frames > 0 && framesDrawn < 0 && !sScene.loading)
+        {
+            sceneResetStats();
+            framesDrawn = 0;
+        }
+
         /* draw all objects in the scene */
         sceneDraw();
 
         /* swap front and back buffer */
         glfwSwapBuffers(window);
+
+        if (framesDrawn >= 0 && ++framesDrawn == frames)
+        {
+            std::cout << "[Scene] statistics of " << frames << " frames:" << std::endl;
+            sceneReportStats();
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
     }
 
     /*-------- cleanup --------*/
+    loaderStop(sScene.loader);
+    parallelPoolStop(sScene.occlusionWorkers);
+
     /* delete opengl shader and buffers */
-    shaderDelete(sScene.shaderColor);
-    shaderDelete(sScene.shaderNormal);
+    shaderDelete(sScene.shaderColor.shader);
+    shaderDelete(sScene.shaderNormal.shader);
+    shaderDelete(sScene.shaderFlagColor.shader);
+    shaderDelete(sScene.shaderFlagNormal.shader);
+    shaderDelete(sScene.shaderDepth.shader);
+    shaderDelete(sScene.shaderFlagDepth.shader);
+    glDeleteQueries(GPU_TIMER_LATENCY, sScene.gpuTimers);
+    gpuCullerDelete(sScene.gpuCuller);
+    shaderDelete(sScene.shaderImpostor);
+    impostorAtlasDelete(sScene.impostors);
     planeDelete(sScene.plane);
     planetDelete(sScene.planet);
+    meshArenaDelete(sScene.arena);
+    materialTableDelete();
+    frameUniformsDelete(sScene.frame);
+    renderQueueDelete(sScene.queue);
 
     /* cleanup glfw/glcontext */
     windowDelete(window);
@@ -18,17 +18,23 @@ float flagDisplacement(const FlagSim &sim, Vector2D position, float minPosZ)
     return displacement * positionScale;
 }
 
+ModelLoadOptions flagLoadOptions()
+{
+    ModelLoadOptions options;
+    options.buildLods = false;
+    return options;
+}
+
 Flag flagCreate(const std::string& flagFilePath)
 {
     Flag flag;
-    std::vector<Model> models = modelLoad(flagFilePath);
+    std::vector<Model> models = modelLoad(flagFilePath, flagLoadOptions());
 
     if(models.size() != 1)
     {
         throw std::runtime_error("[Flag] number of parts do not match!" + std::to_string(models.size()));
     }
-    flag.model = models[0];
-    flag.minPosZ = -8.0f;
+    flag = flagCreate(models[0]);
 
     /*
      * Load vertices for flag, not required in implementation of shader based animation
@@ -40,6 +46,15 @@ Flag flagCreate(const std::string& flagFilePath)
     return flag;
 }
 
+Flag flagCreate(const Model &model)
+{
+    Flag flag;
+    flag.model = model;
+    flag.minPosZ = -8.0f;
+
+    return flag;
+}
+
 void flagDelete(Flag &flag)
 {
     modelDelete(flag.model);
@@ -62,6 +77,15 @@ void animateFlag(Flag &flag, FlagSim &flagSim)
         glBindBuffer(GL_ARRAY_BUFFER, flag.model.mesh.vbo);
         glBufferData(GL_ARRAY_BUFFER, flag.vertices.size() * sizeof(Vertex), flag.vertices.data(), GL_DYNAMIC_DRAW);
         glCheckError();
+
+        /* the depth pre-pass reads the displaced positions from the position stream if the mesh has one */
+        if (flag.model.mesh.positionVbo != 0)
+        {
+            const std::vector<unsigned char> positions = meshPositionStream(flag.vertices.data(), flag.vertices.size(), VertexFloat);
+            glBindBuffer(GL_ARRAY_BUFFER, flag.model.mesh.positionVbo);
+            glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), GL_DYNAMIC_DRAW);
+            glCheckError();
+        }
     }
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -54,6 +54,23 @@ struct Flag {
  */
 Flag flagCreate(const std::string& flagFilePath);
 
+/**
+ * @brief Load options of the flag model. The flag is animated in the vertex shader and always drawn in full detail,
+ * so no levels of detail are built for it.
+ *
+ * @return Options for modelLoad(...) or loaderRequestModel(...).
+ */
+ModelLoadOptions flagLoadOptions();
+
+/**
+ * @brief Same as flagCreate(...) above, but for an already loaded flag model (see loader.h).
+ *
+ * @param model Model of the flag with initialized mesh.
+ *
+ * @return Initialized flag.
+ */
+Flag flagCreate(const Model& model);
+
 
 /**
  * @brief Cleanup and delete all OpenGL buffers of the flag mesh. Has to be called for each flag after it is not used anymore.
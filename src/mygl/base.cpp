@@ -54,7 +54,7 @@ void glfw_error_callback(int error, const char* description)
     std::cerr << "GLFW Error: " <<  description << std::endl;
 }
 
-GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, unsigned int height = 720)
+GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, unsigned int height = 720, bool visible = true)
 {
     /*-------------- init glfw ----------------*/
     if(!glfwInit())
@@ -72,6 +72,7 @@ GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, un
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
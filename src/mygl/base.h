@@ -24,10 +24,11 @@
  * @param title Window title
  * @param width Window width
  * @param height Window height
+ * @param visible Show the window, a hidden window still has a default framebuffer to render into
  *
  * @return Initialized GLFW window.
  */
-GLFWwindow* windowCreate(const std::string &title, unsigned int width, unsigned int height);
+GLFWwindow* windowCreate(const std::string &title, unsigned int width, unsigned int height, bool visible);
 /**
  * @brief Delete GLFW window and OpenGL contexst. Has to be called for each window after it is not used anymore.
  *
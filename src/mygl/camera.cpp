@@ -51,6 +51,11 @@ Vector3D cameraPosition(const Camera &cam)
     return cam.rotation * cam.position;
 }
 
+float cameraPixelScale(const Camera &cam)
+{
+    return cam.height / (2.0f * std::tan(0.5f * cam.fov));
+}
+
 void cameraUpdateOrbit(Camera &cam, const Vector2D &mouseDiff, float zoom)
 {
     Vector3D spherCoord = detail::sphericalCoords(cam);
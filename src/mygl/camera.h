@@ -65,6 +65,16 @@ Matrix4D cameraView(const Camera &cam);
  */
 Vector3D cameraPosition(const Camera &cam);
 
+/**
+ * @brief Pixels covered by one world unit at distance 1 in front of the camera, a length l at distance d covers
+ * l * scale / d pixels of the image height.
+ *
+ * @param cam Camera with fov and image height.
+ *
+ * @return Pixel scale of the camera.
+ */
+float cameraPixelScale(const Camera &cam);
+
 /**
  * @brief Update camera position on the orbit around the look at point using spherical coordinates.
  *
@@ -0,0 +1,292 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace detail
+{
+
+void pushVolume(CullList& list, const Vector3D& center, const Vector3D& extent, float radius)
+{
+    list.centerX.push_back(center.x);
+    list.centerY.push_back(center.y);
+    list.centerZ.push_back(center.z);
+    list.extentX.push_back(extent.x);
+    list.extentY.push_back(extent.y);
+    list.extentZ.push_back(extent.z);
+    list.radius.push_back(radius);
+}
+
+/* distance of the volume to the plane, negative if it is completely outside */
+inline float planeDistance(const Vector4D& plane, const CullList& list, std::size_t i)
+{
+    return plane.x * list.centerX[i] + plane.y * list.centerY[i] + plane.z * list.centerZ[i] + plane.w +
+           std::fabs(plane.x) * list.extentX[i] + std::fabs(plane.y) * list.extentY[i] + std::fabs(plane.z) * list.extentZ[i] +
+           list.radius[i];
+}
+
+void cullScalar(const Frustum& frustum, CullList& list, std::size_t begin, std::size_t end)
+{
+    for(std::size_t i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for(int p = 0; p < 6 && inside; p++)
+        {
+            inside = planeDistance(frustum.planes[p], list, i) >= 0.0f;
+        }
+        list.visible[i] = inside;
+    }
+}
+
+#ifdef CULLING_SSE
+/* four volumes per iteration, returns the number of volumes that were tested */
+std::size_t cullSse(const Frustum& frustum, CullList& list)
+{
+    const std::size_t count = list.radius.size() / 4 * 4;
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+    for(int p = 0; p < 6; p++)
+    {
+        const Vector4D& plane = frustum.planes[p];
+        planeX[p] = _mm_set1_ps(plane.x);
+        planeY[p] = _mm_set1_ps(plane.y);
+        planeZ[p] = _mm_set1_ps(plane.z);
+        planeW[p] = _mm_set1_ps(plane.w);
+        absX[p] = _mm_and_ps(planeX[p], signMask);
+        absY[p] = _mm_and_ps(planeY[p], signMask);
+        absZ[p] = _mm_and_ps(planeZ[p], signMask);
+    }
+
+    for(std::size_t i = 0; i < count; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(&list.centerX[i]);
+        const __m128 cy = _mm_loadu_ps(&list.centerY[i]);
+        const __m128 cz = _mm_loadu_ps(&list.centerZ[i]);
+        const __m128 ex = _mm_loadu_ps(&list.extentX[i]);
+        const __m128 ey = _mm_loadu_ps(&list.extentY[i]);
+        const __m128 ez = _mm_loadu_ps(&list.extentZ[i]);
+        const __m128 r = _mm_loadu_ps(&list.radius[i]);
+
+        /* lanes stay set while the volume is on the inner side of every plane */
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy));
+            d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            __m128 e = _mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey));
+            e = _mm_add_ps(e, _mm_add_ps(_mm_mul_ps(absZ[p], ez), r));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, e), _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for(int k = 0; k < 4; k++)
+        {
+            list.visible[i + k] = (mask >> k) & 1;
+        }
+    }
+
+    return count;
+}
+#endif
+
+}
+
+Frustum frustumCreate(const Matrix4D &viewProj)
+{
+    /* rows of the matrix, a clip space point is inside if -w <= x, y, z <= w */
+    Vector4D rows[4];
+    for(int r = 0; r < 4; r++)
+    {
+        rows[r] = Vector4D(viewProj(r, 0), viewProj(r, 1), viewProj(r, 2), viewProj(r, 3));
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    for(auto& plane : frustum.planes)
+    {
+        const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        plane = plane / length;
+    }
+    return frustum;
+}
+
+void cullListClear(CullList &list)
+{
+    list.centerX.clear();
+    list.centerY.clear();
+    list.centerZ.clear();
+    list.extentX.clear();
+    list.extentY.clear();
+    list.extentZ.clear();
+    list.radius.clear();
+    list.visible.clear();
+}
+
+std::size_t cullListAddSphere(CullList &list, const Matrix4D &transformation, const Vector3D &center, float radius)
+{
+    const Vector4D worldCenter = transformation * Vector4D(center, 1.0f);
+    const float scale = std::max({length(Vector3D(transformation[0])), length(Vector3D(transformation[1])),
+                                  length(Vector3D(transformation[2]))});
+
+    detail::pushVolume(list, Vector3D(worldCenter.x, worldCenter.y, worldCenter.z), Vector3D(0.0f, 0.0f, 0.0f), radius * scale);
+    return list.radius.size() - 1;
+}
+
+std::size_t cullListAddBox(CullList &list, const Matrix4D &transformation, const MeshBox &box)
+{
+    if(box.min.x > box.max.x)
+    {
+        /* negative radius, fails every plane */
+        detail::pushVolume(list, Vector3D(0.0f, 0.0f, 0.0f), Vector3D(0.0f, 0.0f, 0.0f), -1.0f);
+        return list.radius.size() - 1;
+    }
+
+    const Vector3D center = 0.5f * (box.min + box.max);
+    const Vector3D extent = 0.5f * (box.max - box.min);
+    const Vector4D worldCenter = transformation * Vector4D(center, 1.0f);
+
+    /* extent of the transformed box along each world axis */
+    Vector3D worldExtent;
+    for(int r = 0; r < 3; r++)
+    {
+        worldExtent[r] = std::fabs(transformation(r, 0)) * extent.x + std::fabs(transformation(r, 1)) * extent.y +
+                         std::fabs(transformation(r, 2)) * extent.z;
+    }
+
+    detail::pushVolume(list, Vector3D(worldCenter.x, worldCenter.y, worldCenter.z), worldExtent, 0.0f);
+    return list.radius.size() - 1;
+}
+
+std::size_t frustumCull(const Frustum &frustum, CullList &list)
+{
+    const std::size_t count = list.radius.size();
+    list.visible.resize(count);
+
+    std::size_t begin = 0;
+#ifdef CULLING_SSE
+    begin = detail::cullSse(frustum, list);
+#endif
+    detail::cullScalar(frustum, list, begin, count);
+
+    return static_cast<std::size_t>(std::count(list.visible.begin(), list.visible.end(), 1));
+}
+
+std::size_t horizonCull(CullList &list, const Vector3D &cameraPosition, const Vector3D &center, float radius)
+{
+    const Vector3D toCenter = center - cameraPosition;
+    const float distance = length(toCenter);
+    if(radius <= 0.0f || distance <= radius)
+    {
+        return 0;
+    }
+
+    /* half angle of the horizon cone and distance of the horizon plane from the camera along its axis */
+    const Vector3D axis = toCenter / distance;
+    const float coneAngle = std::asin(radius / distance);
+    const float horizon = (distance * distance - radius * radius) / distance;
+
+    std::size_t hidden = 0;
+    for(std::size_t i = 0; i < list.radius.size(); i++)
+    {
+        if(!list.visible[i])
+        {
+            continue;
+        }
+
+        const Vector3D extent(list.extentX[i], list.extentY[i], list.extentZ[i]);
+        const float r = list.radius[i] + length(extent);
+        const Vector3D toVolume = Vector3D(list.centerX[i], list.centerY[i], list.centerZ[i]) - cameraPosition;
+        const float volumeDistance = length(toVolume);
+        const float along = dot(toVolume, axis);
+        if(volumeDistance <= r || along - r < horizon)
+        {
+            continue;
+        }
+
+        /* the angle to the cone axis plus the angular radius of the volume has to stay within the cone */
+        const float angle = std::acos(std::clamp(along / volumeDistance, -1.0f, 1.0f));
+        if(angle + std::asin(r / volumeDistance) <= coneAngle)
+        {
+            list.visible[i] = 0;
+            hidden++;
+        }
+    }
+    return hidden;
+}
+
+std::size_t contributionCull(CullList &list, const Vector3D &cameraPosition, float pixelScale, float minPixels)
+{
+    if(minPixels <= 0.0f)
+    {
+        return 0;
+    }
+
+    std::size_t hidden = 0;
+    for(std::size_t i = 0; i < list.radius.size(); i++)
+    {
+        if(!list.visible[i])
+        {
+            continue;
+        }
+
+        /* the diameter of the sphere at the distance of its center, volumes around the camera are always kept */
+        const Vector3D extent(list.extentX[i], list.extentY[i], list.extentZ[i]);
+        const float r = list.radius[i] + length(extent);
+        const float distance = length(Vector3D(list.centerX[i], list.centerY[i], list.centerZ[i]) - cameraPosition);
+        if(distance > r && 2.0f * r * pixelScale < minPixels * distance)
+        {
+            list.visible[i] = 0;
+            hidden++;
+        }
+    }
+    return hidden;
+}
+
+std::size_t meshletCull(CullList &list, const Frustum &frustum, const Matrix4D &transformation, const Vector3D &cameraPosition,
+                        const Meshlet *meshlets, std::size_t count, MeshletCullStats &stats)
+{
+    cullListClear(list);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        cullListAddSphere(list, transformation, meshlets[i].center, meshlets[i].radius);
+    }
+    std::size_t visible = frustumCull(frustum, list);
+
+    stats.tested += count;
+    stats.outside += count - visible;
+
+    /* every point of the sphere has to see every normal of the cone from behind, i.e. the direction to it has to be
+     * closer to the axis than 90 degrees minus the cone angle (coneCutoff is the sine of the cone angle) */
+    const Vector4D eye = inverse(transformation) * Vector4D(cameraPosition, 1.0f);
+    const Vector3D objectCamera(eye.x, eye.y, eye.z);
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        if(!list.visible[i] || meshlet.coneCutoff >= 1.0f)
+        {
+            continue;
+        }
+
+        const Vector3D toCenter = meshlet.center - objectCamera;
+        if(dot(toCenter, meshlet.coneAxis) > meshlet.coneCutoff * length(toCenter) + meshlet.radius * (1.0f + meshlet.coneCutoff))
+        {
+            list.visible[i] = 0;
+            stats.backfacing++;
+            visible--;
+        }
+    }
+    return visible;
+}
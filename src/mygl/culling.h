@@ -0,0 +1,133 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+/* planes of a view frustum (left, right, bottom, top, near, far), a point p is inside if
+ * dot(plane.xyz, p) + plane.w >= 0 for all planes, the normals have unit length */
+struct Frustum
+{
+    Vector4D planes[6];
+};
+
+/*
+ * World space bounding volumes tested against a frustum in one batch. The volumes are stored as structure of arrays,
+ * so four of them are tested against a plane with one SSE instruction per component. A volume is a box (center and
+ * half extents) grown by a radius, spheres have zero extents and boxes have zero radius.
+ */
+struct CullList
+{
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+
+    /* result of frustumCull(...), 1 if the volume intersects the frustum */
+    std::vector<std::uint8_t> visible;
+};
+
+/* counters of meshletCull(...), accumulated over the meshlets of a frame */
+struct MeshletCullStats
+{
+    std::size_t tested = 0;
+    std::size_t backfacing = 0;     // all triangles face away from the camera
+    std::size_t outside = 0;        // outside of the frustum
+};
+
+/**
+ * @brief Extracts the frustum planes of a view-projection matrix (Gribb/Hartmann).
+ *
+ * @param viewProj Projection matrix times view matrix, e.g. cameraProjection(...) * cameraView(...).
+ *
+ * @return Frustum in world space.
+ */
+Frustum frustumCreate(const Matrix4D& viewProj);
+
+/**
+ * @brief Removes all volumes from a cull list, the allocated storage is kept.
+ *
+ * @param list List to clear.
+ */
+void cullListClear(CullList& list);
+
+/**
+ * @brief Adds the bounding sphere of a mesh transformed to world space, the radius is scaled by the largest axis scale
+ * of the transformation.
+ *
+ * @param list List to add to.
+ * @param transformation Model matrix.
+ * @param center Sphere center in object space.
+ * @param radius Sphere radius in object space.
+ *
+ * @return Index of the volume in the list.
+ */
+std::size_t cullListAddSphere(CullList& list, const Matrix4D& transformation, const Vector3D& center, float radius);
+
+/**
+ * @brief Adds a bounding box transformed to world space, the result is the world space box around the transformed box.
+ *
+ * @param list List to add to.
+ * @param transformation Model matrix.
+ * @param box Box in object space, empty boxes are never visible.
+ *
+ * @return Index of the volume in the list.
+ */
+std::size_t cullListAddBox(CullList& list, const Matrix4D& transformation, const MeshBox& box);
+
+/**
+ * @brief Tests all volumes of a list against a frustum and stores the result in CullList::visible. Volumes that are
+ * only partially inside count as visible.
+ *
+ * @param frustum Frustum to test against.
+ * @param list Volumes to test.
+ *
+ * @return Number of visible volumes.
+ */
+std::size_t frustumCull(const Frustum& frustum, CullList& list);
+
+/**
+ * @brief Hides the volumes of a list that are behind an opaque sphere as seen from the camera, i.e. completely inside
+ * the cone tangent to the sphere and beyond its horizon plane. Only clears entries of CullList::visible, so it is used
+ * after frustumCull(...). Boxes are tested by the sphere around them.
+ *
+ * @param list Volumes to test.
+ * @param cameraPosition Camera position in world space.
+ * @param center Center of the occluding sphere in world space.
+ * @param radius Radius of the occluding sphere, it has to be completely covered by the occluding geometry.
+ *
+ * @return Number of volumes that were visible before and are hidden now.
+ */
+std::size_t horizonCull(CullList& list, const Vector3D& cameraPosition, const Vector3D& center, float radius);
+
+/**
+ * @brief Hides the volumes of a list that cover less than a number of pixels on screen (contribution culling). Only
+ * clears entries of CullList::visible, so it is used after frustumCull(...). Boxes are tested by the sphere around them.
+ *
+ * @param list Volumes to test.
+ * @param cameraPosition Camera position in world space.
+ * @param pixelScale Pixel scale of the camera (see cameraPixelScale(...)).
+ * @param minPixels Smallest projected diameter in pixels that is kept, 0 keeps everything.
+ *
+ * @return Number of volumes that were visible before and are hidden now.
+ */
+std::size_t contributionCull(CullList& list, const Vector3D& cameraPosition, float pixelScale, float minPixels);
+
+/**
+ * @brief Culls the meshlets of a mesh (see meshBuildMeshlets(...)) against a frustum and against the camera position
+ * with their normal cones. The list is cleared and receives the bounding sphere of every meshlet, CullList::visible is
+ * 1 for the meshlets that have to be drawn. The cone test runs in object space, so the transformation must not scale
+ * non-uniformly or mirror.
+ *
+ * @param list Receives the world space spheres and the result.
+ * @param frustum Frustum to test against.
+ * @param transformation Model matrix.
+ * @param cameraPosition Camera position in world space.
+ * @param meshlets First meshlet to test.
+ * @param count Number of meshlets.
+ * @param stats Counters the tested and rejected meshlets are added to.
+ *
+ * @return Number of visible meshlets.
+ */
+std::size_t meshletCull(CullList& list, const Frustum& frustum, const Matrix4D& transformation, const Vector3D& cameraPosition,
+                        const Meshlet* meshlets, std::size_t count, MeshletCullStats& stats);
@@ -0,0 +1,43 @@
+#include "drawbatch.h"
+
+#include <cstring>
+
+bool drawBatchCompatible(const DrawBatch &batch, const Mesh &mesh)
+{
+    const Mesh& first = *batch.mesh;
+    return first.vao == mesh.vao && first.indexType == mesh.indexType &&
+           std::memcmp(&first.posScale, &mesh.posScale, sizeof(Vector3D)) == 0 &&
+           std::memcmp(&first.posOffset, &mesh.posOffset, sizeof(Vector3D)) == 0;
+}
+
+void drawBatchAdd(DrawBatch &batch, const Mesh &mesh, IndexRange range)
+{
+    if(!batch.mesh)
+    {
+        batch.mesh = &mesh;
+    }
+    batch.counts.push_back(static_cast<GLsizei>(range.count));
+    batch.offsets.push_back(reinterpret_cast<const void*>((mesh.firstIndex + range.offset) * meshIndexSize(mesh)));
+    batch.baseVertices.push_back(mesh.baseVertex);
+}
+
+void drawBatchClear(DrawBatch &batch)
+{
+    batch.mesh = nullptr;
+    batch.counts.clear();
+    batch.offsets.clear();
+    batch.baseVertices.clear();
+}
+
+void drawBatchSubmit(const DrawBatch &batch)
+{
+    if(batch.counts.size() == 1)
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, batch.counts[0], batch.mesh->indexType, batch.offsets[0], batch.baseVertices[0]);
+    }
+    else if(!batch.counts.empty())
+    {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), batch.mesh->indexType, batch.offsets.data(),
+                                      static_cast<GLsizei>(batch.counts.size()), batch.baseVertices.data());
+    }
+}
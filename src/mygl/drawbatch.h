@@ -0,0 +1,50 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <vector>
+
+/* index ranges drawn by one glMultiDrawElementsBaseVertex call, they share VAO, index type, quantization and material */
+struct DrawBatch
+{
+    const Mesh* mesh = nullptr;     // first mesh of the batch, provides the VAO, index type and posScale/posOffset
+
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;   // byte offsets into the index buffer
+    std::vector<GLint> baseVertices;
+};
+
+/**
+ * @brief Checks if a range of a mesh can be drawn in the same multi draw call as the ranges of a batch, i.e. if the
+ * mesh uses the same buffers and is decoded the same way (see ModelLoadOptions::sharedQuantization).
+ *
+ * @param batch Batch with at least one range.
+ * @param mesh Mesh of the range to add.
+ *
+ * @return True if the range can be added.
+ */
+bool drawBatchCompatible(const DrawBatch& batch, const Mesh& mesh);
+
+/**
+ * @brief Appends an index range of a mesh to a batch, the first range selects the mesh of the batch.
+ *
+ * @param batch Batch to extend.
+ * @param mesh Mesh of the range, has to be compatible with the batch and stay valid until the batch is drawn.
+ * @param range Range of the index buffer of the mesh.
+ */
+void drawBatchAdd(DrawBatch& batch, const Mesh& mesh, IndexRange range);
+
+/**
+ * @brief Removes all ranges from a batch, the allocated storage is kept.
+ *
+ * @param batch Batch to clear.
+ */
+void drawBatchClear(DrawBatch& batch);
+
+/**
+ * @brief Draws all ranges of a batch, with one glMultiDrawElementsBaseVertex call or a plain draw call for a single
+ * range. Program, VAO, material and the posScale/posOffset of the mesh of the batch have to be set.
+ *
+ * @param batch Batch to draw.
+ */
+void drawBatchSubmit(const DrawBatch& batch);
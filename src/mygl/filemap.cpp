@@ -0,0 +1,152 @@
+#include "filemap.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+
+unsigned long processId()
+{
+#ifdef _WIN32
+    return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+}
+
+std::string fileTempPath(const std::string &filepath)
+{
+    static std::atomic<unsigned long> counter{0};
+    return filepath + "." + std::to_string(detail::processId()) + "." + std::to_string(counter++) + ".tmp";
+}
+
+#ifdef _WIN32
+
+FileMap fileMapOpen(const std::string &filepath)
+{
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("[FileMap] Couldn't open file at " + filepath);
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("[FileMap] Couldn't query size of file at " + filepath);
+    }
+
+    FileMap map;
+    map.size = static_cast<std::size_t>(size.QuadPart);
+    map._file = file;
+
+    /* mapping an empty file is an error on windows */
+    if(map.size == 0)
+    {
+        return map;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("[FileMap] Couldn't map file at " + filepath);
+    }
+
+    map._mapping = mapping;
+    map.data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if(map.data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("[FileMap] Couldn't map file at " + filepath);
+    }
+
+    return map;
+}
+
+void fileMapClose(FileMap &file)
+{
+    if(file.data)
+    {
+        UnmapViewOfFile(file.data);
+    }
+    if(file._mapping)
+    {
+        CloseHandle(static_cast<HANDLE>(file._mapping));
+    }
+    if(file._file)
+    {
+        CloseHandle(static_cast<HANDLE>(file._file));
+    }
+
+    file = FileMap{};
+}
+
+#else
+
+FileMap fileMapOpen(const std::string &filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("[FileMap] Couldn't open file at " + filepath);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("[FileMap] Couldn't query size of file at " + filepath);
+    }
+
+    FileMap map;
+    map.size = static_cast<std::size_t>(info.st_size);
+
+    /* mmap of length zero is invalid, an empty file simply has no data */
+    if(map.size > 0)
+    {
+        void* data = mmap(nullptr, map.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("[FileMap] Couldn't map file at " + filepath);
+        }
+
+        /* the whole file is scanned front to back */
+        madvise(data, map.size, MADV_SEQUENTIAL);
+        map.data = static_cast<const char*>(data);
+    }
+
+    /* the mapping stays valid after closing the descriptor */
+    close(fd);
+
+    return map;
+}
+
+void fileMapClose(FileMap &file)
+{
+    if(file.data)
+    {
+        munmap(const_cast<char*>(file.data), file.size);
+    }
+
+    file = FileMap{};
+}
+
+#endif
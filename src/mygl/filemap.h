@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+struct FileMap
+{
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    /* platform specific handles */
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+};
+
+/**
+ * @brief Maps a whole file read-only into memory so it can be scanned in place without copying it into heap buffers.
+ *
+ * @param filepath Path to the file.
+ *
+ * @return Mapped file. Empty files are returned with data == nullptr and size == 0.
+ *
+ * usage:
+ *
+ *   FileMap file = fileMapOpen("assets/planet/cute-little-planet.obj");
+ *   std::string_view content(file.data, file.size);
+ *   fileMapClose(file);
+ *
+ */
+FileMap fileMapOpen(const std::string& filepath);
+
+/**
+ * @brief Unmaps a file again. Has to be called for each mapped file after its content is not used anymore.
+ *
+ * @param file Mapped file to close.
+ */
+void fileMapClose(FileMap& file);
+
+/**
+ * @brief Path of a temporary file next to a file, for writing it completely before renaming it into place. The name
+ * contains the process id and a counter, so concurrent writers never share a temporary file.
+ *
+ * @param filepath Path of the file that is written.
+ *
+ * @return Path of the form filepath.<pid>.<counter>.tmp.
+ */
+std::string fileTempPath(const std::string& filepath);
@@ -0,0 +1,44 @@
+#include "frame.h"
+#include "shader.h"
+
+static_assert(sizeof(FrameDataGpu) == 3 * 64 + 16, "FrameDataGpu has to match the std140 layout of FrameData");
+
+FrameUniforms frameUniformsCreate()
+{
+    FrameUniforms frame;
+
+    glGenBuffers(1, &frame.ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, frame.ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameDataGpu), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glCheckError();
+
+    return frame;
+}
+
+void frameUniformsUpdate(FrameUniforms &frame, const Camera &camera, float time)
+{
+    FrameDataGpu& data = frame.data;
+    data.view = cameraView(camera);
+    data.proj = cameraProjection(camera);
+    data.viewProj = data.proj * data.view;
+
+    const Vector3D position = cameraPosition(camera);
+    data.cameraPosition[0] = position.x;
+    data.cameraPosition[1] = position.y;
+    data.cameraPosition[2] = position.z;
+    data.time = time;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, frame.ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameDataGpu), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameBinding, frame.ubo);
+    glCheckError();
+}
+
+void frameUniformsDelete(FrameUniforms &frame)
+{
+    glDeleteBuffers(1, &frame.ubo);
+    frame = FrameUniforms{};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "base.h"
+#include "camera.h"
+
+/* std140 layout of the FrameData uniform block (see default.vert), matrices are column major like Matrix4D::ptr() */
+struct FrameDataGpu
+{
+    Matrix4D view;
+    Matrix4D proj;
+    Matrix4D viewProj;
+    float cameraPosition[3];
+    float time;              // packed into the last component of the camera position vec4
+};
+
+/*
+ * Per frame state shared by all programs (camera matrices, camera position, time). It is written once per frame into
+ * a uniform buffer that stays bound at FrameBinding (see eUniformBinding in shader.h), so the camera costs a single
+ * upload regardless of the number of programs and passes.
+ */
+struct FrameUniforms
+{
+    GLuint ubo = 0;
+    FrameDataGpu data;
+};
+
+/**
+ * @brief Creates the uniform buffer of the per frame data.
+ *
+ * @return Frame uniforms, filled by frameUniformsUpdate(...).
+ */
+FrameUniforms frameUniformsCreate();
+
+/**
+ * @brief Computes the camera matrices and uploads them together with the time with a single glBufferSubData call,
+ * then binds the buffer to FrameBinding. Has to be called once per frame before drawing.
+ *
+ * @param frame Frame uniforms to update.
+ * @param camera Camera of the frame.
+ * @param time Time in seconds, available to the shaders as uTime.
+ */
+void frameUniformsUpdate(FrameUniforms& frame, const Camera& camera, float time);
+
+/**
+ * @brief Deletes the uniform buffer.
+ *
+ * @param frame Frame uniforms to delete.
+ */
+void frameUniformsDelete(FrameUniforms& frame);
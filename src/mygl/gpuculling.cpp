@@ -0,0 +1,264 @@
+#include "gpuculling.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace detail
+{
+
+/* both buffers hold one entry per candidate, the visible list can at most get all of them */
+void growBuffers(GpuCuller& culler, std::size_t required)
+{
+    culler.capacity = std::max(culler.capacity * 2, required);
+
+    glBindBuffer(GL_ARRAY_BUFFER, culler.candidateBuffer);
+    glBufferData(GL_ARRAY_BUFFER, culler.capacity * sizeof(GpuCullCandidate), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, culler.visibleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, culler.capacity * sizeof(std::uint32_t), nullptr, GL_STREAM_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* both buffers hold one entry per recorded draw */
+void growCommandBuffers(GpuCuller& culler, std::size_t required)
+{
+    culler.commandCapacity = std::max(culler.commandCapacity * 2, required);
+
+    glBindBuffer(GL_ARRAY_BUFFER, culler.drawBuffer);
+    glBufferData(GL_ARRAY_BUFFER, culler.commandCapacity * sizeof(GpuCullDraw), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, culler.commandBuffer);
+    glBufferData(GL_ARRAY_BUFFER, culler.commandCapacity * sizeof(GpuCullCommand), nullptr, GL_STREAM_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+}
+
+GpuCuller gpuCullerCreate(const ShaderProgram &program, const ShaderProgram &commandProgram)
+{
+    GpuCuller culler;
+    culler.program = program;
+    for(int p = 0; p < 6; p++)
+    {
+        culler.planes[p] = shaderUniformHandle(program, "uPlanes[" + std::to_string(p) + "]");
+    }
+    culler.viewPosition = shaderUniformHandle(program, "uViewPosition");
+    culler.occluder = shaderUniformHandle(program, "uOccluder");
+    culler.contribution = shaderUniformHandle(program, "uContribution");
+
+    glGenVertexArrays(1, &culler.vao);
+    glGenBuffers(1, &culler.candidateBuffer);
+    glGenBuffers(1, &culler.visibleBuffer);
+    glGenTextures(1, &culler.visibleTexture);
+    glGenQueries(GPU_CULL_LATENCY, culler.queries);
+
+    glBindVertexArray(culler.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, culler.candidateBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GpuCullCandidate), reinterpret_cast<void*>(offsetof(GpuCullCandidate, sphere)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(GpuCullCandidate), reinterpret_cast<void*>(offsetof(GpuCullCandidate, transformId)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    detail::growBuffers(culler, 256);
+
+    /* without indirect draws the instance counts would have to be read back */
+    culler.indirect = GLAD_GL_ARB_draw_indirect && commandProgram.id != 0;
+    if(!culler.indirect)
+    {
+        shaderDelete(commandProgram);
+        glCheckError();
+        return culler;
+    }
+
+    culler.commandProgram = commandProgram;
+    glGenVertexArrays(1, &culler.commandVao);
+    glGenBuffers(1, &culler.drawBuffer);
+    glGenBuffers(1, &culler.commandBuffer);
+
+    glBindVertexArray(culler.commandVao);
+    glBindBuffer(GL_ARRAY_BUFFER, culler.drawBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(GpuCullDraw), reinterpret_cast<void*>(offsetof(GpuCullDraw, range)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_INT, sizeof(GpuCullDraw), reinterpret_cast<void*>(offsetof(GpuCullDraw, baseVertex)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(2, 2, GL_UNSIGNED_INT, sizeof(GpuCullDraw), reinterpret_cast<void*>(offsetof(GpuCullDraw, group)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    detail::growCommandBuffers(culler, 64);
+    glCheckError();
+
+    return culler;
+}
+
+void gpuCullClear(GpuCuller &culler)
+{
+    cullListClear(culler.spheres);
+    culler.transformIds.clear();
+    culler.groups.clear();
+    culler.draws.clear();
+}
+
+std::size_t gpuCullAddGroup(GpuCuller &culler)
+{
+    GpuCullGroup& group = culler.groups.emplace_back();
+    group.first = culler.transformIds.size();
+    return culler.groups.size() - 1;
+}
+
+void gpuCullAddSphere(GpuCuller &culler, const Matrix4D &transformation, const Vector3D &center, float radius, unsigned int transformId)
+{
+    cullListAddSphere(culler.spheres, transformation, center, radius);
+    culler.transformIds.push_back(transformId);
+    culler.groups.back().count++;
+}
+
+std::size_t gpuCull(GpuCuller &culler, const Frustum &frustum, const Vector3D &cameraPosition, const Vector3D &occluderCenter,
+                    float occluderRadius, float pixelScale, float minPixels)
+{
+    const std::size_t count = culler.transformIds.size();
+    if(count > culler.capacity)
+    {
+        detail::growBuffers(culler, count);
+    }
+
+    /* boxes are tested by the sphere around them, as by horizonCull(...) */
+    const CullList& spheres = culler.spheres;
+    culler.candidates.resize(count);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        const Vector3D extent(spheres.extentX[i], spheres.extentY[i], spheres.extentZ[i]);
+        culler.candidates[i] = {{spheres.centerX[i], spheres.centerY[i], spheres.centerZ[i], spheres.radius[i] + length(extent)},
+                                culler.transformIds[i]};
+    }
+    culler.hidden.resize(count, GPU_CULL_HIDDEN);
+    glBindBuffer(GL_ARRAY_BUFFER, culler.candidateBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(GpuCullCandidate), culler.candidates.data());
+    glBindBuffer(GL_ARRAY_BUFFER, culler.visibleBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(std::uint32_t), culler.hidden.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* the query of this slot was issued GPU_CULL_LATENCY frames ago, an older count is kept if it isn't done yet */
+    const GLuint query = culler.queries[culler.frame % GPU_CULL_LATENCY];
+    if(culler.frame >= GPU_CULL_LATENCY)
+    {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available)
+        {
+            GLuint written = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &written);
+            culler.visibleCount = written;
+        }
+    }
+
+    glUseProgram(culler.program.id);
+    for(int p = 0; p < 6; p++)
+    {
+        shaderUniform(culler.planes[p], frustum.planes[p]);
+    }
+    shaderUniform(culler.viewPosition, cameraPosition);
+    shaderUniform(culler.occluder, Vector4D(occluderCenter, occluderRadius));
+    shaderUniform(culler.contribution, Vector2D(pixelScale, minPixels));
+
+    /* every group writes to its own range of the visible list, so its visible ids start at its first entry */
+    glBindVertexArray(culler.vao);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+    for(const auto& group : culler.groups)
+    {
+        if(group.count == 0)
+        {
+            continue;
+        }
+        glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, culler.visibleBuffer, static_cast<GLintptr>(group.first * sizeof(std::uint32_t)),
+                          static_cast<GLsizeiptr>(group.count * sizeof(std::uint32_t)));
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, static_cast<GLint>(group.first), static_cast<GLsizei>(group.count));
+        glEndTransformFeedback();
+    }
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    culler.frame++;
+
+    glActiveTexture(GL_TEXTURE0 + VisibleTransformUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, culler.visibleTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, culler.visibleBuffer);
+    glCheckError();
+
+    return culler.visibleCount;
+}
+
+unsigned int gpuCullAddDraw(GpuCuller &culler, std::size_t group, const Mesh &mesh, IndexRange range)
+{
+    const GpuCullGroup& g = culler.groups.at(group);
+    GpuCullDraw draw;
+    draw.range[0] = range.count;
+    draw.range[1] = mesh.firstIndex + range.offset;
+    draw.baseVertex = mesh.baseVertex;
+    draw.group[0] = static_cast<std::uint32_t>(g.first);
+    draw.group[1] = static_cast<std::uint32_t>(g.count);
+    culler.draws.push_back(draw);
+    return static_cast<unsigned int>(culler.draws.size());
+}
+
+void gpuCullCommands(GpuCuller &culler)
+{
+    const std::size_t count = culler.draws.size();
+    if(count == 0)
+    {
+        return;
+    }
+    if(count > culler.commandCapacity)
+    {
+        detail::growCommandBuffers(culler, count);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, culler.drawBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(GpuCullDraw), culler.draws.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* reads the visible list that gpuCull(...) left bound to VisibleTransformUnit */
+    glUseProgram(culler.commandProgram.id);
+    glBindVertexArray(culler.commandVao);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, culler.commandBuffer, 0, static_cast<GLsizeiptr>(count * sizeof(GpuCullCommand)));
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler.commandBuffer);
+    glCheckError();
+}
+
+void gpuCullBind(unsigned int visibleList)
+{
+    /* the attribute array is never enabled, so every vertex reads this constant */
+    glVertexAttribI1ui(eDataIdx::VisibleList, visibleList);
+}
+
+void gpuCullerDelete(GpuCuller &culler)
+{
+    shaderDelete(culler.program);
+    glDeleteVertexArrays(1, &culler.vao);
+    glDeleteBuffers(1, &culler.candidateBuffer);
+    glDeleteBuffers(1, &culler.visibleBuffer);
+    glDeleteTextures(1, &culler.visibleTexture);
+    glDeleteQueries(GPU_CULL_LATENCY, culler.queries);
+    if(culler.indirect)
+    {
+        shaderDelete(culler.commandProgram);
+        glDeleteVertexArrays(1, &culler.commandVao);
+        glDeleteBuffers(1, &culler.drawBuffer);
+        glDeleteBuffers(1, &culler.commandBuffer);
+    }
+    culler = GpuCuller{};
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "culling.h"
+#include "shader.h"
+
+#include <cstdint>
+#include <vector>
+
+/* entry of the visible list after the visible transform ids of a group (HIDDEN_INSTANCE in cullcommand.vert) */
+constexpr std::uint32_t GPU_CULL_HIDDEN = 0xffffffffu;
+
+/* frames the number of visible candidates of a culling pass is read back after it was issued */
+constexpr unsigned int GPU_CULL_LATENCY = 2;
+
+/* candidates of one instanced draw, the visible ones are written consecutively into its part of the visible list */
+struct GpuCullGroup
+{
+    std::size_t first = 0;          // index of the first candidate and of the first entry in the visible list
+    std::size_t count = 0;
+};
+
+/* vertex of the culling pass (see cull.vert) */
+struct GpuCullCandidate
+{
+    float sphere[4];                // world space center and radius
+    std::uint32_t transformId;
+};
+
+/* vertex of the command pass, a range drawn for the visible instances of a group (see cullcommand.vert) */
+struct GpuCullDraw
+{
+    std::uint32_t range[2];         // index count and first index in the index buffer of the mesh
+    std::int32_t baseVertex;
+    std::uint32_t group[2];         // GpuCullGroup::first and GpuCullGroup::count
+};
+
+/* DrawElementsIndirectCommand written by the command pass */
+struct GpuCullCommand
+{
+    std::uint32_t count;
+    std::uint32_t instanceCount;    // visible instances of the group
+    std::uint32_t firstIndex;
+    std::int32_t baseVertex;
+    std::uint32_t baseInstance;     // reserved, 0
+};
+
+/*
+ * Frustum, horizon and contribution culling of instances on the GPU. The bounding spheres of the candidates are drawn as
+ * points with rasterization discarded, cull.vert tests them like frustumCull(...), horizonCull(...) and
+ * contributionCull(...) and cull.geom emits the transform ids of the visible ones into a transform feedback buffer. Each
+ * group has its own range of the buffer, one entry per candidate, which is filled with GPU_CULL_HIDDEN before the
+ * pass, so its visible transform ids end up at the start of the range and the rest stays hidden.
+ * The buffer is bound as a texture buffer to VisibleTransformUnit, the instanced draws of a group read the transform id
+ * of gl_InstanceID from it (see gpuCullBind(...) and default.vert). Their instance counts never leave the GPU: a second
+ * pass (cullcommand.vert) finds the end of the visible ids of every group and writes one indirect draw command per
+ * recorded range (see gpuCullAddDraw(...) and gpuCullCommands(...)), so only visible instances are shaded and nothing
+ * waits for the culling pass. This needs GL_ARB_draw_indirect, without it the culler is not indirect and the caller has
+ * to cull on the CPU. The number of visible instances is only counted by a query for the statistics and read back
+ * GPU_CULL_LATENCY frames later.
+ */
+struct GpuCuller
+{
+    ShaderProgram program;
+    UniformHandle planes[6];
+    UniformHandle viewPosition, occluder, contribution;
+
+    GLuint vao = 0;
+    GLuint candidateBuffer = 0;
+    GLuint visibleBuffer = 0;
+    GLuint visibleTexture = 0;
+    std::size_t capacity = 0;       // candidates both buffers hold
+
+    /* command pass, only if GL_ARB_draw_indirect is supported */
+    bool indirect = false;
+    ShaderProgram commandProgram;
+    GLuint commandVao = 0;
+    GLuint drawBuffer = 0;
+    GLuint commandBuffer = 0;
+    std::size_t commandCapacity = 0;  // draws both buffers hold
+
+    GLuint queries[GPU_CULL_LATENCY] = {};
+    std::size_t frame = 0;          // culling passes issued
+    std::size_t visibleCount = 0;   // visible candidates of the latest pass whose query was read back
+
+    /* candidates of the current frame, the spheres are computed like for the CPU culling */
+    CullList spheres;
+    std::vector<std::uint32_t> transformIds;
+    std::vector<GpuCullGroup> groups;
+    std::vector<GpuCullCandidate> candidates;  // upload buffer
+    std::vector<std::uint32_t> hidden;         // GPU_CULL_HIDDEN per candidate, uploaded before every pass
+    std::vector<GpuCullDraw> draws;            // recorded ranges of the current frame
+};
+
+/**
+ * @brief Creates the buffers of a culler.
+ *
+ * @param program Transform feedback program built from cull.vert and cull.geom (see shaderLoadFeedback(...)), capturing
+ * tTransformId. The culler takes ownership.
+ * @param commandProgram Transform feedback program built from cullcommand.vert alone, capturing the fields of
+ * GpuCullCommand (tCount, tInstanceCount, tFirstIndex, tBaseVertex, tBaseInstance). The culler takes ownership, it is
+ * deleted right away if GL_ARB_draw_indirect is not supported.
+ *
+ * @return Culler without candidates, GpuCuller::indirect tells if its groups can be drawn.
+ */
+GpuCuller gpuCullerCreate(const ShaderProgram& program, const ShaderProgram& commandProgram);
+
+/**
+ * @brief Removes all groups and candidates, the allocated storage is kept.
+ *
+ * @param culler Culler to clear.
+ */
+void gpuCullClear(GpuCuller& culler);
+
+/**
+ * @brief Starts a new group, the following candidates are added to it.
+ *
+ * @param culler Culler of the frame.
+ *
+ * @return Index of the group in GpuCuller::groups.
+ */
+std::size_t gpuCullAddGroup(GpuCuller& culler);
+
+/**
+ * @brief Adds the bounding sphere of an instance to the last group (see cullListAddSphere(...)).
+ *
+ * @param culler Culler with at least one group.
+ * @param transformation Model matrix of the instance.
+ * @param center Sphere center in object space.
+ * @param radius Sphere radius in object space.
+ * @param transformId Transform id of the instance, written to the visible list if the sphere is visible.
+ */
+void gpuCullAddSphere(GpuCuller& culler, const Matrix4D& transformation, const Vector3D& center, float radius, unsigned int transformId);
+
+/**
+ * @brief Runs the culling pass over all candidates without waiting for it. Leaves the visible list bound to
+ * VisibleTransformUnit and no program or VAO bound.
+ *
+ * @param culler Culler of the frame.
+ * @param frustum Frustum to test against.
+ * @param cameraPosition Camera position in world space.
+ * @param occluderCenter Center of an occluding sphere in world space (see horizonCull(...)).
+ * @param occluderRadius Radius of the occluding sphere, 0 to only test the frustum.
+ * @param pixelScale Pixel scale of the camera (see cameraPixelScale(...)).
+ * @param minPixels Smallest projected diameter in pixels that is kept, 0 disables the contribution test.
+ *
+ * @return Number of visible candidates of the pass GPU_CULL_LATENCY frames earlier (see GpuCuller::visibleCount), the
+ * count of an older pass if its query isn't available yet.
+ */
+std::size_t gpuCull(GpuCuller& culler, const Frustum& frustum, const Vector3D& cameraPosition, const Vector3D& occluderCenter,
+                    float occluderRadius, float pixelScale, float minPixels);
+
+/**
+ * @brief Records a range that is drawn for the visible instances of a group, the command pass writes its indirect draw
+ * command.
+ *
+ * @param culler Indirect culler of the frame.
+ * @param group Index of the group in GpuCuller::groups.
+ * @param mesh Mesh of the range.
+ * @param range Index range relative to the mesh.
+ *
+ * @return 1 + index of the command for RenderCommand::indirectCommand.
+ */
+unsigned int gpuCullAddDraw(GpuCuller& culler, std::size_t group, const Mesh& mesh, IndexRange range);
+
+/**
+ * @brief Runs the command pass over the draws recorded since gpuCull(...) and leaves the command buffer bound to
+ * GL_DRAW_INDIRECT_BUFFER for them (see meshDrawIndirect(...)). Has to run after gpuCull(...) in the same frame, no
+ * program or VAO stays bound.
+ *
+ * @param culler Indirect culler of the frame.
+ */
+void gpuCullCommands(GpuCuller& culler);
+
+/**
+ * @brief Selects the visible list of the following instanced draw calls.
+ *
+ * @param visibleList GpuCullGroup::first + 1 of the group the instances read their transform ids from, 0 for
+ * instances with the consecutive transform ids starting at the transform id of the draw (see transformBind(...)).
+ */
+void gpuCullBind(unsigned int visibleList);
+
+/**
+ * @brief Deletes the programs, the buffers and the queries of a culler.
+ *
+ * @param culler Culler to delete.
+ */
+void gpuCullerDelete(GpuCuller& culler);
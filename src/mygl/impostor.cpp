@@ -0,0 +1,195 @@
+#include "impostor.h"
+#include "material.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail
+{
+
+/* direction from the sphere center to the viewer of a tile and the axes of its image, right x up = direction */
+void impostorView(unsigned int yawStep, unsigned int pitchStep, Vector3D& direction, Vector3D& right, Vector3D& up)
+{
+    const float yaw = 2.0f * static_cast<float>(M_PI) * yawStep / IMPOSTOR_YAW_STEPS;
+    const float pitch = 0.5f * static_cast<float>(M_PI) * pitchStep / (IMPOSTOR_PITCH_STEPS - 1);
+
+    direction = Vector3D(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+    right = Vector3D(std::cos(yaw), 0.0f, -std::sin(yaw));
+    up = Vector3D(-std::sin(pitch) * std::sin(yaw), std::cos(pitch), -std::sin(pitch) * std::cos(yaw));
+}
+
+/* orthographic projection of the bounding sphere onto a tile, the sphere fills [-1, 1] in all axes */
+Matrix4D impostorViewProj(const Vector3D& center, float radius, const Vector3D& direction, const Vector3D& right, const Vector3D& up)
+{
+    const float s = 1.0f / radius;
+    return Matrix4D(right.x * s, right.y * s, right.z * s, -dot(center, right) * s,
+                    up.x * s, up.y * s, up.z * s, -dot(center, up) * s,
+                    -direction.x * s, -direction.y * s, -direction.z * s, dot(center, direction) * s,
+                    0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+GLuint createLayers(unsigned int width, unsigned int height, unsigned int layers, unsigned int levels)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    for(unsigned int level = 0; level < levels; level++)
+    {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_RGBA8, std::max(width >> level, 1u), std::max(height >> level, 1u),
+                     static_cast<GLsizei>(layers), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels - 1));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+/* draws all tiles of a model into the attached layer */
+void renderTiles(RenderQueue& queue, const Model& model, const RenderProgram& program, unsigned int tileSize)
+{
+    renderQueueClear(queue);
+    RenderCommand command;
+    command.program = &program;
+    command.mesh = &model.mesh;
+    command.matrix = renderQueueMatrix(queue, Matrix4D::identity());
+    for(const auto& range : model.material)
+    {
+        command.range = {range.indexOffset, range.indexCount};
+        command.materialId = range.materialId;
+        renderQueuePush(queue, RenderPassOpaque, command, 0.0f);
+    }
+    renderQueueSort(queue);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    Vector3D direction, right, up;
+    for(unsigned int pitch = 0; pitch < IMPOSTOR_PITCH_STEPS; pitch++)
+    {
+        for(unsigned int yaw = 0; yaw < IMPOSTOR_YAW_STEPS; yaw++)
+        {
+            impostorView(yaw, pitch, direction, right, up);
+            glViewport(static_cast<GLint>(yaw * tileSize), static_cast<GLint>(pitch * tileSize), static_cast<GLsizei>(tileSize),
+                       static_cast<GLsizei>(tileSize));
+            renderQueueSubmit(queue, impostorViewProj(model.mesh.boundsCenter, model.mesh.boundsRadius, direction, right, up));
+        }
+    }
+}
+
+}
+
+ImpostorAtlas impostorAtlasCreate(const std::vector<const Model*> &models, const RenderProgram &colorProgram,
+                                  const RenderProgram &normalProgram, unsigned int tileSize)
+{
+    ImpostorAtlas atlas;
+    atlas.tileSize = tileSize;
+    atlas.models = models;
+    if(models.empty())
+    {
+        return atlas;
+    }
+
+    /* mip levels stop at 4 texels per tile, smaller tiles would bleed into their neighbours */
+    const unsigned int width = IMPOSTOR_YAW_STEPS * tileSize;
+    const unsigned int height = IMPOSTOR_PITCH_STEPS * tileSize;
+    unsigned int levels = 1;
+    while((tileSize >> levels) >= 4)
+    {
+        levels++;
+    }
+    const unsigned int layers = static_cast<unsigned int>(models.size());
+    atlas.color = detail::createLayers(width, height, layers, levels);
+    atlas.normal = detail::createLayers(width, height, layers, levels);
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    GLuint framebuffer = 0;
+    GLuint depth = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    /* the models use the current materials, emission does not show in color.frag */
+    materialUpload();
+    RenderQueue queue;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+
+    for(unsigned int layer = 0; layer < layers; layer++)
+    {
+        const Model& model = *models[layer];
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas.color, 0, static_cast<GLint>(layer));
+        detail::renderTiles(queue, model, colorProgram, tileSize);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas.normal, 0, static_cast<GLint>(layer));
+        detail::renderTiles(queue, model, normalProgram, tileSize);
+
+        atlas.ranges.push_back({static_cast<unsigned int>(indices.size()), 6});
+        const unsigned int first = static_cast<unsigned int>(vertices.size());
+        const float corners[4][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+        for(const auto& corner : corners)
+        {
+            Vertex& vertex = vertices.emplace_back();
+            vertex.pos = model.mesh.boundsCenter;
+            vertex.normal = Vector4D(corner[0], corner[1], model.mesh.boundsRadius, 0.0f);
+            vertex.uv = Vector2D(static_cast<float>(layer), 0.0f);
+        }
+        for(unsigned int i : {0u, 1u, 2u, 0u, 2u, 3u})
+        {
+            indices.push_back(first + i);
+        }
+    }
+
+    renderQueueDelete(queue);
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth);
+
+    for(GLuint texture : {atlas.color, atlas.normal})
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    atlas.quads = meshCreate(vertices, indices, GL_STATIC_DRAW, GL_STATIC_DRAW);
+    glCheckError();
+
+    return atlas;
+}
+
+int impostorAtlasFind(const ImpostorAtlas &atlas, const Model *model)
+{
+    auto it = std::find(atlas.models.begin(), atlas.models.end(), model);
+    return it == atlas.models.end() ? -1 : static_cast<int>(it - atlas.models.begin());
+}
+
+void impostorAtlasBind(const ImpostorAtlas &atlas)
+{
+    glActiveTexture(GL_TEXTURE0 + ImpostorColorUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.color);
+    glActiveTexture(GL_TEXTURE0 + ImpostorNormalUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.normal);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void impostorAtlasDelete(ImpostorAtlas &atlas)
+{
+    glDeleteTextures(1, &atlas.color);
+    glDeleteTextures(1, &atlas.normal);
+    if(atlas.quads.vao != 0)
+    {
+        meshDelete(atlas.quads);
+    }
+    atlas = ImpostorAtlas{};
+}
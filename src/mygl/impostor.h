@@ -0,0 +1,71 @@
+#pragma once
+
+#include "model.h"
+#include "renderqueue.h"
+
+#include <vector>
+
+/* views per model in the atlas: yaw steps around the object space y axis times pitch steps from the horizon (0) up to
+ * the pole (90 degrees), impostor.vert selects the view with the same layout */
+constexpr unsigned int IMPOSTOR_YAW_STEPS = 8;
+constexpr unsigned int IMPOSTOR_PITCH_STEPS = 4;
+
+/*
+ * Pre-rendered views of models for drawing distant instances as a single quad. Every model gets one layer of two
+ * texture arrays, the layer holds a grid of IMPOSTOR_YAW_STEPS x IMPOSTOR_PITCH_STEPS tiles with orthographic views of
+ * its bounding sphere. The color array stores the diffuse color with the coverage in alpha, the normal array the object
+ * space normals (n * 0.5 + 0.5), both are cleared to 0, so the color of partially covered texels is premultiplied by
+ * the coverage in every mip level.
+ * The quad of a model is drawn instanced like the model itself (see RenderCommand), impostor.vert picks the tile closest
+ * to the direction of the camera in object space and places the quad perpendicular to the view of that tile.
+ */
+struct ImpostorAtlas
+{
+    GLuint color = 0;           // GL_TEXTURE_2D_ARRAY, bound to ImpostorColorUnit
+    GLuint normal = 0;          // GL_TEXTURE_2D_ARRAY, bound to ImpostorNormalUnit
+    unsigned int tileSize = 0;  // pixels per tile side
+
+    /* one quad per model, 4 vertices with the bounding sphere in position and the corner and radius in normal */
+    Mesh quads;
+    std::vector<const Model*> models;
+    std::vector<IndexRange> ranges;
+};
+
+/**
+ * @brief Renders the full detail level of every model into the tiles of its layer and creates the quads. Has to run on
+ * the OpenGL thread with depth testing enabled, the framebuffer binding and the viewport are restored.
+ *
+ * @param models Models to render, they have to stay valid while the atlas is used.
+ * @param colorProgram Program writing the diffuse color with alpha 1 (color.frag).
+ * @param normalProgram Program writing (n * 0.5 + 0.5) of the world space normal with alpha 1 (normal.frag), the models
+ * are rendered with identity transforms, so this is the object space normal.
+ * @param tileSize Pixels per tile side.
+ *
+ * @return Atlas with one layer per model.
+ */
+ImpostorAtlas impostorAtlasCreate(const std::vector<const Model*>& models, const RenderProgram& colorProgram,
+                                  const RenderProgram& normalProgram, unsigned int tileSize);
+
+/**
+ * @brief Looks up the layer of a model.
+ *
+ * @param atlas Atlas to search.
+ * @param model Model to find.
+ *
+ * @return Index into ImpostorAtlas::ranges, -1 if the model has no impostor.
+ */
+int impostorAtlasFind(const ImpostorAtlas& atlas, const Model* model);
+
+/**
+ * @brief Binds the texture arrays to ImpostorColorUnit and ImpostorNormalUnit.
+ *
+ * @param atlas Atlas to bind.
+ */
+void impostorAtlasBind(const ImpostorAtlas& atlas);
+
+/**
+ * @brief Deletes the textures and the quads of an atlas.
+ *
+ * @param atlas Atlas to delete.
+ */
+void impostorAtlasDelete(ImpostorAtlas& atlas);
@@ -0,0 +1,219 @@
+#include "loader.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace detail
+{
+
+void loaderWorker(AssetLoader& loader)
+{
+    while(true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(loader.mutex);
+            loader.wake.wait(lock, [&loader] { return loader.stop || !loader.jobs.empty(); });
+            if(loader.stop)
+            {
+                return;
+            }
+            job = std::move(loader.jobs.front());
+            loader.jobs.pop_front();
+        }
+
+        try
+        {
+            job();
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(loader.mutex);
+            if(!loader.error)
+            {
+                loader.error = std::current_exception();
+            }
+        }
+    }
+}
+
+void loaderQueueJob(AssetLoader& loader, std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.jobs.push_back(std::move(job));
+    }
+    loader.wake.notify_one();
+    loader.pending++;
+}
+
+void loaderQueueUploads(AssetLoader& loader, std::vector<AssetUpload>& uploads)
+{
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    for(auto& upload : uploads)
+    {
+        loader.uploads.push_back(std::move(upload));
+    }
+}
+
+}
+
+void loaderStart(AssetLoader &loader, unsigned int workerCount)
+{
+    loader.stop = false;
+    for(unsigned int i = 0; i < std::max(workerCount, 1u); i++)
+    {
+        loader.workers.emplace_back(detail::loaderWorker, std::ref(loader));
+    }
+}
+
+void loaderRequestModel(AssetLoader &loader, const std::string &filepath, const ModelLoadOptions &options,
+                        std::function<void(const Model&)> onModel, std::function<void()> onDone)
+{
+    detail::loaderQueueJob(loader, [&loader, filepath, options, onModel, onDone]
+    {
+        auto data = std::make_shared<std::vector<ModelData>>(modelLoadData(filepath, options));
+        const MeshBox box = options.sharedQuantization ? modelBox(*data) : MeshBox{};
+
+        /* one upload per object, the last one also finishes the request */
+        std::vector<AssetUpload> uploads;
+        for(std::size_t i = 0; i < data->size(); i++)
+        {
+            const ModelData& d = (*data)[i];
+            const bool last = i + 1 == data->size();
+
+            AssetUpload& upload = uploads.emplace_back();
+            upload.bytes = d.vertices.size() * sizeof(Vertex) + d.indices.size() * sizeof(unsigned int);
+            upload.upload = [&loader, data, box, i, last, options, onModel, onDone]
+            {
+                ModelData& d = (*data)[i];
+
+                Model model;
+                model.name = d.name;
+                model.material = modelInternMaterials(d.materials, d.material, !d.parts.empty());
+                model.vertexMaterialCount = d.parts.empty() ? 0 : static_cast<unsigned int>(d.materials.size());
+                model.lods = d.lods;
+                model.meshlets = d.meshlets;
+                model.instances = d.instances;
+                model.parts = d.parts;
+                modelComputeBounds(model, d.vertices.data(), d.indices.data());
+                model.mesh = modelMeshCreate(d.vertices.data(), d.vertices.size(), d.indices.data(), d.indices.size(), options,
+                                             options.sharedQuantization ? &box : nullptr);
+                modelKeepOccluder(model, d.vertices.data(), d.vertices.size(), d.indices.data(), options);
+                d = ModelData{};
+
+                onModel(model);
+                if(last)
+                {
+                    if(onDone)
+                    {
+                        onDone();
+                    }
+                    loader.pending--;
+                }
+            };
+        }
+
+        if(uploads.empty())
+        {
+            AssetUpload& upload = uploads.emplace_back();
+            upload.upload = [&loader, onDone]
+            {
+                if(onDone)
+                {
+                    onDone();
+                }
+                loader.pending--;
+            };
+        }
+
+        detail::loaderQueueUploads(loader, uploads);
+    });
+}
+
+void loaderRequestShader(AssetLoader &loader, const std::string &vertexPath, const std::string &fragmentPath,
+                         std::function<void(const ShaderProgram&)> onReady)
+{
+    detail::loaderQueueJob(loader, [&loader, vertexPath, fragmentPath, onReady]
+    {
+        auto vertexSource = std::make_shared<std::string>();
+        auto fragmentSource = std::make_shared<std::string>();
+        shaderSourceLoad(vertexPath, fragmentPath, *vertexSource, *fragmentSource);
+
+        std::vector<AssetUpload> uploads(1);
+        uploads[0].bytes = vertexSource->size() + fragmentSource->size();
+        uploads[0].upload = [&loader, vertexSource, fragmentSource, onReady]
+        {
+            onReady(shaderCreate(*vertexSource, *fragmentSource));
+            loader.pending--;
+        };
+
+        detail::loaderQueueUploads(loader, uploads);
+    });
+}
+
+void loaderRequestTask(AssetLoader &loader, std::function<std::function<void()>(const std::atomic<bool>&)> work)
+{
+    detail::loaderQueueJob(loader, [&loader, work]
+    {
+        /* the result is no vertex data, so it doesn't count against the budget */
+        std::vector<AssetUpload> uploads(1);
+        uploads[0].upload = [&loader, install = work(loader.stop)]
+        {
+            install();
+            loader.pending--;
+        };
+
+        detail::loaderQueueUploads(loader, uploads);
+    });
+}
+
+bool loaderUpdate(AssetLoader &loader, std::size_t byteBudget)
+{
+    std::size_t uploaded = 0;
+    bool first = true;
+
+    while(loader.pending > 0)
+    {
+        AssetUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(loader.mutex);
+            if(loader.error)
+            {
+                std::exception_ptr error = loader.error;
+                loader.error = nullptr;
+                std::rethrow_exception(error);
+            }
+            if(loader.uploads.empty() || (!first && uploaded + loader.uploads.front().bytes > byteBudget))
+            {
+                break;
+            }
+            upload = std::move(loader.uploads.front());
+            loader.uploads.pop_front();
+        }
+
+        upload.upload();
+        uploaded += upload.bytes;
+        first = false;
+    }
+
+    return loader.pending > 0;
+}
+
+void loaderStop(AssetLoader &loader)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.stop = true;
+        loader.jobs.clear();
+        loader.uploads.clear();
+    }
+    loader.wake.notify_all();
+
+    for(auto& worker : loader.workers)
+    {
+        worker.join();
+    }
+    loader.workers.clear();
+    loader.pending = 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "model.h"
+#include "shader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* finished CPU side work waiting for the OpenGL thread */
+struct AssetUpload
+{
+    std::size_t bytes = 0;          // cost against the per frame budget
+    std::function<void()> upload;   // runs on the OpenGL thread
+};
+
+/*
+ * Loads assets in the background: worker threads read and parse the files (OBJ/MTL via the mesh cache, shader
+ * sources) and queue the results, the OpenGL thread uploads them in loaderUpdate(...) under a per frame budget.
+ * Every finished part is handed to the callback of its request, so the scene can be drawn while it is still loading.
+ */
+struct AssetLoader
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> jobs;
+    std::deque<AssetUpload> uploads;
+    std::exception_ptr error;
+    std::atomic<bool> stop{false};  // also polled by long running tasks (see loaderRequestTask(...))
+
+    /* requests that are not completely uploaded yet, only used on the OpenGL thread */
+    std::size_t pending = 0;
+};
+
+/**
+ * @brief Starts the worker threads of a loader.
+ *
+ * @param loader Loader to start.
+ * @param workerCount Number of worker threads (each model is parsed with multiple threads on its own).
+ */
+void loaderStart(AssetLoader& loader, unsigned int workerCount = 2);
+
+/**
+ * @brief Requests all objects of an OBJ file. The file is loaded on a worker thread and the meshes are created one by
+ * one in loaderUpdate(...).
+ *
+ * @param loader Started loader.
+ * @param filepath Path to the OBJ file.
+ * @param options Load options (see modelLoad(...)), an arena is only used on the OpenGL thread.
+ * @param onModel Called on the OpenGL thread for each object after its mesh was created, in file order.
+ * @param onDone Called on the OpenGL thread after the last object (optional).
+ */
+void loaderRequestModel(AssetLoader& loader, const std::string& filepath, const ModelLoadOptions& options,
+                        std::function<void(const Model&)> onModel, std::function<void()> onDone = nullptr);
+
+/**
+ * @brief Requests a shader program. The sources are read on a worker thread and compiled in loaderUpdate(...).
+ *
+ * @param loader Started loader.
+ * @param vertexPath Path to vertex shader file.
+ * @param fragmentPath Path to fragment shader file.
+ * @param onReady Called on the OpenGL thread with the linked program.
+ */
+void loaderRequestShader(AssetLoader& loader, const std::string& vertexPath, const std::string& fragmentPath,
+                         std::function<void(const ShaderProgram&)> onReady);
+
+/**
+ * @brief Requests CPU work on loaded assets, e.g. baking data from the CPU copies of models. The work runs on a worker
+ * thread, the function it returns installs the result in loaderUpdate(...).
+ *
+ * @param loader Started loader.
+ * @param work Runs on a worker thread, gets the stop flag of the loader to return early when it is set. It may only read
+ * data the OpenGL thread doesn't change meanwhile.
+ */
+void loaderRequestTask(AssetLoader& loader, std::function<std::function<void()>(const std::atomic<bool>& stop)> work);
+
+/**
+ * @brief Runs queued uploads on the OpenGL thread until the budget is used up. At least one upload runs per call, so
+ * uploads larger than the budget still make progress. Errors of the worker threads are rethrown here.
+ *
+ * @param loader Started loader.
+ * @param byteBudget Maximum number of bytes (vertex/index data, shader sources) to upload in this call.
+ *
+ * @return True while requests are still loading.
+ */
+bool loaderUpdate(AssetLoader& loader, std::size_t byteBudget);
+
+/**
+ * @brief Stops the worker threads, requests that did not finish yet are dropped.
+ *
+ * @param loader Loader to stop.
+ */
+void loaderStop(AssetLoader& loader);
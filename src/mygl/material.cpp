@@ -0,0 +1,151 @@
+#include "material.h"
+#include "mesh.h"
+#include "shader.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace detail
+{
+
+void copyColor(float out[4], const Vector3D& color, float w)
+{
+    out[0] = color.x;
+    out[1] = color.y;
+    out[2] = color.z;
+    out[3] = w;
+}
+
+}
+
+MaterialTable& materialTable()
+{
+    static MaterialTable table;
+    return table;
+}
+
+bool materialEqual(const Material &a, const Material &b)
+{
+    return a.name == b.name && a.shininess == b.shininess &&
+           std::memcmp(&a.emission, &b.emission, sizeof(Vector3D)) == 0 &&
+           std::memcmp(&a.ambient, &b.ambient, sizeof(Vector3D)) == 0 &&
+           std::memcmp(&a.diffuse, &b.diffuse, sizeof(Vector3D)) == 0 &&
+           std::memcmp(&a.specular, &b.specular, sizeof(Vector3D)) == 0;
+}
+
+unsigned int materialIntern(const Material &material)
+{
+    MaterialTable& table = materialTable();
+
+    auto [begin, end] = table.ids.equal_range(material.name);
+    for(auto it = begin; it != end; ++it)
+    {
+        if(materialEqual(table.materials[it->second], material))
+        {
+            return it->second;
+        }
+    }
+
+    if(table.materials.size() >= MATERIAL_MAX_COUNT)
+    {
+        throw std::runtime_error("[Material] more than " + std::to_string(MATERIAL_MAX_COUNT) + " materials");
+    }
+
+    const unsigned int id = static_cast<unsigned int>(table.materials.size());
+    table.materials.push_back(material);
+    table.ids.emplace(material.name, id);
+    table.dirty = true;
+    return id;
+}
+
+unsigned int materialInternBlock(const std::vector<Material> &materials)
+{
+    MaterialTable& table = materialTable();
+
+    for(std::size_t first = 0; first + materials.size() <= table.materials.size() && !materials.empty(); first++)
+    {
+        std::size_t i = 0;
+        while(i < materials.size() && materialEqual(table.materials[first + i], materials[i]))
+        {
+            i++;
+        }
+        if(i == materials.size())
+        {
+            return static_cast<unsigned int>(first);
+        }
+    }
+
+    if(table.materials.size() + materials.size() > MATERIAL_MAX_COUNT)
+    {
+        throw std::runtime_error("[Material] more than " + std::to_string(MATERIAL_MAX_COUNT) + " materials");
+    }
+
+    const unsigned int first = static_cast<unsigned int>(table.materials.size());
+    for(const auto& material : materials)
+    {
+        table.ids.emplace(material.name, static_cast<unsigned int>(table.materials.size()));
+        table.materials.push_back(material);
+    }
+    table.dirty = true;
+    return first;
+}
+
+const Material& materialGet(unsigned int id)
+{
+    return materialTable().materials.at(id);
+}
+
+void materialSetEmission(unsigned int id, const Vector3D &emission)
+{
+    MaterialTable& table = materialTable();
+    table.materials.at(id).emission = emission;
+    table.dirty = true;
+}
+
+void materialUpload()
+{
+    MaterialTable& table = materialTable();
+
+    if(table.ubo == 0)
+    {
+        /* the buffer always covers the whole array of the block */
+        glGenBuffers(1, &table.ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, table.ubo);
+        glBufferData(GL_UNIFORM_BUFFER, MATERIAL_MAX_COUNT * sizeof(MaterialGpu), nullptr, GL_DYNAMIC_DRAW);
+        table.dirty = true;
+    }
+
+    if(table.dirty)
+    {
+        std::vector<MaterialGpu> data(table.materials.size());
+        for(std::size_t i = 0; i < table.materials.size(); i++)
+        {
+            const Material& material = table.materials[i];
+            detail::copyColor(data[i].diffuse, material.diffuse, 1.0f);
+            detail::copyColor(data[i].emission, material.emission, 1.0f);
+            detail::copyColor(data[i].ambient, material.ambient, 1.0f);
+            detail::copyColor(data[i].specular, material.specular, material.shininess);
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, table.ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, data.size() * sizeof(MaterialGpu), data.data());
+        table.dirty = false;
+    }
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, MaterialBinding, table.ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glCheckError();
+}
+
+void materialBind(unsigned int id)
+{
+    /* the attribute array is never enabled, so every vertex reads this constant */
+    glVertexAttribI1ui(eDataIdx::MaterialId, id);
+}
+
+void materialTableDelete()
+{
+    MaterialTable& table = materialTable();
+    glDeleteBuffers(1, &table.ubo);
+    table = MaterialTable{};
+}
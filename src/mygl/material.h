@@ -0,0 +1,122 @@
+#pragma once
+
+#include "base.h"
+
+#include <map>
+#include <vector>
+
+struct Material
+{
+    std::string name;
+
+    Vector3D emission;
+    Vector3D ambient;
+    Vector3D diffuse;
+    Vector3D specular;
+    float shininess = 0.0f;
+};
+
+/* triangles of a model that are drawn with one material */
+struct MaterialRange
+{
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    unsigned int materialId = 0;   // index into the material table (or into ModelData::materials before interning)
+};
+
+/* std140 layout of a material in the MaterialBlock uniform block (see color.frag) */
+struct MaterialGpu
+{
+    float diffuse[4];
+    float emission[4];
+    float ambient[4];
+    float specular[4];   // w is the shininess
+};
+
+/* size of the material array in the uniform block, 256 * 64 bytes is the minimum block size OpenGL guarantees */
+constexpr unsigned int MATERIAL_MAX_COUNT = 256;
+
+/*
+ * All materials of the loaded models, each distinct material is stored once and referenced by its index (material
+ * id). The table is mirrored into a uniform buffer that the shaders index with the material id of the draw, which is
+ * passed as the constant vertex attribute eDataIdx::MaterialId (see materialBind(...)).
+ */
+struct MaterialTable
+{
+    std::vector<Material> materials;
+
+    /* name -> ids of the materials with that name (different files may use the same name) */
+    std::multimap<std::string, unsigned int> ids;
+
+    GLuint ubo = 0;
+    bool dirty = false;   // materials changed since the last upload
+};
+
+/**
+ * @brief The material table shared by all models.
+ *
+ * @return Global material table.
+ */
+MaterialTable& materialTable();
+
+/**
+ * @brief Compares name and properties of two materials.
+ *
+ * @return True if both materials are identical.
+ */
+bool materialEqual(const Material& a, const Material& b);
+
+/**
+ * @brief Adds a material to the table unless an identical material is already stored.
+ *
+ * @param material Material to add.
+ *
+ * @return Id of the material in the table.
+ */
+unsigned int materialIntern(const Material& material);
+
+/**
+ * @brief Adds materials to the table as a block of consecutive ids, unless an identical block is already stored. Models
+ * whose vertices select their material (see VERTEX_PART_COUNT in mesh.h) address them relative to the first id.
+ *
+ * @param materials Materials to add, in block order.
+ *
+ * @return Id of the first material of the block in the table.
+ */
+unsigned int materialInternBlock(const std::vector<Material>& materials);
+
+/**
+ * @brief Material of an id.
+ *
+ * @param id Material id (see materialIntern(...)).
+ *
+ * @return Material stored in the table.
+ */
+const Material& materialGet(unsigned int id);
+
+/**
+ * @brief Changes the emission of a material, e.g. to switch lights on and off. Affects every model that uses the
+ * material, the uniform buffer is updated with the next materialUpload().
+ *
+ * @param id Material id.
+ * @param emission New emission color.
+ */
+void materialSetEmission(unsigned int id, const Vector3D& emission);
+
+/**
+ * @brief Uploads changed materials into the uniform buffer and binds it to its binding point (see eUniformBinding in
+ * shader.h). Has to be called before drawing with material ids, does nothing if no material changed.
+ */
+void materialUpload();
+
+/**
+ * @brief Selects the material of the following draw calls.
+ *
+ * @param id Material id.
+ */
+void materialBind(unsigned int id);
+
+/**
+ * @brief Deletes the uniform buffer and clears the table. Has to be called before the OpenGL context is destroyed.
+ */
+void materialTableDelete();
@@ -1,42 +1,370 @@
 #include "mesh.h"
+#include "mesharena.h"
 
-Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, GLenum vertexBufferUsage, GLenum indexBufferUsage)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace detail
+{
+
+/* IEEE 754 binary16 with round to nearest, values outside the half range become +-inf */
+std::uint16_t floatToHalf(float value)
 {
-    GLuint vao = 0, vbo = 0, ebo = 0;
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
 
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    const std::uint32_t sign = (bits >> 16) & 0x8000u;
+    const std::uint32_t exponent = (bits >> 23) & 0xffu;
+    std::uint32_t mantissa = bits & 0x7fffffu;
 
-    glBindVertexArray(vao);
+    if(exponent == 0xffu)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
-        glCheckError();
+        return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
-        glCheckError();
+    const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    if(halfExponent >= 31)
+    {
+        return static_cast<std::uint16_t>(sign | 0x7c00u);
+    }
+
+    if(halfExponent <= 0)
+    {
+        /* subnormal half */
+        if(halfExponent < -10)
+        {
+            return static_cast<std::uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        const unsigned int shift = static_cast<unsigned int>(14 - halfExponent);
+        std::uint32_t half = mantissa >> shift;
+        half += (mantissa >> (shift - 1)) & 1u;
+        return static_cast<std::uint16_t>(sign | half);
+    }
+
+    /* a carry out of the mantissa correctly increments the exponent */
+    std::uint32_t half = sign | (static_cast<std::uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1u;
+    return static_cast<std::uint16_t>(half);
+}
+
+std::int16_t quantize(float value)
+{
+    return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+/* octahedral normal encoding (Meyer et al., "On Floating-Point Normal Vectors") */
+void octEncode(const Vector4D& normal, std::int16_t out[2])
+{
+    const float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if(length == 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = normal.x / length;
+    float y = normal.y / length;
+    if(normal.z < 0.0f)
+    {
+        const float folded = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded;
+    }
+
+    out[0] = quantize(x);
+    out[1] = quantize(y);
+}
+
+}
+
+MeshBox meshBox(const Vertex *vertices, std::size_t vertexCount)
+{
+    MeshBox box;
+    for(std::size_t i = 0; i < vertexCount; i++)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            box.min[k] = std::min(box.min[k], vertices[i].pos[k]);
+            box.max[k] = std::max(box.max[k], vertices[i].pos[k]);
+        }
+    }
+    return box;
+}
+
+void meshBoxExtend(MeshBox &box, const MeshBox &other)
+{
+    for(unsigned int k = 0; k < 3; k++)
+    {
+        box.min[k] = std::min(box.min[k], other.min[k]);
+        box.max[k] = std::max(box.max[k], other.max[k]);
+    }
+}
+
+std::vector<PackedVertex> meshPackVertices(const Vertex* vertices, std::size_t vertexCount, Vector3D& posScale, Vector3D& posOffset,
+                                           const MeshBox* box)
+{
+    const MeshBox bounds = box ? *box : meshBox(vertices, vertexCount);
+
+    Vector3D center, extent(1.0f, 1.0f, 1.0f);
+    if(bounds.min.x <= bounds.max.x)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            center[k] = 0.5f * (bounds.min[k] + bounds.max[k]);
+            extent[k] = std::max(0.5f * (bounds.max[k] - bounds.min[k]), std::numeric_limits<float>::min());
+        }
+    }
+
+    std::vector<PackedVertex> packed(vertexCount);
+    for(std::size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& p = packed[i];
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            p.pos[k] = detail::quantize((vertex.pos[k] - center[k]) / extent[k]);
+        }
+        p.pos[3] = static_cast<std::int16_t>(vertex.normal.w);
+        detail::octEncode(vertex.normal, p.normal);
+        p.uv[0] = detail::floatToHalf(vertex.uv.x);
+        p.uv[1] = detail::floatToHalf(vertex.uv.y);
+    }
+
+    posScale = extent / 32767.0f;
+    posOffset = center;
+    return packed;
+}
+
+void meshComputeBounds(Mesh &mesh, const Vertex *vertices, std::size_t vertexCount)
+{
+    mesh.boundsBox = meshBox(vertices, vertexCount);
+    if(vertexCount == 0)
+    {
+        mesh.boundsCenter = Vector3D(0.0f, 0.0f, 0.0f);
+        mesh.boundsRadius = 0.0f;
+        return;
+    }
+
+    mesh.boundsCenter = 0.5f * (mesh.boundsBox.min + mesh.boundsBox.max);
+    float radius = 0.0f;
+    for(std::size_t i = 0; i < vertexCount; i++)
+    {
+        radius = std::max(radius, length(vertices[i].pos - mesh.boundsCenter));
+    }
+    mesh.boundsRadius = radius;
+}
+
+MeshBounds meshRangeBounds(const Vertex *vertices, const unsigned int *indices, IndexRange range)
+{
+    MeshBounds bounds;
+    if(range.count == 0)
+    {
+        return bounds;
+    }
+
+    for(unsigned int i = range.offset; i < range.offset + range.count; i++)
+    {
+        const Vector3D& pos = vertices[indices[i]].pos;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            bounds.box.min[k] = std::min(bounds.box.min[k], pos[k]);
+            bounds.box.max[k] = std::max(bounds.box.max[k], pos[k]);
+        }
+    }
+
+    bounds.center = 0.5f * (bounds.box.min + bounds.box.max);
+    for(unsigned int i = range.offset; i < range.offset + range.count; i++)
+    {
+        bounds.radius = std::max(bounds.radius, length(vertices[indices[i]].pos - bounds.center));
+    }
+    return bounds;
+}
 
-        glEnableVertexAttribArray(eDataIdx::Position);
-        glEnableVertexAttribArray(eDataIdx::Normal);
-        glEnableVertexAttribArray(eDataIdx::UV);
+void meshVertexAttributes(eVertexFormat format)
+{
+    glEnableVertexAttribArray(eDataIdx::Position);
+    glEnableVertexAttribArray(eDataIdx::Normal);
+    glEnableVertexAttribArray(eDataIdx::UV);
+    glEnableVertexAttribArray(eDataIdx::Part);
+    if(format == VertexPacked)
+    {
+        /* integers are passed unnormalized, the scale is folded into uPosScale and the normal decode */
+        glVertexAttribPointer(eDataIdx::Position,   3, GL_SHORT,      GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, pos));
+        glVertexAttribPointer(eDataIdx::Normal,     2, GL_SHORT,      GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, normal));
+        glVertexAttribPointer(eDataIdx::UV,         2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*) offsetof(PackedVertex, uv));
+        glVertexAttribPointer(eDataIdx::Part,       1, GL_SHORT,      GL_FALSE, sizeof(PackedVertex), (void*) (offsetof(PackedVertex, pos) + 3 * sizeof(std::int16_t)));
+    }
+    else
+    {
         glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
         glVertexAttribPointer(eDataIdx::Normal,     3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
         glVertexAttribPointer(eDataIdx::UV,         2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, uv));
+        glVertexAttribPointer(eDataIdx::Part,       1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) (offsetof(Vertex, normal) + 3 * sizeof(float)));
+    }
+}
+
+std::size_t meshPositionSize(eVertexFormat format)
+{
+    return format == VertexPacked ? sizeof(PackedVertex::pos) : 4 * sizeof(float);
+}
+
+std::vector<unsigned char> meshPositionStream(const void *vertexData, std::size_t vertexCount, eVertexFormat format)
+{
+    static_assert(offsetof(Vertex, pos) == 0 && offsetof(PackedVertex, pos) == 0, "positions have to come first");
+
+    const std::size_t vertexSize = format == VertexPacked ? sizeof(PackedVertex) : sizeof(Vertex);
+    const std::size_t positionSize = meshPositionSize(format);
+    const unsigned char* vertices = static_cast<const unsigned char*>(vertexData);
+
+    std::vector<unsigned char> positions(vertexCount * positionSize);
+    for(std::size_t i = 0; i < vertexCount; i++)
+    {
+        unsigned char* position = positions.data() + i * positionSize;
+        const unsigned char* vertex = vertices + i * vertexSize;
+        if(format == VertexPacked)
+        {
+            std::memcpy(position, vertex, positionSize);
+        }
+        else
+        {
+            std::memcpy(position, vertex + offsetof(Vertex, pos), sizeof(Vertex::pos));
+            std::memcpy(position + sizeof(Vertex::pos), vertex + offsetof(Vertex, normal) + 3 * sizeof(float), sizeof(float));
+        }
+    }
+    return positions;
+}
+
+void meshPositionAttributes(eVertexFormat format)
+{
+    const GLsizei stride = static_cast<GLsizei>(meshPositionSize(format));
+    glEnableVertexAttribArray(eDataIdx::Position);
+    glEnableVertexAttribArray(eDataIdx::Part);
+    if(format == VertexPacked)
+    {
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_SHORT, GL_FALSE, stride, nullptr);
+        glVertexAttribPointer(eDataIdx::Part,     1, GL_SHORT, GL_FALSE, stride, (void*) (3 * sizeof(std::int16_t)));
+    }
+    else
+    {
+        glVertexAttribPointer(eDataIdx::Position, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+        glVertexAttribPointer(eDataIdx::Part,     1, GL_FLOAT, GL_FALSE, stride, (void*) (3 * sizeof(float)));
+    }
+}
+
+Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format, const MeshBox* quantizationBox, bool positionStream)
+{
+    return meshCreate(vertices.data(), vertices.size(), indices.data(), indices.size(), vertexBufferUsage, indexBufferUsage, format, quantizationBox, positionStream);
+}
+
+Mesh meshCreate(const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices, std::size_t indexCount, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format, const MeshBox* quantizationBox, bool positionStream)
+{
+    Mesh mesh;
+    mesh.size_vbo = (unsigned int) vertexCount;
+    mesh.size_ibo = (unsigned int) indexCount;
+    mesh.format = format;
+    meshComputeBounds(mesh, vertices, vertexCount);
+
+    /* converted data has to outlive the glBufferData calls */
+    std::vector<PackedVertex> packedVertices;
+    std::vector<std::uint16_t> shortIndices;
+
+    const void* vertexData = vertices;
+    std::size_t vertexSize = sizeof(Vertex);
+    const void* indexData = indices;
+
+    if(format == VertexPacked)
+    {
+        packedVertices = meshPackVertices(vertices, vertexCount, mesh.posScale, mesh.posOffset, quantizationBox);
+        vertexData = packedVertices.data();
+        vertexSize = sizeof(PackedVertex);
+
+        if(vertexCount <= 65536)
+        {
+            shortIndices.assign(indices, indices + indexCount);
+            indexData = shortIndices.data();
+            mesh.indexType = GL_UNSIGNED_SHORT;
+        }
+    }
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+
+    glBindVertexArray(mesh.vao);
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, vertexData, vertexBufferUsage);
         glCheckError();
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * meshIndexSize(mesh), indexData, indexBufferUsage);
+        glCheckError();
+
+        meshVertexAttributes(format);
+        glCheckError();
+    }
+
+    /* the position stream reuses the element buffer */
+    if(positionStream)
+    {
+        const std::vector<unsigned char> positions = meshPositionStream(vertexData, vertexCount, format);
+        glGenVertexArrays(1, &mesh.positionVao);
+        glGenBuffers(1, &mesh.positionVbo);
+
+        glBindVertexArray(mesh.positionVao);
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVbo);
+            glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), vertexBufferUsage);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+            meshPositionAttributes(format);
+            glCheckError();
+        }
     }
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
+    return mesh;
+}
+
+void meshDraw(const Mesh &mesh, unsigned int indexOffset, unsigned int indexCount)
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (const void*) ((mesh.firstIndex + indexOffset) * meshIndexSize(mesh)), mesh.baseVertex);
+}
+
+void meshDrawInstanced(const Mesh &mesh, unsigned int indexOffset, unsigned int indexCount, unsigned int instanceCount)
+{
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, (const void*) ((mesh.firstIndex + indexOffset) * meshIndexSize(mesh)),
+                                      instanceCount, mesh.baseVertex);
+}
+
+void meshDrawIndirect(const Mesh &mesh, std::size_t commandOffset)
+{
+    glDrawElementsIndirect(GL_TRIANGLES, mesh.indexType, (const void*) commandOffset);
+}
+
+std::size_t meshIndexSize(const Mesh &mesh)
+{
+    return mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(unsigned int);
 }
 
 void meshDelete(const Mesh &mesh)
 {
+    if(mesh.arena)
+    {
+        meshArenaFree(*mesh.arena, mesh);
+        return;
+    }
+
     glDeleteBuffers(1, &mesh.vbo);
     glDeleteBuffers(1, &mesh.ebo);
     glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.positionVbo);
+    glDeleteVertexArrays(1, &mesh.positionVao);
 }
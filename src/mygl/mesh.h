@@ -2,17 +2,77 @@
 
 #include "base.h"
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 
-enum eDataIdx { Position = 0, Normal = 1, UV = 2 };
+enum eDataIdx { Position = 0, Normal = 1, UV = 2, MaterialId = 3, TransformId = 4, Part = 5, VisibleList = 6 };
+
+/* layout of the vertex buffer of a mesh */
+enum eVertexFormat { VertexFloat = 0, VertexPacked = 1 };
+
+/* the part value of a vertex holds the part index of merged models (see ModelLoadOptions::mergeObjects) below and the
+ * material of the vertex relative to the material id of the draw above VERTEX_PART_COUNT:
+ *   value = part + VERTEX_PART_COUNT * material
+ * it is 0 for all other models */
+constexpr unsigned int VERTEX_PART_COUNT = 256;
 
 struct Vertex
 {
     Vector3D pos;
-    Vector4D normal;
+    Vector4D normal;    // w is the part value (see VERTEX_PART_COUNT)
     Vector2D uv;
 };
 
+/*
+ * Compact GPU layout (16 instead of 36 bytes per vertex), created from Vertex by meshCreate(...) with VertexPacked.
+ * The vertex shader decodes it:
+ *   position = pos.xyz * uPosScale + uPosOffset   (quantized to int16 within the bounding box of the mesh)
+ *   normal   = octDecode(normal / 32767)           (octahedral encoding, int16 per component)
+ *   uv       = half floats, converted by OpenGL
+ *   part     = pos.w                               (Vertex::normal.w, see VERTEX_PART_COUNT)
+ */
+struct PackedVertex
+{
+    std::int16_t pos[4];    // w is the part value, also keeps the following attributes 4 byte aligned
+    std::int16_t normal[2];
+    std::uint16_t uv[2];
+};
+
+/* range of a triangle list in indices */
+struct IndexRange
+{
+    unsigned int offset = 0;
+    unsigned int count = 0;
+};
+
+/* axis aligned bounding box, packed meshes quantized within the same box share posScale/posOffset */
+struct MeshBox
+{
+    Vector3D min = Vector3D(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    Vector3D max = Vector3D(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+};
+
+/* bounding volumes of a range of triangles in object space, the sphere is centered in the box */
+struct MeshBounds
+{
+    MeshBox box;
+    Vector3D center = Vector3D(0.0f, 0.0f, 0.0f);
+    float radius = 0.0f;
+};
+
+/* cluster of consecutive triangles of a draw range with the object space volumes it is culled by as a whole (see
+ * meshBuildMeshlets(...)), the triangles face away from the viewer if the direction to them is within the cone */
+struct Meshlet
+{
+    IndexRange range;
+    Vector3D center = Vector3D(0.0f, 0.0f, 0.0f);  // bounding sphere
+    float radius = 0.0f;
+    Vector3D coneAxis = Vector3D(0.0f, 0.0f, 1.0f); // average facing direction of the triangles
+    float coneCutoff = 1.0f;    // sine of the largest angle between a triangle normal and the axis, 1 never culls
+};
+
+struct MeshArena;
 
 struct Mesh
 {
@@ -20,8 +80,31 @@ struct Mesh
     GLuint vbo = 0;
     GLuint ebo = 0;
 
+    /* tightly packed copy of the positions for depth only passes, its VAO shares the index buffer (see
+     * meshPositionAttributes(...)), 0 if the mesh was created without it, depth passes then read the interleaved
+     * vertices */
+    GLuint positionVao = 0;
+    GLuint positionVbo = 0;
+
     unsigned int size_vbo = 0;
     unsigned int size_ibo = 0;
+
+    eVertexFormat format = VertexFloat;
+    GLenum indexType = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT for packed meshes with at most 65536 vertices
+
+    /* dequantization of packed positions, identity for VertexFloat */
+    Vector3D posScale = Vector3D(1.0f, 1.0f, 1.0f);
+    Vector3D posOffset = Vector3D(0.0f, 0.0f, 0.0f);
+
+    /* bounding sphere (centered in the bounding box) and bounding box of the vertices in object space */
+    Vector3D boundsCenter = Vector3D(0.0f, 0.0f, 0.0f);
+    float boundsRadius = 0.0f;
+    MeshBox boundsBox;
+
+    /* range of the mesh in the buffers of an arena (see mesharena.h), nullptr/0 for meshes with their own buffers */
+    MeshArena* arena = nullptr;
+    GLint baseVertex = 0;
+    unsigned int firstIndex = 0;
 };
 
 /**
@@ -32,6 +115,11 @@ struct Mesh
  * @param indices List of indices that form polygons in the mesh.
  * @param vertexBufferUsage enum to hint the usage of the vertex buffer (see usage parameter in glBufferData function).
  * @param indexBufferUsage enum to hint the usage of the index buffer (see usage parameter in glBufferData function).
+ * @param format Layout of the vertex buffer. VertexPacked quantizes the vertices (see PackedVertex) and stores the
+ * indices as 16 bit if possible, the shader has to decode them with the posScale/posOffset of the mesh.
+ * @param quantizationBox Box the packed positions are quantized in, nullptr for the bounding box of the vertices.
+ * @param positionStream Also upload a position stream for depth only passes (see Mesh::positionVao), it adds
+ * meshPositionSize(format) bytes per vertex.
  *
  * @return Initialized mesh structure that can be drawn with OpenGL.
  *
@@ -39,13 +127,165 @@ struct Mesh
  *
  *   Mesh myMesh = meshCreate(vertex-data, index-data, GL_STATIC_DRAW, GL_STATIC_DRAW);
  *   glBindVertexArray(myMesh.vao);
- *   glDrawElements(GL_TRIANGLES, myMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+ *   meshDraw(myMesh, 0, myMesh.size_ibo);
+ *
+ */
+Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format = VertexFloat, const MeshBox* quantizationBox = nullptr, bool positionStream = false);
+
+/**
+ * @brief Same as meshCreate(...) above, but takes the vertex and index data as plain arrays, e.g. to upload directly from
+ * memory mapped files.
+ *
+ * @param vertices Pointer to the first vertex of the mesh.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to the first index of the mesh.
+ * @param indexCount Number of indices.
+ * @param vertexBufferUsage enum to hint the usage of the vertex buffer (see usage parameter in glBufferData function).
+ * @param indexBufferUsage enum to hint the usage of the index buffer (see usage parameter in glBufferData function).
+ * @param format Layout of the vertex buffer.
+ * @param quantizationBox Box the packed positions are quantized in, nullptr for the bounding box of the vertices.
+ * @param positionStream Also upload a position stream for depth only passes.
+ *
+ * @return Initialized mesh structure that can be drawn with OpenGL.
+ */
+Mesh meshCreate(const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format = VertexFloat, const MeshBox* quantizationBox = nullptr, bool positionStream = false);
+
+/**
+ * @brief Converts vertices to the packed layout (see PackedVertex). Positions are quantized within the bounding box of
+ * the vertices or within the given box.
+ *
+ * @param vertices Pointer to the first vertex.
+ * @param vertexCount Number of vertices.
+ * @param posScale Receives the scale to dequantize the positions.
+ * @param posOffset Receives the offset to dequantize the positions.
+ * @param box Box containing all vertices, e.g. the box of several meshes that are drawn together (optional).
+ *
+ * @return Packed vertices.
+ */
+std::vector<PackedVertex> meshPackVertices(const Vertex* vertices, std::size_t vertexCount, Vector3D& posScale, Vector3D& posOffset,
+                                           const MeshBox* box = nullptr);
+
+/**
+ * @brief Bounding box of vertices.
+ *
+ * @param vertices Pointer to the first vertex.
+ * @param vertexCount Number of vertices.
+ *
+ * @return Bounding box, empty (min > max) if there are no vertices.
+ */
+MeshBox meshBox(const Vertex* vertices, std::size_t vertexCount);
+
+/**
+ * @brief Grows a box so it also contains another box.
+ *
+ * @param box Box to grow.
+ * @param other Box to include.
+ */
+void meshBoxExtend(MeshBox& box, const MeshBox& other);
+
+/**
+ * @brief Computes the bounding sphere of the vertices (centered in their bounding box) and the bounding box and stores
+ * them in the mesh.
+ *
+ * @param mesh Mesh that receives boundsCenter, boundsRadius and boundsBox.
+ * @param vertices Pointer to the first vertex.
+ * @param vertexCount Number of vertices.
+ */
+void meshComputeBounds(Mesh& mesh, const Vertex* vertices, std::size_t vertexCount);
+
+/**
+ * @brief Bounding volumes of the vertices referenced by a range of an index buffer.
+ *
+ * @param vertices Vertices of the mesh.
+ * @param indices Index buffer of the mesh.
+ * @param range Range of the index buffer.
+ *
+ * @return Bounding box and sphere, empty box and zero radius for an empty range.
+ */
+MeshBounds meshRangeBounds(const Vertex* vertices, const unsigned int* indices, IndexRange range);
+
+/**
+ * @brief Enables and sets the vertex attribute pointers for a vertex format. The VAO and the vertex buffer have to be
+ * bound.
+ *
+ * @param format Layout of the vertex buffer.
+ */
+void meshVertexAttributes(eVertexFormat format);
+
+/**
+ * @brief Bytes per vertex of the position stream of a vertex format. The stream holds the position and the part value
+ * of each vertex, as float4 for VertexFloat and as the int16 position with its w for VertexPacked.
+ *
+ * @param format Layout of the vertex buffer.
+ *
+ * @return Stride of the position stream.
+ */
+std::size_t meshPositionSize(eVertexFormat format);
+
+/**
+ * @brief Copies the positions out of interleaved vertices into a position stream.
+ *
+ * @param vertexData Vertices in the layout of format (Vertex or PackedVertex).
+ * @param vertexCount Number of vertices.
+ * @param format Layout of the vertices.
+ *
+ * @return vertexCount * meshPositionSize(format) bytes.
+ */
+std::vector<unsigned char> meshPositionStream(const void* vertexData, std::size_t vertexCount, eVertexFormat format);
+
+/**
+ * @brief Enables and sets the position and part attributes of a position stream, all other attributes stay disabled.
+ * The VAO and the position buffer have to be bound.
+ *
+ * @param format Layout of the vertices the stream was created from.
+ */
+void meshPositionAttributes(eVertexFormat format);
+
+/**
+ * @brief Draws a range of the index buffer of a mesh as triangles with the index type and base vertex of the mesh. The
+ * VAO of the mesh has to be bound.
+ *
+ * @param mesh Mesh to draw.
+ * @param indexOffset First index of the range (e.g. Material::indexOffset).
+ * @param indexCount Number of indices in the range.
+ */
+void meshDraw(const Mesh& mesh, unsigned int indexOffset, unsigned int indexCount);
+
+/**
+ * @brief Same as meshDraw(...), but draws the range instanceCount times. The shaders tell the instances apart by
+ * gl_InstanceID.
+ *
+ * @param mesh Mesh to draw.
+ * @param indexOffset First index of the range.
+ * @param indexCount Number of indices in the range.
+ * @param instanceCount Number of instances.
+ */
+void meshDrawInstanced(const Mesh& mesh, unsigned int indexOffset, unsigned int indexCount, unsigned int instanceCount);
+
+/**
+ * @brief Same as meshDrawInstanced(...), but range, base vertex and instance count are read from a
+ * DrawElementsIndirectCommand in the buffer bound to GL_DRAW_INDIRECT_BUFFER (GL_ARB_draw_indirect), e.g. one written by
+ * the GPU culling pass (see gpuCullCommands(...)).
+ *
+ * @param mesh Mesh to draw, only its index type is read.
+ * @param commandOffset Byte offset of the command in the indirect buffer.
+ */
+void meshDrawIndirect(const Mesh& mesh, std::size_t commandOffset);
+
+/**
+ * @brief Size of one index of a mesh in bytes.
+ *
+ * @param mesh Mesh to query.
  *
+ * @return 2 for GL_UNSIGNED_SHORT, 4 for GL_UNSIGNED_INT.
  */
-Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLenum vertexBufferUsage, GLenum indexBufferUsage);
+std::size_t meshIndexSize(const Mesh& mesh);
 
 /**
- * @brief Cleanup and delete all OpenGL buffers of a mesh. Has to be called for each mesh after it is not used anymore.
+ * @brief Cleanup and delete all OpenGL buffers of a mesh, meshes of an arena release their range in the arena instead.
+ * Has to be called for each mesh after it is not used anymore.
  *
  * @param mesh Mesh to delete.
  */
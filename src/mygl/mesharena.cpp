@@ -0,0 +1,275 @@
+#include "mesharena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace detail
+{
+
+/* index ranges are aligned to 4 bytes, so 16 and 32 bit ranges can be mixed in one buffer */
+constexpr std::size_t INDEX_ALIGNMENT = 4;
+
+std::size_t alignIndexBytes(std::size_t bytes)
+{
+    return (bytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+}
+
+/* first fit, returns false if no block is large enough */
+bool blockAlloc(std::vector<MeshArenaBlock>& blocks, std::size_t size, std::size_t& offset)
+{
+    for(auto it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        if(it->size >= size)
+        {
+            offset = it->offset;
+            it->offset += size;
+            it->size -= size;
+            if(it->size == 0)
+            {
+                blocks.erase(it);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void blockFree(std::vector<MeshArenaBlock>& blocks, std::size_t offset, std::size_t size)
+{
+    if(size == 0)
+    {
+        return;
+    }
+
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), offset,
+                               [](const MeshArenaBlock& block, std::size_t o) { return block.offset < o; });
+    it = blocks.insert(it, MeshArenaBlock{offset, size});
+
+    /* merge with the following and the preceding block */
+    auto next = it + 1;
+    if(next != blocks.end() && it->offset + it->size == next->offset)
+    {
+        it->size += next->size;
+        blocks.erase(next);
+    }
+    if(it != blocks.begin())
+    {
+        auto prev = it - 1;
+        if(prev->offset + prev->size == it->offset)
+        {
+            prev->size += it->size;
+            blocks.erase(it);
+        }
+    }
+}
+
+std::size_t blockTotal(const std::vector<MeshArenaBlock>& blocks, std::size_t& largest)
+{
+    std::size_t total = 0;
+    largest = 0;
+    for(const auto& block : blocks)
+    {
+        total += block.size;
+        largest = std::max(largest, block.size);
+    }
+    return total;
+}
+
+/* replaces a buffer by a larger one with the same content, the new buffer is left bound to target */
+GLuint bufferGrow(GLenum target, GLuint buffer, std::size_t oldBytes, std::size_t newBytes)
+{
+    GLuint grown = 0;
+    glGenBuffers(1, &grown);
+    glBindBuffer(target, grown);
+    glBufferData(target, newBytes, nullptr, GL_STATIC_DRAW);
+
+    if(buffer != 0 && oldBytes > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, target, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    if(buffer != 0)
+    {
+        glDeleteBuffers(1, &buffer);
+    }
+    glCheckError();
+
+    return grown;
+}
+
+void growVertices(MeshArena& arena, std::size_t required)
+{
+    const std::size_t capacity = std::max(arena.vertexCapacity * 2, arena.vertexCapacity + required);
+
+    glBindVertexArray(arena.vao);
+    arena.vbo = bufferGrow(GL_ARRAY_BUFFER, arena.vbo, arena.vertexCapacity * arena.vertexSize, capacity * arena.vertexSize);
+    meshVertexAttributes(arena.format);
+
+    if(arena.positionVao != 0)
+    {
+        const std::size_t positionSize = meshPositionSize(arena.format);
+        glBindVertexArray(arena.positionVao);
+        arena.positionVbo = bufferGrow(GL_ARRAY_BUFFER, arena.positionVbo, arena.vertexCapacity * positionSize, capacity * positionSize);
+        meshPositionAttributes(arena.format);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    blockFree(arena.freeVertices, arena.vertexCapacity, capacity - arena.vertexCapacity);
+    arena.vertexCapacity = capacity;
+}
+
+void growIndices(MeshArena& arena, std::size_t required)
+{
+    const std::size_t capacity = alignIndexBytes(std::max(arena.indexCapacity * 2, arena.indexCapacity + required));
+
+    /* the element buffer binding is part of the VAO state */
+    glBindVertexArray(arena.vao);
+    arena.ebo = bufferGrow(GL_ELEMENT_ARRAY_BUFFER, arena.ebo, arena.indexCapacity, capacity);
+    if(arena.positionVao != 0)
+    {
+        glBindVertexArray(arena.positionVao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+    }
+    glBindVertexArray(0);
+
+    blockFree(arena.freeIndices, arena.indexCapacity, capacity - arena.indexCapacity);
+    arena.indexCapacity = capacity;
+}
+
+}
+
+MeshArena meshArenaCreate(eVertexFormat format, std::size_t vertexCapacity, std::size_t indexCapacity, bool positionStream)
+{
+    MeshArena arena;
+    arena.format = format;
+    arena.vertexSize = format == VertexPacked ? sizeof(PackedVertex) : sizeof(Vertex);
+
+    /* growing from zero creates the buffers and binds them to the VAO */
+    glGenVertexArrays(1, &arena.vao);
+    if(positionStream)
+    {
+        glGenVertexArrays(1, &arena.positionVao);
+    }
+    detail::growVertices(arena, vertexCapacity);
+    detail::growIndices(arena, indexCapacity);
+
+    return arena;
+}
+
+Mesh meshArenaAlloc(MeshArena &arena, const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices, std::size_t indexCount,
+                    const MeshBox* quantizationBox)
+{
+    Mesh mesh;
+    mesh.vao = arena.vao;
+    mesh.positionVao = arena.positionVao;
+    mesh.size_vbo = (unsigned int) vertexCount;
+    mesh.size_ibo = (unsigned int) indexCount;
+    mesh.format = arena.format;
+    mesh.arena = &arena;
+    meshComputeBounds(mesh, vertices, vertexCount);
+
+    /* converted data has to outlive the glBufferSubData calls */
+    std::vector<PackedVertex> packedVertices;
+    std::vector<std::uint16_t> shortIndices;
+
+    const void* vertexData = vertices;
+    const void* indexData = indices;
+
+    if(arena.format == VertexPacked)
+    {
+        packedVertices = meshPackVertices(vertices, vertexCount, mesh.posScale, mesh.posOffset, quantizationBox);
+        vertexData = packedVertices.data();
+    }
+
+    /* indices are relative to baseVertex, so 16 bit indices work regardless of the position in the arena */
+    if(vertexCount <= 65536)
+    {
+        shortIndices.assign(indices, indices + indexCount);
+        indexData = shortIndices.data();
+        mesh.indexType = GL_UNSIGNED_SHORT;
+    }
+
+    const std::size_t vertexBytes = vertexCount * arena.vertexSize;
+    const std::size_t indexBytes = indexCount * meshIndexSize(mesh);
+    const std::size_t indexBlock = detail::alignIndexBytes(indexBytes);
+
+    std::size_t vertexOffset = 0;
+    if(vertexCount > 0 && !detail::blockAlloc(arena.freeVertices, vertexCount, vertexOffset))
+    {
+        detail::growVertices(arena, vertexCount);
+        detail::blockAlloc(arena.freeVertices, vertexCount, vertexOffset);
+    }
+
+    std::size_t indexOffset = 0;
+    if(indexBlock > 0 && !detail::blockAlloc(arena.freeIndices, indexBlock, indexOffset))
+    {
+        detail::growIndices(arena, indexBlock);
+        detail::blockAlloc(arena.freeIndices, indexBlock, indexOffset);
+    }
+
+    if(vertexOffset > static_cast<std::size_t>(std::numeric_limits<GLint>::max()))
+    {
+        throw std::runtime_error("[MeshArena] base vertex out of range");
+    }
+    mesh.baseVertex = static_cast<GLint>(vertexOffset);
+    mesh.firstIndex = static_cast<unsigned int>(indexOffset / meshIndexSize(mesh));
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexOffset * arena.vertexSize, vertexBytes, vertexData);
+    if(arena.positionVao != 0)
+    {
+        const std::vector<unsigned char> positions = meshPositionStream(vertexData, vertexCount, arena.format);
+        glBindBuffer(GL_ARRAY_BUFFER, arena.positionVbo);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexOffset * meshPositionSize(arena.format), positions.size(), positions.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* GL_COPY_WRITE_BUFFER avoids touching the element buffer binding of the currently bound VAO */
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glCheckError();
+
+    arena.meshCount++;
+    return mesh;
+}
+
+void meshArenaFree(MeshArena &arena, const Mesh &mesh)
+{
+    detail::blockFree(arena.freeVertices, static_cast<std::size_t>(mesh.baseVertex), mesh.size_vbo);
+    detail::blockFree(arena.freeIndices, mesh.firstIndex * meshIndexSize(mesh), detail::alignIndexBytes(mesh.size_ibo * meshIndexSize(mesh)));
+    arena.meshCount--;
+}
+
+MeshArenaStats meshArenaStats(const MeshArena &arena)
+{
+    MeshArenaStats stats;
+    stats.meshCount = arena.meshCount;
+
+    std::size_t largest = 0;
+    std::size_t free = detail::blockTotal(arena.freeVertices, largest);
+    stats.vertexBytesCapacity = arena.vertexCapacity * arena.vertexSize;
+    stats.vertexBytesUsed = (arena.vertexCapacity - free) * arena.vertexSize;
+    stats.vertexFragmentation = free > 0 ? 1.0f - static_cast<float>(largest) / free : 0.0f;
+
+    free = detail::blockTotal(arena.freeIndices, largest);
+    stats.indexBytesCapacity = arena.indexCapacity;
+    stats.indexBytesUsed = arena.indexCapacity - free;
+    stats.indexFragmentation = free > 0 ? 1.0f - static_cast<float>(largest) / free : 0.0f;
+
+    return stats;
+}
+
+void meshArenaDelete(MeshArena &arena)
+{
+    glDeleteBuffers(1, &arena.vbo);
+    glDeleteBuffers(1, &arena.ebo);
+    glDeleteVertexArrays(1, &arena.vao);
+    glDeleteBuffers(1, &arena.positionVbo);
+    glDeleteVertexArrays(1, &arena.positionVao);
+    arena = MeshArena{};
+}
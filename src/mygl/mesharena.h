@@ -0,0 +1,110 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+/* free range of an arena buffer, in vertices for the vertex buffer and in bytes for the index buffer */
+struct MeshArenaBlock
+{
+    std::size_t offset = 0;
+    std::size_t size = 0;
+};
+
+/*
+ * Vertex and index buffer shared by many meshes behind a single VAO. Every mesh gets a range of vertices (drawn with
+ * its baseVertex) and a range of indices (starting at its firstIndex), so switching between meshes of an arena needs
+ * no VAO bind. All meshes of an arena share its vertex format, the index type is chosen per mesh.
+ */
+struct MeshArena
+{
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+
+    /* position stream of all meshes at the same vertex offsets, shares the index buffer (see Mesh::positionVao), 0 if
+     * the arena was created without it */
+    GLuint positionVao = 0;
+    GLuint positionVbo = 0;
+
+    eVertexFormat format = VertexFloat;
+    std::size_t vertexSize = 0;      // bytes per vertex
+
+    std::size_t vertexCapacity = 0;  // in vertices
+    std::size_t indexCapacity = 0;   // in bytes
+
+    /* sorted by offset, adjacent blocks are merged */
+    std::vector<MeshArenaBlock> freeVertices;
+    std::vector<MeshArenaBlock> freeIndices;
+
+    std::size_t meshCount = 0;
+};
+
+struct MeshArenaStats
+{
+    std::size_t meshCount = 0;
+    std::size_t vertexBytesUsed = 0;
+    std::size_t vertexBytesCapacity = 0;
+    std::size_t indexBytesUsed = 0;
+    std::size_t indexBytesCapacity = 0;
+
+    /* 1 - largest free block / total free space, 0 if all free space is in one block */
+    float vertexFragmentation = 0.0f;
+    float indexFragmentation = 0.0f;
+};
+
+/**
+ * @brief Creates the buffers and the VAO of an arena.
+ *
+ * @param format Vertex format of all meshes in the arena.
+ * @param vertexCapacity Initial size of the vertex buffer in vertices.
+ * @param indexCapacity Initial size of the index buffer in bytes.
+ * @param positionStream Also keep a position stream of all meshes for depth only passes, it adds
+ * meshPositionSize(format) bytes per vertex.
+ *
+ * @return Empty arena, grows on demand.
+ */
+MeshArena meshArenaCreate(eVertexFormat format, std::size_t vertexCapacity = 1 << 16, std::size_t indexCapacity = 1 << 20,
+                          bool positionStream = false);
+
+/**
+ * @brief Same as meshCreate(...), but uploads the mesh into ranges of the arena. If no free range is large enough the
+ * arena buffers grow (the content is copied on the GPU, existing meshes stay valid).
+ *
+ * @param arena Arena to allocate from.
+ * @param vertices Pointer to the first vertex of the mesh.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to the first index of the mesh.
+ * @param indexCount Number of indices.
+ * @param quantizationBox Box the positions are quantized in if the arena is packed, nullptr for the bounding box of the
+ * vertices.
+ *
+ * @return Mesh referencing the arena, delete it with meshDelete(...) to release its ranges.
+ */
+Mesh meshArenaAlloc(MeshArena& arena, const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount,
+                    const MeshBox* quantizationBox = nullptr);
+
+/**
+ * @brief Releases the ranges of a mesh, the space is reused by later allocations.
+ *
+ * @param arena Arena the mesh was allocated from.
+ * @param mesh Mesh to release.
+ */
+void meshArenaFree(MeshArena& arena, const Mesh& mesh);
+
+/**
+ * @brief Memory usage and fragmentation of an arena.
+ *
+ * @param arena Arena to inspect.
+ *
+ * @return Current statistics.
+ */
+MeshArenaStats meshArenaStats(const MeshArena& arena);
+
+/**
+ * @brief Deletes the buffers and the VAO of an arena. All meshes of the arena become invalid.
+ *
+ * @param arena Arena to delete.
+ */
+void meshArenaDelete(MeshArena& arena);
@@ -0,0 +1,582 @@
+#include "meshcache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+namespace detail
+{
+
+/* 64 bit FNV-1a */
+std::uint64_t hashBytes(const char* data, std::size_t size)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for(std::size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint64_t hashFile(const std::string& filepath)
+{
+    FileMap file = fileMapOpen(filepath);
+    std::uint64_t hash = hashBytes(file.data, file.size);
+    fileMapClose(file);
+    return hash;
+}
+
+bool fileStat(const std::string& filepath, std::uint64_t& size, std::int64_t& mtime)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(filepath, error);
+    if(error)
+    {
+        return false;
+    }
+
+    auto time = std::filesystem::last_write_time(filepath, error);
+    if(error)
+    {
+        return false;
+    }
+
+    mtime = static_cast<std::int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/* checks that the array [offset, offset + count * stride) lies within the file */
+bool inFile(const FileMap& file, std::uint64_t offset, std::uint64_t count, std::uint64_t stride)
+{
+    return offset <= file.size && count <= (file.size - offset) / stride;
+}
+
+std::string cacheString(const MeshCache& cache, const meshcache::String& string)
+{
+    if(string.offset > cache.header->stringSize || string.length > cache.header->stringSize - string.offset)
+    {
+        throw std::runtime_error("[MeshCache] Corrupt string table");
+    }
+    return std::string(cache.strings + string.offset, string.length);
+}
+
+std::vector<Material> cacheMaterials(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<Material> materials;
+    materials.reserve(object.materialCount);
+
+    for(std::uint32_t m = 0; m < object.materialCount; m++)
+    {
+        const meshcache::Material& record = cache.materials[object.firstMaterial + m];
+
+        Material& material = materials.emplace_back();
+        material.name = cacheString(cache, record.name);
+        material.emission = Vector3D(record.emission[0], record.emission[1], record.emission[2]);
+        material.ambient = Vector3D(record.ambient[0], record.ambient[1], record.ambient[2]);
+        material.diffuse = Vector3D(record.diffuse[0], record.diffuse[1], record.diffuse[2]);
+        material.specular = Vector3D(record.specular[0], record.specular[1], record.specular[2]);
+        material.shininess = record.shininess;
+    }
+
+    return materials;
+}
+
+std::vector<MaterialRange> cacheRanges(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<MaterialRange> ranges;
+    ranges.reserve(object.rangeCount);
+
+    for(std::uint32_t r = 0; r < object.rangeCount; r++)
+    {
+        const meshcache::Range& record = cache.ranges[object.firstRange + r];
+        if(record.materialId >= object.materialCount)
+        {
+            throw std::runtime_error("[MeshCache] Corrupt material range");
+        }
+        ranges.push_back({record.indexOffset, record.indexCount, record.materialId});
+    }
+
+    return ranges;
+}
+
+std::vector<ModelLod> cacheLods(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<ModelLod> lods;
+    lods.reserve(object.lodCount);
+
+    for(std::uint32_t l = 0; l < object.lodCount; l++)
+    {
+        const meshcache::Lod& record = cache.lods[object.firstLod + l];
+
+        ModelLod& lod = lods.emplace_back();
+        lod.error = record.error;
+        for(std::uint32_t r = 0; r < record.rangeCount; r++)
+        {
+            const meshcache::LodRange& range = cache.lodRanges[record.firstRange + r];
+            lod.material.push_back({range.indexOffset, range.indexCount});
+            if(object.meshletCount > 0)
+            {
+                if(range.firstMeshlet > object.meshletCount || range.meshletCount > object.meshletCount - range.firstMeshlet)
+                {
+                    throw std::runtime_error("[MeshCache] Corrupt meshlet range");
+                }
+                lod.meshlets.push_back({range.firstMeshlet, range.meshletCount});
+            }
+        }
+    }
+
+    return lods;
+}
+
+std::vector<Meshlet> cacheMeshlets(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<Meshlet> meshlets(object.meshletCount);
+    for(std::uint32_t i = 0; i < object.meshletCount; i++)
+    {
+        const meshcache::Meshlet& record = cache.meshlets[object.firstMeshlet + i];
+        Meshlet& meshlet = meshlets[i];
+        meshlet.range = {record.indexOffset, record.indexCount};
+        meshlet.center = Vector3D(record.center[0], record.center[1], record.center[2]);
+        meshlet.radius = record.radius;
+        meshlet.coneAxis = Vector3D(record.coneAxis[0], record.coneAxis[1], record.coneAxis[2]);
+        meshlet.coneCutoff = record.coneCutoff;
+    }
+    return meshlets;
+}
+
+std::vector<Matrix4D> cacheInstances(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<Matrix4D> instances(object.instanceCount);
+    for(std::uint32_t i = 0; i < object.instanceCount; i++)
+    {
+        std::memcpy(instances[i].n, cache.instances[object.firstInstance + i].matrix, sizeof(meshcache::Instance::matrix));
+    }
+    return instances;
+}
+
+std::vector<std::string> cacheParts(const MeshCache& cache, const meshcache::Object& object)
+{
+    std::vector<std::string> parts;
+    parts.reserve(object.partCount);
+    for(std::uint32_t i = 0; i < object.partCount; i++)
+    {
+        parts.push_back(cacheString(cache, cache.parts[object.firstPart + i].name));
+    }
+    return parts;
+}
+
+bool sourceValid(const MeshCache& cache, const meshcache::Source& source)
+{
+    std::string path = cacheString(cache, source.path);
+
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    if(!fileStat(path, size, mtime) || size != source.size)
+    {
+        return false;
+    }
+
+    /* mtime changes on copies (e.g. assets copied into the build folder), so fall back to the content hash */
+    return mtime == source.mtime || hashFile(path) == source.hash;
+}
+
+bool cacheValid(MeshCache& cache, std::uint32_t options)
+{
+    const FileMap& file = cache.file;
+    if(file.size < sizeof(meshcache::Header))
+    {
+        return false;
+    }
+
+    const meshcache::Header* header = reinterpret_cast<const meshcache::Header*>(file.data);
+    if(std::memcmp(header->magic, meshcache::MAGIC, sizeof(meshcache::MAGIC)) != 0 ||
+       header->version != meshcache::VERSION || header->vertexStride != sizeof(Vertex) || header->options != options)
+    {
+        return false;
+    }
+
+    if(!inFile(file, header->sourceOffset, header->sourceCount, sizeof(meshcache::Source)) ||
+       !inFile(file, header->objectOffset, header->objectCount, sizeof(meshcache::Object)) ||
+       !inFile(file, header->materialOffset, header->materialCount, sizeof(meshcache::Material)) ||
+       !inFile(file, header->rangeOffset, header->rangeCount, sizeof(meshcache::Range)) ||
+       !inFile(file, header->lodOffset, header->lodCount, sizeof(meshcache::Lod)) ||
+       !inFile(file, header->lodRangeOffset, header->lodRangeCount, sizeof(meshcache::LodRange)) ||
+       !inFile(file, header->meshletOffset, header->meshletCount, sizeof(meshcache::Meshlet)) ||
+       !inFile(file, header->instanceOffset, header->instanceCount, sizeof(meshcache::Instance)) ||
+       !inFile(file, header->partOffset, header->partCount, sizeof(meshcache::Part)) ||
+       !inFile(file, header->stringOffset, header->stringSize, 1) ||
+       !inFile(file, header->vertexOffset, header->vertexCount, sizeof(Vertex)) ||
+       !inFile(file, header->indexOffset, header->indexCount, sizeof(unsigned int)))
+    {
+        return false;
+    }
+
+    cache.header = header;
+    cache.objects = reinterpret_cast<const meshcache::Object*>(file.data + header->objectOffset);
+    cache.materials = reinterpret_cast<const meshcache::Material*>(file.data + header->materialOffset);
+    cache.ranges = reinterpret_cast<const meshcache::Range*>(file.data + header->rangeOffset);
+    cache.lods = reinterpret_cast<const meshcache::Lod*>(file.data + header->lodOffset);
+    cache.lodRanges = reinterpret_cast<const meshcache::LodRange*>(file.data + header->lodRangeOffset);
+    cache.meshlets = reinterpret_cast<const meshcache::Meshlet*>(file.data + header->meshletOffset);
+    cache.instances = reinterpret_cast<const meshcache::Instance*>(file.data + header->instanceOffset);
+    cache.parts = reinterpret_cast<const meshcache::Part*>(file.data + header->partOffset);
+    cache.strings = file.data + header->stringOffset;
+    cache.vertices = reinterpret_cast<const Vertex*>(file.data + header->vertexOffset);
+    cache.indices = reinterpret_cast<const unsigned int*>(file.data + header->indexOffset);
+
+    for(std::uint32_t i = 0; i < header->objectCount; i++)
+    {
+        const meshcache::Object& object = cache.objects[i];
+        if(object.firstVertex > header->vertexCount || object.vertexCount > header->vertexCount - object.firstVertex ||
+           object.firstIndex > header->indexCount || object.indexCount > header->indexCount - object.firstIndex ||
+           object.firstMaterial > header->materialCount || object.materialCount > header->materialCount - object.firstMaterial ||
+           object.firstRange > header->rangeCount || object.rangeCount > header->rangeCount - object.firstRange ||
+           object.firstLod > header->lodCount || object.lodCount > header->lodCount - object.firstLod ||
+           object.firstInstance > header->instanceCount || object.instanceCount > header->instanceCount - object.firstInstance ||
+           object.firstPart > header->partCount || object.partCount > header->partCount - object.firstPart ||
+           object.firstMeshlet > header->meshletCount || object.meshletCount > header->meshletCount - object.firstMeshlet)
+        {
+            return false;
+        }
+    }
+
+    for(std::uint32_t i = 0; i < header->lodCount; i++)
+    {
+        const meshcache::Lod& lod = cache.lods[i];
+        if(lod.firstRange > header->lodRangeCount || lod.rangeCount > header->lodRangeCount - lod.firstRange)
+        {
+            return false;
+        }
+    }
+
+    const meshcache::Source* sources = reinterpret_cast<const meshcache::Source*>(file.data + header->sourceOffset);
+    for(std::uint32_t i = 0; i < header->sourceCount; i++)
+    {
+        if(!sourceValid(cache, sources[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+std::string meshCachePath(const std::string &objFilepath)
+{
+    return std::filesystem::path(objFilepath).replace_extension(".vcmesh").string();
+}
+
+std::uint32_t meshCacheOptions(const ModelLoadOptions &options)
+{
+    return (options.weldVertices ? 1u : 0u) | (options.optimizeIndices ? 2u : 0u) | (options.buildLods ? 4u : 0u) |
+           (options.instanceObjects ? 8u : 0u) | (options.mergeObjects ? 16u : 0u) |
+           (options.buildMeshlets ? 32u : 0u);
+}
+
+bool meshCacheOpen(const std::string &cachePath, std::uint32_t options, MeshCache &cache)
+{
+    std::error_code error;
+    if(!std::filesystem::exists(cachePath, error))
+    {
+        return false;
+    }
+
+    MeshCache result;
+    try
+    {
+        result.file = fileMapOpen(cachePath);
+        if(!detail::cacheValid(result, options))
+        {
+            fileMapClose(result.file);
+            return false;
+        }
+    }
+    catch(const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        fileMapClose(result.file);
+        return false;
+    }
+
+    cache = result;
+    return true;
+}
+
+std::vector<Model> meshCacheCreate(const MeshCache &cache, const ModelLoadOptions &options)
+{
+    std::vector<Model> models;
+    models.reserve(cache.header->objectCount);
+
+    MeshBox box;
+    if(options.sharedQuantization)
+    {
+        for(std::uint32_t i = 0; i < cache.header->objectCount; i++)
+        {
+            const meshcache::Object& object = cache.objects[i];
+            meshBoxExtend(box, meshBox(cache.vertices + object.firstVertex, object.vertexCount));
+        }
+    }
+
+    for(std::uint32_t i = 0; i < cache.header->objectCount; i++)
+    {
+        const meshcache::Object& object = cache.objects[i];
+
+        Model& model = models.emplace_back();
+        model.name = detail::cacheString(cache, object.name);
+        model.mesh = modelMeshCreate(cache.vertices + object.firstVertex, object.vertexCount,
+                                     cache.indices + object.firstIndex, object.indexCount, options,
+                                     options.sharedQuantization ? &box : nullptr);
+
+        const std::vector<Material> materials = detail::cacheMaterials(cache, object);
+        model.parts = detail::cacheParts(cache, object);
+        model.material = modelInternMaterials(materials, detail::cacheRanges(cache, object), !model.parts.empty());
+        model.vertexMaterialCount = model.parts.empty() ? 0 : static_cast<unsigned int>(materials.size());
+        model.lods = detail::cacheLods(cache, object);
+        model.meshlets = detail::cacheMeshlets(cache, object);
+        model.instances = detail::cacheInstances(cache, object);
+        modelComputeBounds(model, cache.vertices + object.firstVertex, cache.indices + object.firstIndex);
+        modelKeepOccluder(model, cache.vertices + object.firstVertex, object.vertexCount, cache.indices + object.firstIndex,
+                          options);
+    }
+
+    return models;
+}
+
+std::vector<ModelData> meshCacheData(const MeshCache &cache)
+{
+    std::vector<ModelData> data;
+    data.reserve(cache.header->objectCount);
+
+    for(std::uint32_t i = 0; i < cache.header->objectCount; i++)
+    {
+        const meshcache::Object& object = cache.objects[i];
+
+        ModelData& model = data.emplace_back();
+        model.name = detail::cacheString(cache, object.name);
+        model.vertices.assign(cache.vertices + object.firstVertex, cache.vertices + object.firstVertex + object.vertexCount);
+        model.indices.assign(cache.indices + object.firstIndex, cache.indices + object.firstIndex + object.indexCount);
+        model.materials = detail::cacheMaterials(cache, object);
+        model.material = detail::cacheRanges(cache, object);
+        model.lods = detail::cacheLods(cache, object);
+        model.meshlets = detail::cacheMeshlets(cache, object);
+        model.instances = detail::cacheInstances(cache, object);
+        model.parts = detail::cacheParts(cache, object);
+    }
+
+    return data;
+}
+
+void meshCacheClose(MeshCache &cache)
+{
+    fileMapClose(cache.file);
+    cache = MeshCache{};
+}
+
+void meshCacheWrite(const std::string &cachePath, std::uint32_t options, const std::vector<ModelData> &data, const std::vector<std::string> &sources)
+{
+    using namespace meshcache;
+
+    std::string strings;
+    auto addString = [&strings](const std::string& s)
+    {
+        String string{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(s.size())};
+        strings += s;
+        return string;
+    };
+
+    /* collect records */
+    std::vector<Source> sourceRecords;
+    for(const auto& path : sources)
+    {
+        Source& source = sourceRecords.emplace_back();
+        source.path = addString(path);
+        source.hash = detail::hashFile(path);
+        if(!detail::fileStat(path, source.size, source.mtime))
+        {
+            return;
+        }
+    }
+
+    std::vector<Object> objectRecords;
+    std::vector<meshcache::Material> materialRecords;
+    std::vector<Range> rangeRecords;
+    std::vector<Lod> lodRecords;
+    std::vector<LodRange> lodRangeRecords;
+    std::vector<meshcache::Meshlet> meshletRecords;
+    std::vector<Instance> instanceRecords;
+    std::vector<meshcache::Part> partRecords;
+    std::uint64_t vertexCount = 0;
+    std::uint64_t indexCount = 0;
+
+    for(const auto& model : data)
+    {
+        Object& object = objectRecords.emplace_back();
+        object.name = addString(model.name);
+        object.firstVertex = static_cast<std::uint32_t>(vertexCount);
+        object.vertexCount = static_cast<std::uint32_t>(model.vertices.size());
+        object.firstIndex = static_cast<std::uint32_t>(indexCount);
+        object.indexCount = static_cast<std::uint32_t>(model.indices.size());
+        object.firstMaterial = static_cast<std::uint32_t>(materialRecords.size());
+        object.materialCount = static_cast<std::uint32_t>(model.materials.size());
+        object.firstRange = static_cast<std::uint32_t>(rangeRecords.size());
+        object.rangeCount = static_cast<std::uint32_t>(model.material.size());
+        object.firstLod = static_cast<std::uint32_t>(lodRecords.size());
+        object.lodCount = static_cast<std::uint32_t>(model.lods.size());
+        object.firstInstance = static_cast<std::uint32_t>(instanceRecords.size());
+        object.instanceCount = static_cast<std::uint32_t>(model.instances.size());
+        object.firstPart = static_cast<std::uint32_t>(partRecords.size());
+        object.partCount = static_cast<std::uint32_t>(model.parts.size());
+        object.firstMeshlet = static_cast<std::uint32_t>(meshletRecords.size());
+        object.meshletCount = static_cast<std::uint32_t>(model.meshlets.size());
+
+        for(const auto& material : model.materials)
+        {
+            meshcache::Material& record = materialRecords.emplace_back();
+            record.name = addString(material.name);
+            std::memcpy(record.emission, &material.emission, sizeof(record.emission));
+            std::memcpy(record.ambient, &material.ambient, sizeof(record.ambient));
+            std::memcpy(record.diffuse, &material.diffuse, sizeof(record.diffuse));
+            std::memcpy(record.specular, &material.specular, sizeof(record.specular));
+            record.shininess = material.shininess;
+        }
+
+        for(const auto& range : model.material)
+        {
+            rangeRecords.push_back({range.indexOffset, range.indexCount, range.materialId});
+        }
+
+        for(const auto& lod : model.lods)
+        {
+            Lod& record = lodRecords.emplace_back();
+            record.error = lod.error;
+            record.firstRange = static_cast<std::uint32_t>(lodRangeRecords.size());
+            record.rangeCount = static_cast<std::uint32_t>(lod.material.size());
+            for(std::size_t r = 0; r < lod.material.size(); r++)
+            {
+                const IndexRange meshlets = r < lod.meshlets.size() ? lod.meshlets[r] : IndexRange{};
+                lodRangeRecords.push_back({lod.material[r].offset, lod.material[r].count, meshlets.offset, meshlets.count});
+            }
+        }
+
+        for(const auto& meshlet : model.meshlets)
+        {
+            meshletRecords.push_back({meshlet.range.offset, meshlet.range.count,
+                                      {meshlet.center.x, meshlet.center.y, meshlet.center.z}, meshlet.radius,
+                                      {meshlet.coneAxis.x, meshlet.coneAxis.y, meshlet.coneAxis.z}, meshlet.coneCutoff});
+        }
+
+        for(const auto& instance : model.instances)
+        {
+            std::memcpy(instanceRecords.emplace_back().matrix, instance.n, sizeof(Instance::matrix));
+        }
+
+        for(const auto& part : model.parts)
+        {
+            partRecords.push_back({addString(part)});
+        }
+
+        vertexCount += model.vertices.size();
+        indexCount += model.indices.size();
+    }
+
+    /* layout */
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.sourceCount = static_cast<std::uint32_t>(sourceRecords.size());
+    header.objectCount = static_cast<std::uint32_t>(objectRecords.size());
+    header.materialCount = static_cast<std::uint32_t>(materialRecords.size());
+    header.options = options;
+    header.rangeCount = static_cast<std::uint32_t>(rangeRecords.size());
+    header.lodCount = static_cast<std::uint32_t>(lodRecords.size());
+    header.lodRangeCount = static_cast<std::uint32_t>(lodRangeRecords.size());
+    header.instanceCount = static_cast<std::uint32_t>(instanceRecords.size());
+    header.partCount = static_cast<std::uint32_t>(partRecords.size());
+    header.meshletCount = static_cast<std::uint32_t>(meshletRecords.size());
+
+    header.sourceOffset = sizeof(Header);
+    header.objectOffset = header.sourceOffset + sourceRecords.size() * sizeof(Source);
+    header.materialOffset = header.objectOffset + objectRecords.size() * sizeof(Object);
+    header.rangeOffset = header.materialOffset + materialRecords.size() * sizeof(meshcache::Material);
+    header.lodOffset = header.rangeOffset + rangeRecords.size() * sizeof(Range);
+    header.lodRangeOffset = header.lodOffset + lodRecords.size() * sizeof(Lod);
+    header.meshletOffset = header.lodRangeOffset + lodRangeRecords.size() * sizeof(LodRange);
+    header.instanceOffset = header.meshletOffset + meshletRecords.size() * sizeof(meshcache::Meshlet);
+    header.partOffset = header.instanceOffset + instanceRecords.size() * sizeof(Instance);
+    header.stringOffset = header.partOffset + partRecords.size() * sizeof(meshcache::Part);
+    header.stringSize = strings.size();
+    header.vertexOffset = detail::alignUp(header.stringOffset + header.stringSize, PAGE_SIZE);
+    header.vertexCount = vertexCount;
+    header.indexOffset = detail::alignUp(header.vertexOffset + vertexCount * sizeof(Vertex), PAGE_SIZE);
+    header.indexCount = indexCount;
+
+    /* write to a temporary file of this writer first, a cache is either complete or not there at all */
+    const std::string tmpPath = fileTempPath(cachePath);
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!out.is_open())
+        {
+            std::cerr << "[MeshCache] Couldn't write cache file at " << cachePath << std::endl;
+            return;
+        }
+
+        auto pad = [&out](std::uint64_t offset)
+        {
+            static const char zeros[PAGE_SIZE] = {};
+            out.write(zeros, static_cast<std::streamsize>(offset - static_cast<std::uint64_t>(out.tellp())));
+        };
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(sourceRecords.data()), sourceRecords.size() * sizeof(Source));
+        out.write(reinterpret_cast<const char*>(objectRecords.data()), objectRecords.size() * sizeof(Object));
+        out.write(reinterpret_cast<const char*>(materialRecords.data()), materialRecords.size() * sizeof(meshcache::Material));
+        out.write(reinterpret_cast<const char*>(rangeRecords.data()), rangeRecords.size() * sizeof(Range));
+        out.write(reinterpret_cast<const char*>(lodRecords.data()), lodRecords.size() * sizeof(Lod));
+        out.write(reinterpret_cast<const char*>(lodRangeRecords.data()), lodRangeRecords.size() * sizeof(LodRange));
+        out.write(reinterpret_cast<const char*>(meshletRecords.data()), meshletRecords.size() * sizeof(meshcache::Meshlet));
+        out.write(reinterpret_cast<const char*>(instanceRecords.data()), instanceRecords.size() * sizeof(Instance));
+        out.write(reinterpret_cast<const char*>(partRecords.data()), partRecords.size() * sizeof(meshcache::Part));
+        out.write(strings.data(), strings.size());
+
+        pad(header.vertexOffset);
+        for(const auto& model : data)
+        {
+            out.write(reinterpret_cast<const char*>(model.vertices.data()), model.vertices.size() * sizeof(Vertex));
+        }
+
+        pad(header.indexOffset);
+        for(const auto& model : data)
+        {
+            out.write(reinterpret_cast<const char*>(model.indices.data()), model.indices.size() * sizeof(unsigned int));
+        }
+
+        if(!out.good())
+        {
+            std::cerr << "[MeshCache] Couldn't write cache file at " << cachePath << std::endl;
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(tmpPath, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, cachePath, error);
+    if(error)
+    {
+        std::cerr << "[MeshCache] Couldn't write cache file at " << cachePath << ": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+    }
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "filemap.h"
+#include "model.h"
+
+#include <cstdint>
+
+/**
+ * Binary mesh cache (.vcmesh)
+ *
+ * The cache holds the final vertex/index arrays of all objects of an OBJ file together with their names and material
+ * ranges. Vertex and index data start at page boundaries so meshes can be uploaded straight from the mapped file.
+ *
+ *   Header
+ *   Source[sourceCount]      files the cache was built from (size, mtime and hash of the OBJ and its MTL files)
+ *   Object[objectCount]      name, vertex/index range, material, draw range, LOD and meshlet range per object
+ *   Material[materialCount]  distinct materials of each object
+ *   Range[rangeCount]        draw ranges (indexOffset/indexCount and material of the object)
+ *   Lod[lodCount]            error and material range list per level of detail of an object
+ *   LodRange[lodRangeCount]  index and meshlet ranges of the levels of detail, one per material
+ *   Meshlet[meshletCount]    index range, bounding sphere and normal cone of the meshlets of an object
+ *   Instance[instanceCount]  transformations of the copies of instanced objects
+ *   Part[partCount]          names of the objects merged into an object
+ *   char[stringSize]         names and paths referenced by the records above
+ *   Vertex[vertexCount]      page aligned
+ *   uint32[indexCount]       page aligned
+ *
+ * A cache is valid if version, vertex layout and load options match and every source file still has the recorded
+ * size and either the recorded mtime or the recorded content hash.
+ */
+namespace meshcache
+{
+    constexpr char MAGIC[8] = {'V', 'C', 'M', 'E', 'S', 'H', '\0', '\0'};
+    constexpr std::uint32_t VERSION = 7;
+    constexpr std::uint64_t PAGE_SIZE = 4096;
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t vertexStride;
+
+        std::uint32_t sourceCount;
+        std::uint32_t objectCount;
+        std::uint32_t materialCount;
+        std::uint32_t options;
+        std::uint32_t rangeCount;
+        std::uint32_t lodCount;
+        std::uint32_t lodRangeCount;
+        std::uint32_t instanceCount;
+        std::uint32_t partCount;
+        std::uint32_t meshletCount;
+
+        std::uint64_t sourceOffset;
+        std::uint64_t objectOffset;
+        std::uint64_t materialOffset;
+        std::uint64_t rangeOffset;
+        std::uint64_t lodOffset;
+        std::uint64_t lodRangeOffset;
+        std::uint64_t meshletOffset;
+        std::uint64_t instanceOffset;
+        std::uint64_t partOffset;
+        std::uint64_t stringOffset;
+        std::uint64_t stringSize;
+        std::uint64_t vertexOffset;
+        std::uint64_t vertexCount;
+        std::uint64_t indexOffset;
+        std::uint64_t indexCount;
+    };
+
+    struct String
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    struct Source
+    {
+        String path;
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::uint64_t hash;
+    };
+
+    struct Object
+    {
+        String name;
+        std::uint32_t firstVertex;
+        std::uint32_t vertexCount;
+        std::uint32_t firstIndex;
+        std::uint32_t indexCount;
+        std::uint32_t firstMaterial;
+        std::uint32_t materialCount;
+        std::uint32_t firstRange;
+        std::uint32_t rangeCount;
+        std::uint32_t firstLod;
+        std::uint32_t lodCount;
+        std::uint32_t firstInstance;
+        std::uint32_t instanceCount;
+        std::uint32_t firstPart;
+        std::uint32_t partCount;
+        std::uint32_t firstMeshlet;
+        std::uint32_t meshletCount;
+    };
+
+    struct Material
+    {
+        String name;
+        float emission[3];
+        float ambient[3];
+        float diffuse[3];
+        float specular[3];
+        float shininess;
+    };
+
+    struct Range
+    {
+        std::uint32_t indexOffset;
+        std::uint32_t indexCount;
+        std::uint32_t materialId;   // index into the materials of the object
+    };
+
+    struct Lod
+    {
+        float error;
+        std::uint32_t firstRange;
+        std::uint32_t rangeCount;
+    };
+
+    struct LodRange
+    {
+        std::uint32_t indexOffset;
+        std::uint32_t indexCount;
+        std::uint32_t firstMeshlet; // relative to the meshlets of the object
+        std::uint32_t meshletCount;
+    };
+
+    struct Meshlet
+    {
+        std::uint32_t indexOffset;
+        std::uint32_t indexCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    struct Instance
+    {
+        float matrix[16];   // column major
+    };
+
+    struct Part
+    {
+        String name;
+    };
+}
+
+struct MeshCache
+{
+    FileMap file;
+
+    const meshcache::Header* header = nullptr;
+    const meshcache::Object* objects = nullptr;
+    const meshcache::Material* materials = nullptr;
+    const meshcache::Range* ranges = nullptr;
+    const meshcache::Lod* lods = nullptr;
+    const meshcache::LodRange* lodRanges = nullptr;
+    const meshcache::Meshlet* meshlets = nullptr;
+    const meshcache::Instance* instances = nullptr;
+    const meshcache::Part* parts = nullptr;
+    const char* strings = nullptr;
+    const Vertex* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+};
+
+/**
+ * @brief Path of the cache file that belongs to an OBJ file (same directory and name with extension .vcmesh).
+ *
+ * @param objFilepath Path to the OBJ file.
+ *
+ * @return Path to the cache file.
+ */
+std::string meshCachePath(const std::string& objFilepath);
+
+/**
+ * @brief Encodes the load options that change the cached data into the bits stored in the cache header.
+ *
+ * @param options Load options.
+ *
+ * @return Option bits.
+ */
+std::uint32_t meshCacheOptions(const ModelLoadOptions& options);
+
+/**
+ * @brief Maps a cache file and checks that it is valid and up to date with its source files.
+ *
+ * @param cachePath Path to the cache file.
+ * @param options Load options the cached data has to be processed with (see meshCacheOptions(...)).
+ * @param cache Receives the mapped cache (only if true is returned).
+ *
+ * @return True if the cache can be used, false if it is missing, corrupt or outdated.
+ */
+bool meshCacheOpen(const std::string& cachePath, std::uint32_t options, MeshCache& cache);
+
+/**
+ * @brief Creates one model per cached object, the meshes are uploaded directly from the mapped pages.
+ *
+ * @param cache Opened cache (see meshCacheOpen(...)).
+ * @param options Load options, selects the vertex format of the meshes.
+ *
+ * @return Models with initialized meshes.
+ */
+std::vector<Model> meshCacheCreate(const MeshCache& cache, const ModelLoadOptions& options = ModelLoadOptions());
+
+/**
+ * @brief Copies the cached objects into CPU side model data without touching OpenGL, e.g. to load on a worker thread.
+ *
+ * @param cache Opened cache (see meshCacheOpen(...)).
+ *
+ * @return One entry per cached object.
+ */
+std::vector<ModelData> meshCacheData(const MeshCache& cache);
+
+/**
+ * @brief Unmaps a cache. Has to be called for each opened cache after its content is not used anymore.
+ *
+ * @param cache Cache to close.
+ */
+void meshCacheClose(MeshCache& cache);
+
+/**
+ * @brief Writes parsed model data into a cache file. The file is written to a temporary file first and then renamed,
+ * so concurrently starting processes never see a partially written cache. Failing to write is not an error, the
+ * cache is then just rebuilt on the next start.
+ *
+ * @param cachePath Path to the cache file.
+ * @param options Load options the data was processed with (see meshCacheOptions(...)).
+ * @param data Parsed model data (see modelParse(...)).
+ * @param sources Paths of all files the data was parsed from.
+ */
+void meshCacheWrite(const std::string& cachePath, std::uint32_t options, const std::vector<ModelData>& data, const std::vector<std::string>& sources);
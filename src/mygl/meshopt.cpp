@@ -0,0 +1,1195 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace detail
+{
+
+std::uint32_t hashVertex(const Vertex& vertex)
+{
+    std::uint32_t words[sizeof(Vertex) / sizeof(std::uint32_t)];
+    std::memcpy(words, &vertex, sizeof(Vertex));
+
+    /* murmur2 style mixing of the raw float bits */
+    std::uint32_t hash = 0;
+    for(std::uint32_t word : words)
+    {
+        word *= 0x5bd1e995u;
+        word ^= word >> 24;
+        word *= 0x5bd1e995u;
+        hash = (hash * 0x5bd1e995u) ^ word;
+    }
+    return hash ^ (hash >> 15);
+}
+
+bool vertexEqual(const Vertex& a, const Vertex& b)
+{
+    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+/* LRU cache size and score function from Forsyth's paper */
+constexpr int FORSYTH_CACHE_SIZE = 32;
+
+float forsythScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if(remainingTriangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if(cachePosition >= 0)
+    {
+        /* the last triangle's vertices get a fixed score so its neighbours are not favoured over each other */
+        score = cachePosition < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+
+    /* prefer vertices with few remaining triangles to get rid of them */
+    return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+/* FIFO cache simulation, a vertex is in the cache if it was inserted less than 'size' misses ago */
+struct FifoCache
+{
+    std::vector<std::size_t> insertedAt;
+    std::size_t misses = 0;
+    std::size_t size;
+
+    FifoCache(std::size_t vertexCount, std::size_t size) : insertedAt(vertexCount, 0), size(size) {}
+
+    unsigned int triangle(const unsigned int* tri)
+    {
+        unsigned int triangleMisses = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            if(insertedAt[tri[i]] == 0 || misses - insertedAt[tri[i]] >= size)
+            {
+                insertedAt[tri[i]] = ++misses;
+                triangleMisses++;
+            }
+        }
+        return triangleMisses;
+    }
+
+    void reset()
+    {
+        std::fill(insertedAt.begin(), insertedAt.end(), 0);
+        misses = 0;
+    }
+};
+
+/* quadric error of a set of planes, error(p) is the weighted mean of the squared distances of p to the planes */
+struct Quadric
+{
+    double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void addPlane(const Vector3D& normal, const Vector3D& point, double w)
+    {
+        const double nx = normal.x, ny = normal.y, nz = normal.z;
+        const double d = -(nx * point.x + ny * point.y + nz * point.z);
+
+        a00 += w * nx * nx; a11 += w * ny * ny; a22 += w * nz * nz;
+        a01 += w * nx * ny; a02 += w * nx * nz; a12 += w * ny * nz;
+        b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a11 += q.a11; a22 += q.a22;
+        a01 += q.a01; a02 += q.a02; a12 += q.a12;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+    }
+
+    double error(const Vector3D& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                       + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+/* border edges are kept in place by planes through the edge, perpendicular to its triangle */
+constexpr double BORDER_WEIGHT = 10.0;
+
+/* collapses that turn a triangle normal by more than ~75 degrees are rejected */
+constexpr float FLIP_THRESHOLD = 0.25f;
+
+constexpr int SIMPLIFY_MAX_PASSES = 100;
+
+/* index of the first vertex with the same position for every vertex */
+std::vector<unsigned int> positionIds(const std::vector<Vertex>& vertices)
+{
+    constexpr unsigned int EMPTY = ~0u;
+
+    std::size_t tableSize = 1;
+    while(tableSize < vertices.size() * 2)
+    {
+        tableSize *= 2;
+    }
+    const std::size_t mask = tableSize - 1;
+
+    std::vector<unsigned int> table(tableSize, EMPTY);
+    std::vector<unsigned int> ids(vertices.size());
+
+    for(std::size_t i = 0; i < vertices.size(); i++)
+    {
+        std::uint32_t words[3];
+        std::memcpy(words, &vertices[i].pos, sizeof(words));
+
+        std::uint32_t hash = 0;
+        for(std::uint32_t word : words)
+        {
+            word *= 0x5bd1e995u;
+            word ^= word >> 24;
+            word *= 0x5bd1e995u;
+            hash = (hash * 0x5bd1e995u) ^ word;
+        }
+
+        std::size_t slot = (hash ^ (hash >> 15)) & mask;
+        while(table[slot] != EMPTY && std::memcmp(&vertices[table[slot]].pos, &vertices[i].pos, sizeof(words)) != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        if(table[slot] == EMPTY)
+        {
+            table[slot] = static_cast<unsigned int>(i);
+        }
+        ids[i] = table[slot];
+    }
+
+    return ids;
+}
+
+std::uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+    return (static_cast<std::uint64_t>(a) << 32) | b;
+}
+
+/* state of the simplification of one index range */
+struct Simplifier
+{
+    const std::vector<Vertex>& vertices;
+    const std::vector<unsigned int>& position;   // position id per vertex
+    const std::vector<unsigned int>& wedge;      // next vertex with the same position (circular)
+    const std::vector<unsigned char>& locked;    // per position
+
+    std::vector<Quadric> quadrics;               // per position
+    std::vector<unsigned char> border;           // per position
+    std::vector<unsigned char> touched;          // per position, collapsed or next to a collapse in this pass
+    std::vector<unsigned int> remap;             // per vertex
+    std::vector<unsigned int> adjacencyStart;    // per vertex, triangles using the vertex
+    std::vector<unsigned int> adjacency;
+    std::unordered_set<std::uint64_t> edges;     // directed position edges of the triangles
+
+    Simplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& position, const std::vector<unsigned int>& wedge,
+               const std::vector<unsigned char>& locked)
+        : vertices(vertices), position(position), wedge(wedge), locked(locked),
+          quadrics(vertices.size()), border(vertices.size(), 0), touched(vertices.size(), 0), remap(vertices.size()),
+          adjacencyStart(vertices.size() + 1, 0)
+    {
+    }
+
+    const Vector3D& pos(unsigned int vertex) const
+    {
+        return vertices[vertex].pos;
+    }
+
+    bool degenerate(const unsigned int* tri) const
+    {
+        return position[tri[0]] == position[tri[1]] || position[tri[0]] == position[tri[2]] || position[tri[1]] == position[tri[2]];
+    }
+
+    bool borderEdge(unsigned int a, unsigned int b) const
+    {
+        return edges.count(edgeKey(a, b)) == 0 || edges.count(edgeKey(b, a)) == 0;
+    }
+
+    void analyze(const std::vector<unsigned int>& triangles)
+    {
+        edges.clear();
+        for(unsigned int index : triangles)
+        {
+            border[position[index]] = 0;
+        }
+        for(std::size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                edges.insert(edgeKey(position[triangles[t + k]], position[triangles[t + (k + 1) % 3]]));
+            }
+        }
+        for(std::size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                const unsigned int a = position[triangles[t + k]];
+                const unsigned int b = position[triangles[t + (k + 1) % 3]];
+                if(edges.count(edgeKey(b, a)) == 0)
+                {
+                    border[a] = border[b] = 1;
+                }
+            }
+        }
+
+        /* triangles per vertex */
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for(unsigned int index : triangles)
+        {
+            adjacencyStart[index + 1]++;
+        }
+        for(std::size_t v = 0; v < vertices.size(); v++)
+        {
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        }
+        adjacency.resize(triangles.size());
+        std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for(std::size_t i = 0; i < triangles.size(); i++)
+        {
+            adjacency[fill[triangles[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+    }
+
+    void initQuadrics(const std::vector<unsigned int>& triangles)
+    {
+        for(unsigned int index : triangles)
+        {
+            quadrics[position[index]] = Quadric{};
+        }
+
+        for(std::size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const unsigned int* tri = &triangles[t];
+            if(degenerate(tri))
+            {
+                continue;
+            }
+
+            const Vector3D normal = cross(pos(tri[1]) - pos(tri[0]), pos(tri[2]) - pos(tri[0]));
+            const float area2 = length(normal);
+            if(area2 <= 0.0f)
+            {
+                continue;
+            }
+
+            for(int k = 0; k < 3; k++)
+            {
+                quadrics[position[tri[k]]].addPlane(normal / area2, pos(tri[0]), 0.5 * area2);
+            }
+
+            for(int k = 0; k < 3; k++)
+            {
+                const unsigned int a = position[tri[k]];
+                const unsigned int b = position[tri[(k + 1) % 3]];
+                if(edges.count(edgeKey(b, a)) != 0)
+                {
+                    continue;
+                }
+
+                const Vector3D edge = pos(b) - pos(a);
+                const Vector3D perpendicular = cross(edge, normal);
+                const float perpendicularLength = length(perpendicular);
+                if(perpendicularLength <= 0.0f)
+                {
+                    continue;
+                }
+
+                const double w = BORDER_WEIGHT * dot(edge, edge);
+                quadrics[a].addPlane(perpendicular / perpendicularLength, pos(a), w);
+                quadrics[b].addPlane(perpendicular / perpendicularLength, pos(a), w);
+            }
+        }
+    }
+
+    /* finds for every vertex at position a the vertex at position b it collapses to, false if a seam would tear */
+    bool targets(unsigned int a, unsigned int b, std::vector<std::pair<unsigned int, unsigned int>>& pairs, const std::vector<unsigned int>& triangles) const
+    {
+        pairs.clear();
+        unsigned int v = a;
+        do
+        {
+            if(adjacencyStart[v] != adjacencyStart[v + 1])
+            {
+                unsigned int target = ~0u;
+                for(unsigned int i = adjacencyStart[v]; i < adjacencyStart[v + 1] && target == ~0u; i++)
+                {
+                    const unsigned int* tri = &triangles[adjacency[i] * 3];
+                    for(int k = 0; k < 3; k++)
+                    {
+                        if(position[tri[k]] == b)
+                        {
+                            target = tri[k];
+                        }
+                    }
+                }
+                if(target == ~0u)
+                {
+                    return false;
+                }
+                pairs.emplace_back(v, target);
+            }
+            v = wedge[v];
+        }
+        while(v != a);
+
+        return true;
+    }
+
+    /* true if moving position a onto b flips or collapses one of the remaining triangles around a */
+    bool flips(unsigned int a, unsigned int b, const std::vector<unsigned int>& triangles) const
+    {
+        unsigned int v = a;
+        do
+        {
+            for(unsigned int i = adjacencyStart[v]; i < adjacencyStart[v + 1]; i++)
+            {
+                const unsigned int* tri = &triangles[adjacency[i] * 3];
+                if(position[tri[0]] == b || position[tri[1]] == b || position[tri[2]] == b)
+                {
+                    continue;
+                }
+
+                Vector3D p[3] = {pos(tri[0]), pos(tri[1]), pos(tri[2])};
+                const Vector3D before = cross(p[1] - p[0], p[2] - p[0]);
+                for(int k = 0; k < 3; k++)
+                {
+                    if(position[tri[k]] == a)
+                    {
+                        p[k] = pos(b);
+                    }
+                }
+                const Vector3D after = cross(p[1] - p[0], p[2] - p[0]);
+
+                if(dot(before, after) < FLIP_THRESHOLD * length(before) * length(after))
+                {
+                    return true;
+                }
+            }
+            v = wedge[v];
+        }
+        while(v != a);
+
+        return false;
+    }
+
+    void touch(unsigned int a, const std::vector<unsigned int>& triangles)
+    {
+        unsigned int v = a;
+        do
+        {
+            for(unsigned int i = adjacencyStart[v]; i < adjacencyStart[v + 1]; i++)
+            {
+                const unsigned int* tri = &triangles[adjacency[i] * 3];
+                for(int k = 0; k < 3; k++)
+                {
+                    touched[position[tri[k]]] = 1;
+                }
+            }
+            v = wedge[v];
+        }
+        while(v != a);
+    }
+
+    /* number of triangles that contain both positions */
+    std::size_t sharedTriangles(unsigned int a, unsigned int b, const std::vector<unsigned int>& triangles) const
+    {
+        std::size_t count = 0;
+        unsigned int v = a;
+        do
+        {
+            for(unsigned int i = adjacencyStart[v]; i < adjacencyStart[v + 1]; i++)
+            {
+                const unsigned int* tri = &triangles[adjacency[i] * 3];
+                count += position[tri[0]] == b || position[tri[1]] == b || position[tri[2]] == b;
+            }
+            v = wedge[v];
+        }
+        while(v != a);
+        return count;
+    }
+
+    /* runs collapse passes until the target is reached, returns the largest squared error of all collapses */
+    double simplify(std::vector<unsigned int>& triangles, std::size_t targetTriangles, double maxError)
+    {
+        struct Collapse
+        {
+            unsigned int from;
+            unsigned int to;
+            double error;
+        };
+
+        analyze(triangles);
+        initQuadrics(triangles);
+
+        double resultError = 0.0;
+        std::vector<Collapse> collapses;
+        std::vector<std::pair<unsigned int, unsigned int>> pairs;
+
+        for(int pass = 0; pass < SIMPLIFY_MAX_PASSES && triangles.size() / 3 > targetTriangles; pass++)
+        {
+            if(pass > 0)
+            {
+                analyze(triangles);
+            }
+
+            collapses.clear();
+            for(std::size_t t = 0; t < triangles.size(); t += 3)
+            {
+                for(int k = 0; k < 3; k++)
+                {
+                    const unsigned int a = position[triangles[t + k]];
+                    const unsigned int b = position[triangles[t + (k + 1) % 3]];
+                    collapses.push_back({a, b, quadrics[a].error(pos(b))});
+                    collapses.push_back({b, a, quadrics[b].error(pos(a))});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+            for(unsigned int index : triangles)
+            {
+                touched[position[index]] = 0;
+                remap[index] = index;
+            }
+
+            const std::size_t needed = triangles.size() / 3 - targetTriangles;
+            std::size_t removed = 0;
+            std::size_t applied = 0;
+
+            for(const Collapse& collapse : collapses)
+            {
+                const unsigned int a = collapse.from;
+                const unsigned int b = collapse.to;
+
+                if(collapse.error > maxError || removed >= needed)
+                {
+                    break;
+                }
+                if(touched[a] || touched[b] || locked[a] || (border[a] && !borderEdge(a, b)))
+                {
+                    continue;
+                }
+                if(!targets(a, b, pairs, triangles) || flips(a, b, triangles))
+                {
+                    continue;
+                }
+
+                for(const auto& [from, to] : pairs)
+                {
+                    remap[from] = to;
+                }
+                quadrics[b].add(quadrics[a]);
+                removed += sharedTriangles(a, b, triangles);
+                touch(a, triangles);
+                resultError = std::max(resultError, collapse.error);
+                applied++;
+            }
+
+            if(applied == 0)
+            {
+                break;
+            }
+
+            std::size_t write = 0;
+            for(std::size_t t = 0; t < triangles.size(); t += 3)
+            {
+                unsigned int tri[3] = {remap[triangles[t]], remap[triangles[t + 1]], remap[triangles[t + 2]]};
+                if(!degenerate(tri))
+                {
+                    triangles[write++] = tri[0];
+                    triangles[write++] = tri[1];
+                    triangles[write++] = tri[2];
+                }
+            }
+            triangles.resize(write);
+        }
+
+        return resultError;
+    }
+};
+
+}
+
+std::size_t meshWeld(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    constexpr unsigned int EMPTY = ~0u;
+
+    /* open addressing hash table with a load factor <= 0.5 */
+    std::size_t tableSize = 1;
+    while(tableSize < vertices.size() * 2)
+    {
+        tableSize *= 2;
+    }
+    const std::size_t mask = tableSize - 1;
+
+    std::vector<unsigned int> table(tableSize, EMPTY);
+    std::vector<unsigned int> remap(vertices.size());
+    unsigned int unique = 0;
+
+    /* vertices are compacted in place, table entries only ever reference already compacted vertices */
+    for(std::size_t i = 0; i < vertices.size(); i++)
+    {
+        std::size_t slot = detail::hashVertex(vertices[i]) & mask;
+        while(table[slot] != EMPTY && !detail::vertexEqual(vertices[table[slot]], vertices[i]))
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        if(table[slot] == EMPTY)
+        {
+            table[slot] = unique;
+            vertices[unique++] = vertices[i];
+        }
+        remap[i] = table[slot];
+    }
+
+    for(auto& index : indices)
+    {
+        index = remap[index];
+    }
+
+    const std::size_t removed = vertices.size() - unique;
+    vertices.resize(unique);
+    return removed;
+}
+
+VertexCacheStats meshAnalyzeVertexCache(const unsigned int *indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if(indexCount < 3 || vertexCount == 0)
+    {
+        return stats;
+    }
+
+    detail::FifoCache cache(vertexCount, cacheSize);
+    for(std::size_t t = 0; t + 3 <= indexCount; t += 3)
+    {
+        cache.triangle(indices + t);
+    }
+    const std::size_t misses = cache.misses;
+
+    stats.hitRate = 1.0f - static_cast<float>(misses) / static_cast<float>(indexCount);
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void meshOptimizeVertexCache(unsigned int *indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if(triangleCount < 2)
+    {
+        return;
+    }
+
+    /* triangles adjacent to each vertex, the first 'remaining' entries of a vertex are the not yet emitted ones */
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for(std::size_t i = 0; i < triangleCount * 3; i++)
+    {
+        remaining[indices[i]]++;
+    }
+
+    std::vector<std::size_t> adjacencyOffset(vertexCount + 1, 0);
+    for(std::size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+    }
+
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<std::size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for(std::size_t t = 0; t < triangleCount; t++)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+            }
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(std::size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScore[v] = detail::forsythScore(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    for(std::size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(detail::FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(detail::FORSYTH_CACHE_SIZE + 3);
+
+    std::size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    std::size_t nextInput = 0;
+
+    while(output.size() < triangleCount * 3)
+    {
+        /* no candidate in the cache, continue with the next triangle in input order */
+        if(best == triangleCount)
+        {
+            while(emitted[nextInput])
+            {
+                nextInput++;
+            }
+            best = nextInput;
+        }
+
+        const unsigned int* tri = indices + best * 3;
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        /* remove the triangle from the adjacency of its vertices */
+        for(int k = 0; k < 3; k++)
+        {
+            const unsigned int v = tri[k];
+            unsigned int* begin = adjacency.data() + adjacencyOffset[v];
+            unsigned int* end = begin + remaining[v];
+            std::iter_swap(std::find(begin, end, static_cast<unsigned int>(best)), end - 1);
+            remaining[v]--;
+        }
+
+        /* move the vertices of the triangle to the front of the LRU cache */
+        newCache.assign(tri, tri + 3);
+        for(unsigned int v : cache)
+        {
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        /* vertices that fell out of the cache */
+        for(std::size_t i = detail::FORSYTH_CACHE_SIZE; i < newCache.size(); i++)
+        {
+            cachePosition[newCache[i]] = -1;
+            vertexScore[newCache[i]] = detail::forsythScore(-1, remaining[newCache[i]]);
+        }
+        newCache.resize(std::min<std::size_t>(newCache.size(), detail::FORSYTH_CACHE_SIZE));
+
+        for(std::size_t i = 0; i < newCache.size(); i++)
+        {
+            cachePosition[newCache[i]] = static_cast<int>(i);
+            vertexScore[newCache[i]] = detail::forsythScore(static_cast<int>(i), remaining[newCache[i]]);
+        }
+        std::swap(cache, newCache);
+
+        /* update the triangles around the cached vertices and pick the best one */
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for(unsigned int v : cache)
+        {
+            for(unsigned int a = 0; a < remaining[v]; a++)
+            {
+                const unsigned int t = adjacency[adjacencyOffset[v] + a];
+                const float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void meshOptimizeOverdraw(unsigned int *indices, std::size_t indexCount, const std::vector<Vertex> &vertices, float threshold)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if(triangleCount < 2)
+    {
+        return;
+    }
+
+    /* split into clusters, hard boundaries where the cache is flushed (all vertices of a triangle miss) */
+    std::vector<std::size_t> hard;
+    {
+        detail::FifoCache cache(vertices.size(), 16);
+        for(std::size_t t = 0; t < triangleCount; t++)
+        {
+            if(cache.triangle(indices + t * 3) == 3)
+            {
+                hard.push_back(t);
+            }
+        }
+        hard.push_back(triangleCount);
+    }
+
+    /* soft boundaries inside hard clusters where the local ACMR is already close to the one of the whole cluster */
+    std::vector<std::size_t> clusters;
+    {
+        detail::FifoCache cache(vertices.size(), 16);
+        for(std::size_t h = 0; h + 1 < hard.size(); h++)
+        {
+            const std::size_t start = hard[h];
+            const std::size_t end = hard[h + 1];
+
+            cache.reset();
+            std::size_t clusterMisses = 0;
+            for(std::size_t t = start; t < end; t++)
+            {
+                clusterMisses += cache.triangle(indices + t * 3);
+            }
+            const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            cache.reset();
+            std::size_t subStart = start;
+            std::size_t subMisses = 0;
+            clusters.push_back(start);
+
+            for(std::size_t t = start; t < end; t++)
+            {
+                subMisses += cache.triangle(indices + t * 3);
+
+                if(t + 1 < end && static_cast<float>(subMisses) / static_cast<float>(t + 1 - subStart) <= clusterThreshold)
+                {
+                    clusters.push_back(t + 1);
+                    subStart = t + 1;
+                    subMisses = 0;
+                    cache.reset();
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+    }
+
+    const std::size_t clusterCount = clusters.size() - 1;
+    if(clusterCount < 2)
+    {
+        return;
+    }
+
+    /* area weighted centroid and normal per cluster */
+    std::vector<Vector3D> clusterCentroid(clusterCount);
+    std::vector<Vector3D> clusterNormal(clusterCount);
+    Vector3D meshCentroid;
+    float meshArea = 0.0f;
+
+    for(std::size_t c = 0; c < clusterCount; c++)
+    {
+        float clusterArea = 0.0f;
+        for(std::size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const Vector3D& a = vertices[indices[t * 3]].pos;
+            const Vector3D& b = vertices[indices[t * 3 + 1]].pos;
+            const Vector3D& d = vertices[indices[t * 3 + 2]].pos;
+
+            Vector3D normal = cross(b - a, d - a);
+            float area = length(normal);
+
+            clusterCentroid[c] += (a + b + d) * (area / 3.0f);
+            clusterNormal[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea;
+
+        clusterCentroid[c] = clusterArea > 0.0f ? clusterCentroid[c] / clusterArea : vertices[indices[clusters[c] * 3]].pos;
+        float normalLength = length(clusterNormal[c]);
+        clusterNormal[c] = normalLength > 0.0f ? clusterNormal[c] / normalLength : Vector3D();
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : Vector3D();
+
+    /* clusters facing outwards (away from the mesh centroid) first */
+    std::vector<float> clusterKey(clusterCount);
+    std::vector<std::size_t> order(clusterCount);
+    for(std::size_t c = 0; c < clusterCount; c++)
+    {
+        clusterKey[c] = dot(clusterCentroid[c] - meshCentroid, clusterNormal[c]);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&clusterKey](std::size_t a, std::size_t b) { return clusterKey[a] > clusterKey[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for(std::size_t c : order)
+    {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void meshOptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    constexpr unsigned int UNUSED = ~0u;
+
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for(auto& index : indices)
+    {
+        if(remap[index] == UNUSED)
+        {
+            remap[index] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
+
+float meshSimplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const std::vector<IndexRange> &ranges,
+                   float ratio, float maxError, std::vector<unsigned int> &result, std::vector<IndexRange> &resultRanges)
+{
+    constexpr unsigned int NONE = ~0u;
+
+    result.clear();
+    resultRanges.clear();
+
+    const std::vector<unsigned int> position = detail::positionIds(vertices);
+
+    /* circular lists of the vertices that share a position */
+    std::vector<unsigned int> wedge(vertices.size());
+    for(std::size_t v = 0; v < vertices.size(); v++)
+    {
+        const unsigned int p = position[v];
+        if(p == v)
+        {
+            wedge[v] = static_cast<unsigned int>(v);
+        }
+        else
+        {
+            wedge[v] = wedge[p];
+            wedge[p] = static_cast<unsigned int>(v);
+        }
+    }
+
+    /* positions shared by ranges or by vertices that select different materials (material boundaries, see
+     * VERTEX_PART_COUNT) never move */
+    std::vector<unsigned int> positionRange(vertices.size(), NONE);
+    std::vector<unsigned char> locked(vertices.size(), 0);
+    for(std::size_t v = 0; v < vertices.size(); v++)
+    {
+        const unsigned int material = static_cast<unsigned int>(vertices[v].normal.w) / VERTEX_PART_COUNT;
+        const unsigned int other = static_cast<unsigned int>(vertices[wedge[v]].normal.w) / VERTEX_PART_COUNT;
+        if(material != other)
+        {
+            locked[position[v]] = 1;
+        }
+    }
+    for(std::size_t r = 0; r < ranges.size(); r++)
+    {
+        for(unsigned int i = ranges[r].offset; i < ranges[r].offset + ranges[r].count; i++)
+        {
+            unsigned int& owner = positionRange[position[indices[i]]];
+            if(owner == NONE)
+            {
+                owner = static_cast<unsigned int>(r);
+            }
+            else if(owner != r)
+            {
+                locked[position[indices[i]]] = 1;
+            }
+        }
+    }
+
+    detail::Simplifier simplifier(vertices, position, wedge, locked);
+    double resultError = 0.0;
+
+    for(const auto& range : ranges)
+    {
+        std::vector<unsigned int> triangles(indices.begin() + range.offset, indices.begin() + range.offset + range.count);
+        const std::size_t targetTriangles = static_cast<std::size_t>(static_cast<float>(range.count / 3) * ratio);
+
+        if(!triangles.empty())
+        {
+            const double error = simplifier.simplify(triangles, targetTriangles, static_cast<double>(maxError) * maxError);
+            resultError = std::max(resultError, error);
+        }
+
+        resultRanges.push_back({static_cast<unsigned int>(result.size()), static_cast<unsigned int>(triangles.size())});
+        result.insert(result.end(), triangles.begin(), triangles.end());
+    }
+
+    return static_cast<float>(std::sqrt(resultError));
+}
+
+namespace detail
+{
+
+/* length is twice the area of the triangle */
+Vector3D triangleNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+{
+    const Vector3D& a = vertices[triangle[0]].pos;
+    return cross(vertices[triangle[1]].pos - a, vertices[triangle[2]].pos - a);
+}
+
+/* open borders are edges of a single triangle, edges are compared by position */
+bool hasBorder(const std::vector<unsigned int>& positions, const std::vector<unsigned int>& indices, const std::vector<IndexRange>& ranges)
+{
+    std::vector<std::uint64_t> edges;
+    for(const auto& range : ranges)
+    {
+        for(unsigned int i = range.offset; i + 2 < range.offset + range.count; i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                const unsigned int a = positions[indices[i + k]];
+                const unsigned int b = positions[indices[i + (k + 1) % 3]];
+                if(a != b)
+                {
+                    edges.push_back(edgeKey(std::min(a, b), std::max(a, b)));
+                }
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for(std::size_t i = 0, j = 0; i < edges.size(); i = j)
+    {
+        while(j < edges.size() && edges[j] == edges[i])
+        {
+            j++;
+        }
+        if(j - i == 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* bounding sphere and normal cone of the triangles of a meshlet */
+void meshletBounds(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, bool cone, Meshlet& meshlet)
+{
+    const MeshBounds bounds = meshRangeBounds(vertices.data(), indices.data(), meshlet.range);
+    meshlet.center = bounds.center;
+    meshlet.radius = bounds.radius;
+
+    const unsigned int end = meshlet.range.offset + meshlet.range.count;
+    Vector3D axis(0.0f, 0.0f, 0.0f);
+    for(unsigned int i = meshlet.range.offset; i < end; i += 3)
+    {
+        const Vector3D normal = triangleNormal(vertices, indices.data() + i);
+        axis += normal;
+
+        /* triangles wound against their vertex normals are meant to be seen from behind */
+        Vector3D vertexNormal(0.0f, 0.0f, 0.0f);
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            const Vector4D& n = vertices[indices[i + k]].normal;
+            vertexNormal += Vector3D(n.x, n.y, n.z);
+        }
+        cone = cone && dot(normal, vertexNormal) >= 0.0f;
+    }
+
+    const float axisLength = length(axis);
+    if(!cone || axisLength <= 0.0f)
+    {
+        return;
+    }
+    axis = axis / axisLength;
+
+    /* the cone has to contain every normal, it cannot cull if they span a half space */
+    float minDot = 1.0f;
+    for(unsigned int i = meshlet.range.offset; i < end; i += 3)
+    {
+        const Vector3D normal = triangleNormal(vertices, indices.data() + i);
+        const float normalLength = length(normal);
+        if(normalLength > 0.0f)
+        {
+            minDot = std::min(minDot, dot(normal, axis) / normalLength);
+        }
+    }
+    if(minDot > 0.0f)
+    {
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+}
+
+void meshBuildMeshlets(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const std::vector<IndexRange> &ranges,
+                       unsigned int maxTriangles, std::vector<Meshlet> &meshlets, std::vector<IndexRange> &meshletRanges)
+{
+    meshlets.clear();
+    meshletRanges.clear();
+
+    const std::vector<unsigned int> positions = detail::positionIds(vertices);
+    const bool closed = !detail::hasBorder(positions, indices, ranges);
+
+    /* meshlet that last added a position, marks the corners of the growing meshlet */
+    constexpr unsigned int NONE = ~0u;
+    std::vector<unsigned int> mark(vertices.size(), NONE);
+
+    std::vector<unsigned int> adjacencyOffsets;
+    std::vector<unsigned int> adjacency;
+    std::vector<Vector3D> normals;
+    std::vector<bool> used;
+    std::vector<unsigned int> frontier;
+    std::vector<unsigned int> output;
+
+    for(const auto& range : ranges)
+    {
+        IndexRange& meshletRange = meshletRanges.emplace_back();
+        meshletRange.offset = static_cast<unsigned int>(meshlets.size());
+
+        const unsigned int* triangles = indices.data() + range.offset;
+        const unsigned int triangleCount = range.count / 3;
+
+        /* triangles around every position */
+        adjacencyOffsets.assign(vertices.size() + 1, 0);
+        for(unsigned int i = 0; i < triangleCount * 3; i++)
+        {
+            adjacencyOffsets[positions[triangles[i]] + 1]++;
+        }
+        for(std::size_t p = 1; p < adjacencyOffsets.size(); p++)
+        {
+            adjacencyOffsets[p] += adjacencyOffsets[p - 1];
+        }
+        adjacency.resize(triangleCount * 3);
+        for(unsigned int i = 0; i < triangleCount * 3; i++)
+        {
+            adjacency[adjacencyOffsets[positions[triangles[i]]]++] = i / 3;
+        }
+        for(std::size_t p = adjacencyOffsets.size() - 1; p > 0; p--)
+        {
+            adjacencyOffsets[p] = adjacencyOffsets[p - 1];
+        }
+        adjacencyOffsets[0] = 0;
+
+        normals.resize(triangleCount);
+        for(unsigned int t = 0; t < triangleCount; t++)
+        {
+            const Vector3D normal = detail::triangleNormal(vertices, triangles + t * 3);
+            const float normalLength = length(normal);
+            normals[t] = normalLength > 0.0f ? normal / normalLength : Vector3D(0.0f, 0.0f, 0.0f);
+        }
+
+        used.assign(triangleCount, false);
+        output.clear();
+        unsigned int cursor = 0;
+
+        while(true)
+        {
+            while(cursor < triangleCount && used[cursor])
+            {
+                cursor++;
+            }
+            if(cursor == triangleCount)
+            {
+                break;
+            }
+
+            /* seeded with the first unused triangle in index order */
+            const unsigned int id = static_cast<unsigned int>(meshlets.size());
+            Meshlet& meshlet = meshlets.emplace_back();
+            meshlet.range.offset = range.offset + static_cast<unsigned int>(output.size());
+
+            frontier.clear();
+            Vector3D axis(0.0f, 0.0f, 0.0f);
+            unsigned int count = 0;
+            unsigned int next = cursor;
+
+            while(true)
+            {
+                used[next] = true;
+                count++;
+                axis += normals[next];
+                for(unsigned int k = 0; k < 3; k++)
+                {
+                    const unsigned int corner = triangles[next * 3 + k];
+                    output.push_back(corner);
+
+                    const unsigned int position = positions[corner];
+                    if(mark[position] == id)
+                    {
+                        continue;
+                    }
+                    mark[position] = id;
+                    for(unsigned int a = adjacencyOffsets[position]; a < adjacencyOffsets[position + 1]; a++)
+                    {
+                        if(!used[adjacency[a]])
+                        {
+                            frontier.push_back(adjacency[a]);
+                        }
+                    }
+                }
+                if(count == maxTriangles)
+                {
+                    break;
+                }
+
+                /* most corners in the meshlet first, then the normal closest to its average */
+                const float axisLength = length(axis);
+                const Vector3D direction = axisLength > 0.0f ? axis / axisLength : Vector3D(0.0f, 0.0f, 0.0f);
+                float bestScore = -std::numeric_limits<float>::max();
+                std::size_t kept = 0;
+                for(std::size_t f = 0; f < frontier.size(); f++)
+                {
+                    const unsigned int candidate = frontier[f];
+                    if(used[candidate])
+                    {
+                        continue;
+                    }
+                    frontier[kept++] = candidate;
+
+                    float score = dot(normals[candidate], direction);
+                    for(unsigned int k = 0; k < 3; k++)
+                    {
+                        score += mark[positions[triangles[candidate * 3 + k]]] == id ? 1.0f : 0.0f;
+                    }
+                    if(score > bestScore)
+                    {
+                        bestScore = score;
+                        next = candidate;
+                    }
+                }
+                frontier.resize(kept);
+
+                /* disconnected triangles continue in index order */
+                if(frontier.empty())
+                {
+                    while(cursor < triangleCount && used[cursor])
+                    {
+                        cursor++;
+                    }
+                    if(cursor == triangleCount)
+                    {
+                        break;
+                    }
+                    next = cursor;
+                }
+            }
+
+            meshlet.range.count = count * 3;
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin() + range.offset);
+        for(std::size_t m = meshletRange.offset; m < meshlets.size(); m++)
+        {
+            detail::meshletBounds(vertices, indices, closed, meshlets[m]);
+        }
+        meshletRange.count = static_cast<unsigned int>(meshlets.size()) - meshletRange.offset;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+
+struct VertexCacheStats
+{
+    float hitRate = 0.0f;   // fraction of indices that hit the simulated post-transform cache
+    float acmr = 0.0f;      // average cache miss ratio, transformed vertices per triangle (0.5 - 3.0, lower is better)
+    float atvr = 0.0f;      // average transformed vertex ratio, transformed vertices per vertex (>= 1.0, lower is better)
+};
+
+/**
+ * @brief Merges all vertices with identical position, normal and uv into one vertex and rewrites the indices
+ * accordingly. The order of the indices (and with that all index ranges, e.g. of materials) is not changed, vertices
+ * keep the order of their first use.
+ *
+ * @param vertices Vertices of the mesh, duplicates are removed.
+ * @param indices Indices of the mesh, rewritten to reference the merged vertices.
+ *
+ * @return Number of vertices that were removed.
+ */
+std::size_t meshWeld(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+/**
+ * @brief Simulates a FIFO post-transform vertex cache for a triangle list.
+ *
+ * @param indices Triangle list indices.
+ * @param indexCount Number of indices.
+ * @param vertexCount Number of vertices referenced by the indices.
+ * @param cacheSize Number of cache entries of the simulated cache.
+ *
+ * @return Hit rate, ACMR and ATVR of the index order.
+ */
+VertexCacheStats meshAnalyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = 16);
+
+/**
+ * @brief Reorders the triangles of a triangle list for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex
+ * Cache Optimisation"). Triangles are only reordered within [indices, indices + indexCount), so it can be applied per
+ * draw range.
+ *
+ * @param indices Triangle list indices, reordered in place.
+ * @param indexCount Number of indices.
+ * @param vertexCount Number of vertices referenced by the indices.
+ */
+void meshOptimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount);
+
+/**
+ * @brief Reorders clusters of a vertex cache optimized triangle list so that triangles facing outwards of the mesh
+ * are drawn first, which reduces overdraw through early depth testing (Sander et al., "Fast Triangle Reordering for
+ * Vertex Locality and Reduced Overdraw"). Clusters are split at vertex cache flushes and wherever the local ACMR is
+ * below threshold times the ACMR of the cluster, so the vertex cache efficiency is mostly kept.
+ *
+ * @param indices Triangle list indices, reordered in place.
+ * @param indexCount Number of indices.
+ * @param vertices Vertices of the mesh.
+ * @param threshold Allowed ACMR degradation, e.g. 1.05 for at most 5% worse.
+ */
+void meshOptimizeOverdraw(unsigned int* indices, std::size_t indexCount, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+/**
+ * @brief Simplifies a triangle list with quadric error metric edge collapses (Garland and Heckbert, "Surface
+ * Simplification Using Quadric Error Metrics"). Vertices are only collapsed onto other existing vertices, so the result
+ * uses the vertex buffer of the input. Every range is simplified on its own and keeps the positions it shares with
+ * other ranges or that vertices with different materials share (material boundaries, see VERTEX_PART_COUNT). Vertices
+ * on open borders only move along the border and attribute seams (e.g. hard edges) only collapse along the seam.
+ *
+ * @param vertices Vertices of the mesh.
+ * @param indices Triangle list indices of the mesh.
+ * @param ranges Ranges of indices that are simplified, e.g. the material ranges.
+ * @param ratio Target fraction of the triangles of each range.
+ * @param maxError Maximum distance of the simplified to the original surface (object space units).
+ * @param result Receives the simplified triangles of all ranges one after another.
+ * @param resultRanges Receives one range per entry in ranges, offsets are relative to the start of result.
+ *
+ * @return Largest error of all collapses that were applied (object space units).
+ */
+float meshSimplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<IndexRange>& ranges,
+                   float ratio, float maxError, std::vector<unsigned int>& result, std::vector<IndexRange>& resultRanges);
+
+/**
+ * @brief Splits the triangles of each range into meshlets of at most maxTriangles triangles and reorders them in place,
+ * so every meshlet is a consecutive range. Meshlets grow greedily over triangles that share positions with them (across
+ * normal and uv seams), preferring triangles that share more corners and face the same way, so they stay compact and
+ * their normal cones narrow. Only the order of the triangles within a range changes.
+ * The cones assume the back of the surface is never seen, so they are disabled (coneCutoff 1) for all meshlets if the
+ * ranges together have an open border, and for meshlets with triangles wound against their vertex normals.
+ *
+ * @param vertices Vertices of the mesh.
+ * @param indices Triangle list indices of the mesh, the triangles of the ranges are reordered.
+ * @param ranges Ranges of indices to split, e.g. the material ranges of one level of detail.
+ * @param maxTriangles Largest number of triangles per meshlet.
+ * @param meshlets Receives the meshlets of all ranges in index order, with bounding sphere and normal cone.
+ * @param meshletRanges Receives one range of meshlets per entry in ranges, offsets are relative to the start of
+ * meshlets.
+ */
+void meshBuildMeshlets(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::vector<IndexRange>& ranges,
+                       unsigned int maxTriangles, std::vector<Meshlet>& meshlets, std::vector<IndexRange>& meshletRanges);
+
+/**
+ * @brief Reorders the vertices in the order of their first use in the index buffer, so vertex fetches become mostly
+ * sequential. Vertices that are not referenced are removed.
+ *
+ * @param vertices Vertices of the mesh, reordered.
+ * @param indices Indices of the mesh, rewritten to the new vertex order.
+ */
+void meshOptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
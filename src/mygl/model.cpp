@@ -1,15 +1,405 @@
 #include "model.h"
+#include "filemap.h"
+#include "mesharena.h"
+#include "meshcache.h"
+#include "meshopt.h"
+#include "parallel.h"
 
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <string_view>
 
 namespace detail
 {
 
+/*------------ in place scanning of memory mapped OBJ/MTL files ------------*/
+
+using MaterialMap = std::map<std::string, Material, std::less<>>;
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* returns the next whitespace separated token of the line [p, end) and advances p behind it */
+inline std::string_view nextToken(const char*& p, const char* end)
+{
+    while(p < end && isBlank(*p))
+    {
+        p++;
+    }
+
+    const char* start = p;
+    while(p < end && !isBlank(*p))
+    {
+        p++;
+    }
+
+    return std::string_view(start, static_cast<std::size_t>(p - start));
+}
+
+inline float nextFloat(const char*& p, const char* end)
+{
+    while(p < end && isBlank(*p))
+    {
+        p++;
+    }
+
+    /* from_chars does not accept an explicit plus sign */
+    if(p < end && *p == '+')
+    {
+        p++;
+    }
+
+    float value = 0.0f;
+    p = std::from_chars(p, end, value).ptr;
+    return value;
+}
+
+inline int nextInt(const char*& p, const char* end)
+{
+    int value = 0;
+    p = std::from_chars(p, end, value).ptr;
+    return value;
+}
+
+/* resolves a 1-based OBJ index or a 0-based chunk local index (see ChunkCorner) to a 0-based index into the global array */
+inline std::size_t resolveIndex(int index, bool relative, std::size_t base, std::size_t count)
+{
+    long long resolved = relative ? static_cast<long long>(base) + index : index - 1ll;
+    if(resolved < 0 || resolved >= static_cast<long long>(count))
+    {
+        throw std::runtime_error("[Model] Invalid index in face definition");
+    }
+
+    return static_cast<std::size_t>(resolved);
+}
+
+struct Corner
+{
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+};
+
+/* parses the next face corner of the form 'v', 'v/vt', 'v//vn' or 'v/vt/vn', returns false at the end of the line */
+inline bool nextCorner(const char*& p, const char* end, Corner& corner)
+{
+    while(p < end && isBlank(*p))
+    {
+        p++;
+    }
+
+    if(p >= end)
+    {
+        return false;
+    }
+
+    corner = Corner{};
+    corner.v = nextInt(p, end);
+
+    if(p < end && *p == '/')
+    {
+        p++;
+        if(p < end && *p != '/')
+        {
+            corner.vt = nextInt(p, end);
+        }
+        if(p < end && *p == '/')
+        {
+            p++;
+            corner.vn = nextInt(p, end);
+        }
+    }
+
+    /* skip garbage so a malformed corner can't stall the scanner */
+    while(p < end && !isBlank(*p))
+    {
+        p++;
+    }
+
+    return corner.v != 0;
+}
+
+/* calls f(code, p, lineEnd) for each non empty line of the buffer, p points behind the command code */
+template<typename F>
+void forEachLine(const char* data, std::size_t size, F f)
+{
+    const char* p = data;
+    const char* end = data + size;
+
+    while(p < end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if(!lineEnd)
+        {
+            lineEnd = end;
+        }
+
+        std::string_view code = nextToken(p, lineEnd);
+        if(!code.empty() && code[0] != '#')
+        {
+            f(code, p, lineEnd);
+        }
+
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+MaterialMap materialParse(const std::string &filepath)
+{
+    FileMap file = fileMapOpen(filepath);
+
+    MaterialMap materials;
+    Material* current = nullptr;
+
+    /* consume material commands */
+    forEachLine(file.data, file.size, [&](std::string_view code, const char* p, const char* end)
+    {
+        /* create new material */
+        if(code == "newmtl")
+        {
+            std::string name(nextToken(p, end));
+
+            current = &materials[name];
+            *current = Material{};
+            current->name = name;
+        }
+        else if(!current)
+        {
+            return;
+        }
+        /* shininess parameter */
+        else if(code == "Ns")
+        {
+            current->shininess = nextFloat(p, end);
+        }
+        /* ambient color */
+        else if(code == "Ka")
+        {
+            current->ambient.x = nextFloat(p, end);
+            current->ambient.y = nextFloat(p, end);
+            current->ambient.z = nextFloat(p, end);
+        }
+        /* diffuse color */
+        else if(code == "Kd")
+        {
+            current->diffuse.x = nextFloat(p, end);
+            current->diffuse.y = nextFloat(p, end);
+            current->diffuse.z = nextFloat(p, end);
+        }
+        /* specular color */
+        else if(code == "Ks")
+        {
+            current->specular.x = nextFloat(p, end);
+            current->specular.y = nextFloat(p, end);
+            current->specular.z = nextFloat(p, end);
+        }
+        /* emission color */
+        else if(code == "Ke")
+        {
+            current->emission.x = nextFloat(p, end);
+            current->emission.y = nextFloat(p, end);
+            current->emission.z = nextFloat(p, end);
+        }
+    });
+
+    fileMapClose(file);
+
+    return materials;
+}
+
+/* starts a material range, each distinct material is only copied once per object */
+void openMaterial(ModelData& model, const Material& material, std::size_t indexOffset)
+{
+    unsigned int id = 0;
+    while(id < model.materials.size() && !materialEqual(model.materials[id], material))
+    {
+        id++;
+    }
+    if(id == model.materials.size())
+    {
+        model.materials.push_back(material);
+    }
+
+    model.material.push_back({static_cast<unsigned int>(indexOffset), 0, id});
+}
+
+void closeMaterial(ModelData& model, std::size_t indexCount)
+{
+    if(!model.material.empty())
+    {
+        auto& material = model.material.back();
+        material.indexCount = indexCount - material.indexOffset;
+    }
+}
+
+void closeMaterial(ModelData& model)
+{
+    closeMaterial(model, model.indices.size());
+}
+
+/*------------ chunked parsing, chunks are parsed in parallel and merged afterwards ------------*/
+
+/* face corner of a chunk, relative (negative) OBJ indices are converted to 0-based chunk local indices */
+struct ChunkCorner
+{
+    enum eRelative { V = 1, VT = 2, VN = 4 };
+
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+    unsigned char relative = 0;
+};
+
+struct ChunkEvent
+{
+    enum eType { OBJECT, MATERIAL, MATERIAL_LIB };
+
+    eType type;
+    std::size_t corner;     /* number of corners in the chunk before the event */
+    std::string_view name;  /* points into the mapped file */
+};
+
+struct Chunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<Vector3D> vertices;
+    std::vector<Vector3D> normals;
+    std::vector<Vector2D> uvs;
+    std::vector<ChunkCorner> corners;
+    std::vector<ChunkEvent> events;
+
+    /* offsets of this chunk in the global arrays, set in the merge step */
+    std::size_t vertexBase = 0;
+    std::size_t normalBase = 0;
+    std::size_t uvBase = 0;
+    std::size_t cornerBase = 0;
+};
+
+/* splits [data, data + size) into up to count line aligned chunks of at least minSize bytes */
+std::vector<Chunk> chunkSplit(const char* data, std::size_t size, std::size_t count, std::size_t minSize)
+{
+    count = std::max<std::size_t>(1, std::min(count, size / std::max<std::size_t>(minSize, 1)));
+
+    std::vector<Chunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+
+    for(std::size_t i = 1; i <= count && begin < end; i++)
+    {
+        const char* split = i == count ? end : data + size * i / count;
+        if(split < begin)
+        {
+            continue;
+        }
+
+        /* move split behind the next line break */
+        const char* lineEnd = static_cast<const char*>(std::memchr(split, '\n', static_cast<std::size_t>(end - split)));
+        split = lineEnd ? lineEnd + 1 : end;
+
+        Chunk& chunk = chunks.emplace_back();
+        chunk.begin = begin;
+        chunk.end = split;
+        begin = split;
+    }
+
+    return chunks;
+}
+
+inline void toChunkCorner(const Corner& corner, const Chunk& chunk, ChunkCorner& out)
+{
+    out.v = corner.v < 0 ? static_cast<int>(chunk.vertices.size()) + corner.v : corner.v;
+    out.vt = corner.vt < 0 ? static_cast<int>(chunk.uvs.size()) + corner.vt : corner.vt;
+    out.vn = corner.vn < 0 ? static_cast<int>(chunk.normals.size()) + corner.vn : corner.vn;
+    out.relative = (corner.v < 0 ? ChunkCorner::V : 0) | (corner.vt < 0 ? ChunkCorner::VT : 0) | (corner.vn < 0 ? ChunkCorner::VN : 0);
+}
+
+void chunkParse(Chunk& chunk)
+{
+    forEachLine(chunk.begin, static_cast<std::size_t>(chunk.end - chunk.begin), [&](std::string_view code, const char* p, const char* end)
+    {
+        /* vertex postion */
+        if(code == "v")
+        {
+            auto& v = chunk.vertices.emplace_back();
+            v.x = nextFloat(p, end);
+            v.y = nextFloat(p, end);
+            v.z = nextFloat(p, end);
+        }
+        /* vertex normal */
+        else if(code == "vn")
+        {
+            auto& vn = chunk.normals.emplace_back();
+            vn.x = nextFloat(p, end);
+            vn.y = nextFloat(p, end);
+            vn.z = nextFloat(p, end);
+        }
+        /* vertex texture coordinates */
+        else if(code == "vt")
+        {
+            auto& vt = chunk.uvs.emplace_back();
+            vt.x = nextFloat(p, end);
+            vt.y = nextFloat(p, end);
+        }
+        /* face definition (polygons are triangulated as fan) */
+        else if(code == "f")
+        {
+            Corner corner;
+            ChunkCorner first, previous, current;
+            unsigned int count = 0;
+
+            while(nextCorner(p, end, corner))
+            {
+                toChunkCorner(corner, chunk, current);
+
+                if(count >= 3)
+                {
+                    chunk.corners.push_back(first);
+                    chunk.corners.push_back(previous);
+                }
+                chunk.corners.push_back(current);
+
+                if(count == 0)
+                {
+                    first = current;
+                }
+                previous = current;
+                count++;
+            }
+        }
+        /* create new object */
+        else if(code == "o")
+        {
+            chunk.events.push_back({ChunkEvent::OBJECT, chunk.corners.size(), nextToken(p, end)});
+        }
+        /* switch to material for next face definitions */
+        else if(code == "usemtl")
+        {
+            chunk.events.push_back({ChunkEvent::MATERIAL, chunk.corners.size(), nextToken(p, end)});
+        }
+        /* load material file (path in respect to .obj file) */
+        else if(code == "mtllib")
+        {
+            chunk.events.push_back({ChunkEvent::MATERIAL_LIB, chunk.corners.size(), nextToken(p, end)});
+        }
+    });
+}
+
+/*------------ previous getline/stringstream parser, only kept as reference for modelBenchmark(...) ------------*/
+
 void tokenize(std::string const &str, const char delim, std::vector<std::string> &out)
 {
     size_t start;
@@ -70,9 +460,7 @@ struct Index
     }
 };
 
-}
-
-std::map<std::string, Material> materialLoad(const std::string &filepath)
+std::map<std::string, Material> streamMaterialParse(const std::string &filepath)
 {
     std::ifstream materialFile(filepath);
     if(!materialFile.is_open())
@@ -83,17 +471,14 @@ std::map<std::string, Material> materialLoad(const std::string &filepath)
     std::map<std::string, Material> materials;
     Material* current = nullptr;
 
-    /* consume material commands */
     std::string line;
     while(std::getline(materialFile, line))
     {
         std::stringstream ss(line);
 
-        /* command code */
         std::string code;
         ss >> code;
 
-        /* create new material */
         if(code == "newmtl")
         {
             Material material;
@@ -102,7 +487,6 @@ std::map<std::string, Material> materialLoad(const std::string &filepath)
             materials[material.name] = material;
             current = &materials[material.name];
         }
-        /* shininess parameter */
         else if(code == "Ns" && current)
         {
             float ns = 1.0f;
@@ -110,22 +494,18 @@ std::map<std::string, Material> materialLoad(const std::string &filepath)
 
             current->shininess = ns;
         }
-        /* ambient color */
         else if(code == "Ka" && current)
         {
             ss >> current->ambient.x >> current->ambient.y >> current->ambient.z;
         }
-        /* diffuse color */
         else if(code == "Kd" && current)
         {
             ss >> current->diffuse.x >> current->diffuse.y >> current->diffuse.z;
         }
-        /* specular color */
         else if(code == "Ks" && current)
         {
             ss >> current->specular.x >> current->specular.y >> current->specular.z;
         }
-        /* emission color */
         else if(code == "Ke" && current)
         {
             ss >> current->emission.x >> current->emission.y >> current->emission.z;
@@ -135,7 +515,7 @@ std::map<std::string, Material> materialLoad(const std::string &filepath)
     return materials;
 }
 
-std::vector<Model> modelLoad(const std::string &filepath)
+std::vector<ModelData> streamParse(const std::string &filepath)
 {
     std::ifstream objFile(filepath);
     if(!objFile.is_open())
@@ -143,24 +523,18 @@ std::vector<Model> modelLoad(const std::string &filepath)
         throw std::runtime_error("[Model] Couldn't open OBJ file at " + filepath);
     }
 
-    /* container for GL related stuff */
-    std::vector<Model> models;
-    std::vector<Vertex> glVertices;
-    std::vector<unsigned int> glIndices;
+    std::vector<ModelData> models;
 
-    /* container for OBJ related stuff */
     std::map<std::string, Material> materials;
     std::vector<Vector3D> vertices;
     std::vector<Vector3D> normals;
     std::vector<Vector2D> uvs;
 
-    /* consume commonds from obj file */
     std::string line;
     while(std::getline(objFile, line))
     {
         std::stringstream ss(line);
 
-        /* command code */
         std::string code;
         ss >> code;
 
@@ -168,193 +542,1202 @@ std::vector<Model> modelLoad(const std::string &filepath)
         {
             continue;
         }
-        /* create new object */
         else if(code == "o")
         {
             if(!models.empty())
             {
-                Model& model = models.back();
-                model.mesh = meshCreate(glVertices, glIndices, GL_STATIC_DRAW, GL_STATIC_DRAW);
-
-                if(!model.material.empty())
-                {
-                    auto& material = model.material.back();
-                    material.indexCount = glVertices.size() - material.indexOffset;
-                }
-
-                glVertices.clear();
-                glIndices.clear();
+                closeMaterial(models.back());
             }
 
-            Model& model = models.emplace_back();
+            ModelData& model = models.emplace_back();
             ss >> model.name;
         }
-        /* vertex postion */
         else if(code == "v")
         {
             auto& v = vertices.emplace_back();
             ss >> v.x >> v.y >> v.z;
         }
-        /* vertex texture coordinates */
         else if(code == "vt")
         {
             auto& vt = uvs.emplace_back();
             ss >> vt.x >> vt.y;
         }
-        /* vertex normal */
         else if(code == "vn")
         {
             auto& vn = normals.emplace_back();
             ss >> vn.x >> vn.y >> vn.z;
         }
-        /* face definition (currently only triangles) */
         else if(code == "f")
         {
-            detail::Index _idx[3];
+            ModelData& model = models.back();
+
+            Index _idx[3];
             ss >> _idx[0] >> _idx[1] >> _idx[2];
 
             for(int i = 0; i < 3; i++)
             {
-                glIndices.emplace_back(glVertices.size());
+                model.indices.emplace_back(model.vertices.size());
 
-                Vertex& vertex = glVertices.emplace_back();
+                Vertex& vertex = model.vertices.emplace_back();
                 vertex.pos = vertices[_idx[i].v - 1];
 
-                if(_idx[i].type == detail::Index::V_VN)
+                if(_idx[i].type == Index::V_VN)
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
+                    vertex.normal = Vector4D(normals[_idx[i].vn - 1], 0.0f);
                 }
-                else if(_idx[i].type == detail::Index::V_VT_VN)
+                else if(_idx[i].type == Index::V_VT_VN)
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
+                    vertex.normal = Vector4D(normals[_idx[i].vn - 1], 0.0f);
                     vertex.uv = uvs[_idx[i].vt - 1];
                 }
             }
         }
-        /* load material file (path in respect to .obj file) */
         else if(code == "mtllib")
         {
             std::string file;
             ss >> file;
-            materials = materialLoad( filepath.substr(0, filepath.find_last_of("\\/")) + "/" + file );
+            materials = streamMaterialParse( filepath.substr(0, filepath.find_last_of("\\/")) + "/" + file );
         }
-        /* switch to material for next face definitions */
         else if(code == "usemtl")
         {
             auto& model = models.back();
             std::string name;
             ss >> name;
 
-            if(!model.material.empty())
-            {
-                auto& material = model.material.back();
-                material.indexCount = glVertices.size() - material.indexOffset;
-            }
-
-            auto& material = model.material.emplace_back( materials[name] );
-            material.indexOffset = glVertices.size();
+            closeMaterial(model);
+            openMaterial(model, materials[name], model.indices.size());
         }
     }
 
-    /* finnish up last object */
-    Model& model = models.back();
-    model.mesh = meshCreate(glVertices, glIndices, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    if(!model.material.empty())
+    if(!models.empty())
     {
-        auto& material = model.material.back();
-        material.indexCount = glVertices.size() - material.indexOffset;
+        closeMaterial(models.back());
     }
 
     return models;
 }
 
-std::vector<Vertex> verticesLoad(const std::string &filepath)
+bool sameVertex(const Vertex& a, const Vertex& b)
 {
-    std::ifstream objFile(filepath);
-    if(!objFile.is_open())
+    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+bool sameModels(const std::vector<ModelData>& a, const std::vector<ModelData>& b)
+{
+    if(a.size() != b.size())
     {
-        throw std::runtime_error("[Flag] Couldn't open OBJ file at " + filepath);
+        return false;
     }
 
-    /* container for GL related stuff */
-    std::vector<Vertex> glVertices;
-    std::vector<unsigned int> glIndices;
-
-    /* container for OBJ related stuff */
-    std::vector<Vector3D> vertices;
-    std::vector<Vector3D> normals;
-    std::vector<Vector2D> uvs;
-
-    int modelCount = 0;
-
-    /* consume commonds from obj file */
-    std::string line;
-    while(std::getline(objFile, line))
+    for(std::size_t i = 0; i < a.size(); i++)
     {
-        std::stringstream ss(line);
-
-        /* command code */
-        std::string code;
-        ss >> code;
-
-        if(code == "")
+        if(a[i].name != b[i].name || a[i].indices != b[i].indices ||
+           a[i].vertices.size() != b[i].vertices.size() || a[i].material.size() != b[i].material.size())
         {
-            continue;
+            return false;
         }
-        /* create new object */
-        else if(code == "o")
+
+        for(std::size_t v = 0; v < a[i].vertices.size(); v++)
         {
-            if(modelCount > 1)
+            if(!sameVertex(a[i].vertices[v], b[i].vertices[v]))
             {
-                throw std::runtime_error("[Flag] More than one object not supported");
+                return false;
             }
-            modelCount++;
-        }
-        /* vertex postion */
-        else if(code == "v")
-        {
-            auto& v = vertices.emplace_back();
-            ss >> v.x >> v.y >> v.z;
         }
-        /* vertex texture coordinates */
-        else if(code == "vt")
+
+        for(std::size_t m = 0; m < a[i].material.size(); m++)
         {
-            auto& vt = uvs.emplace_back();
-            ss >> vt.x >> vt.y;
+            const MaterialRange& ra = a[i].material[m];
+            const MaterialRange& rb = b[i].material[m];
+            if(ra.indexOffset != rb.indexOffset || ra.indexCount != rb.indexCount ||
+               a[i].materials[ra.materialId].name != b[i].materials[rb.materialId].name ||
+               std::memcmp(&a[i].materials[ra.materialId].diffuse, &b[i].materials[rb.materialId].diffuse, sizeof(Vector3D)) != 0)
+            {
+                return false;
+            }
         }
-        /* vertex normal */
-        else if(code == "vn")
+    }
+
+    return true;
+}
+
+}
+
+std::vector<ModelData> modelParse(const std::string &filepath, std::vector<std::string>* sources, unsigned int threadCount)
+{
+    FileMap file;
+    try
+    {
+        file = fileMapOpen(filepath);
+    }
+    catch(const std::runtime_error&)
+    {
+        throw std::runtime_error("[Model] Couldn't open OBJ file at " + filepath);
+    }
+
+    if(sources)
+    {
+        sources->push_back(filepath);
+    }
+
+    /* container for model data */
+    std::vector<ModelData> models;
+    std::vector<std::size_t> modelCornerBegin;
+
+    /* container for OBJ related stuff */
+    detail::MaterialMap materials;
+    std::vector<Vector3D> vertices;
+    std::vector<Vector3D> normals;
+    std::vector<Vector2D> uvs;
+
+    try
+    {
+        /* 1. parse line aligned chunks of the file in parallel (chunks smaller than 64 KiB are not worth a thread) */
+        std::vector<detail::Chunk> chunks = detail::chunkSplit(file.data, file.size, parallelThreadCount(threadCount), 64 * 1024);
+        parallelFor(chunks.size(), [&chunks](std::size_t i)
         {
-            auto& vn = normals.emplace_back();
-            ss >> vn.x >> vn.y >> vn.z;
+            detail::chunkParse(chunks[i]);
+        });
+
+        /* 2. merge, compute global offsets of each chunk and build the object/material layout from the chunk events */
+        std::size_t cornerCount = 0;
+        for(auto& chunk : chunks)
+        {
+            chunk.vertexBase = vertices.size();
+            chunk.normalBase = normals.size();
+            chunk.uvBase = uvs.size();
+            chunk.cornerBase = cornerCount;
+
+            vertices.resize(vertices.size() + chunk.vertices.size());
+            normals.resize(normals.size() + chunk.normals.size());
+            uvs.resize(uvs.size() + chunk.uvs.size());
+
+            /* faces or materials before the first 'o' command belong to an unnamed object */
+            auto currentModel = [&]() -> ModelData&
+            {
+                if(models.empty())
+                {
+                    modelCornerBegin.push_back(0);
+                    return models.emplace_back();
+                }
+                return models.back();
+            };
+
+            for(const auto& event : chunk.events)
+            {
+                const std::size_t corner = chunk.cornerBase + event.corner;
+
+                if(event.type == detail::ChunkEvent::OBJECT)
+                {
+                    if(models.empty() && corner > 0)
+                    {
+                        currentModel();
+                    }
+                    if(!models.empty())
+                    {
+                        detail::closeMaterial(models.back(), corner - modelCornerBegin.back());
+                    }
+
+                    ModelData& model = models.emplace_back();
+                    model.name = event.name;
+                    modelCornerBegin.push_back(corner);
+                }
+                else if(event.type == detail::ChunkEvent::MATERIAL)
+                {
+                    ModelData& model = currentModel();
+                    detail::closeMaterial(model, corner - modelCornerBegin.back());
+
+                    auto it = materials.find(event.name);
+                    if(it != materials.end())
+                    {
+                        detail::openMaterial(model, it->second, corner - modelCornerBegin.back());
+                    }
+                    else
+                    {
+                        Material missing;
+                        missing.name = event.name;
+                        detail::openMaterial(model, missing, corner - modelCornerBegin.back());
+                    }
+                }
+                else if(event.type == detail::ChunkEvent::MATERIAL_LIB)
+                {
+                    std::string materialPath = filepath.substr(0, filepath.find_last_of("\\/")) + "/" + std::string(event.name);
+                    materials = detail::materialParse(materialPath);
+
+                    if(sources)
+                    {
+                        sources->push_back(materialPath);
+                    }
+                }
+            }
+
+            cornerCount += chunk.corners.size();
         }
-        /* face definition (currently only triangles) */
-        else if(code == "f")
+
+        if(cornerCount > 0 && models.empty())
         {
-            detail::Index _idx[3];
-            ss >> _idx[0] >> _idx[1] >> _idx[2];
+            modelCornerBegin.push_back(0);
+            models.emplace_back();
+        }
 
-            for(int i = 0; i < 3; i++)
+        /* finish up last object */
+        if(!models.empty())
+        {
+            detail::closeMaterial(models.back(), cornerCount - modelCornerBegin.back());
+        }
+
+        /* every corner becomes a vertex of its object */
+        modelCornerBegin.push_back(cornerCount);
+        for(std::size_t i = 0; i < models.size(); i++)
+        {
+            const std::size_t count = modelCornerBegin[i + 1] - modelCornerBegin[i];
+            models[i].vertices.resize(count);
+            models[i].indices.resize(count);
+        }
+
+        /* 3. copy the chunk local attributes into the global arrays */
+        parallelFor(chunks.size(), [&](std::size_t i)
+        {
+            detail::Chunk& chunk = chunks[i];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + chunk.vertexBase);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase);
+            std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvBase);
+        });
+
+        /* 4. resolve the global 1-based index references of the faces, each chunk fills its own slots */
+        parallelFor(chunks.size(), [&](std::size_t i)
+        {
+            const detail::Chunk& chunk = chunks[i];
+            if(chunk.corners.empty())
             {
-                glIndices.emplace_back(glVertices.size());
+                return;
+            }
 
-                Vertex& vertex = glVertices.emplace_back();
-                vertex.pos = vertices[_idx[i].v - 1];
+            /* object that contains the first corner of the chunk */
+            std::size_t model = std::upper_bound(modelCornerBegin.begin(), modelCornerBegin.end(), chunk.cornerBase) - modelCornerBegin.begin() - 1;
 
-                if(_idx[i].type == detail::Index::V_VN)
+            for(std::size_t c = 0; c < chunk.corners.size(); c++)
+            {
+                const std::size_t corner = chunk.cornerBase + c;
+                while(corner >= modelCornerBegin[model + 1])
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
+                    model++;
                 }
-                else if(_idx[i].type == detail::Index::V_VT_VN)
+
+                const detail::ChunkCorner& idx = chunk.corners[c];
+                const std::size_t index = corner - modelCornerBegin[model];
+
+                models[model].indices[index] = index;
+
+                Vertex& vertex = models[model].vertices[index];
+                vertex.pos = vertices[detail::resolveIndex(idx.v, idx.relative & detail::ChunkCorner::V, chunk.vertexBase, vertices.size())];
+
+                if(idx.vn != 0 || (idx.relative & detail::ChunkCorner::VN))
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
-                    vertex.uv = uvs[_idx[i].vt - 1];
+                    vertex.normal = Vector4D(normals[detail::resolveIndex(idx.vn, idx.relative & detail::ChunkCorner::VN, chunk.normalBase, normals.size())], 0.0f);
+                }
+                if(idx.vt != 0 || (idx.relative & detail::ChunkCorner::VT))
+                {
+                    vertex.uv = uvs[detail::resolveIndex(idx.vt, idx.relative & detail::ChunkCorner::VT, chunk.uvBase, uvs.size())];
+                }
+            }
+        });
+    }
+    catch(...)
+    {
+        fileMapClose(file);
+        throw;
+    }
+
+    fileMapClose(file);
+
+    return models;
+}
+
+Mesh modelMeshCreate(const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices, std::size_t indexCount, const ModelLoadOptions &options,
+                     const MeshBox* quantizationBox)
+{
+    if(options.arena)
+    {
+        return meshArenaAlloc(*options.arena, vertices, vertexCount, indices, indexCount, quantizationBox);
+    }
+    return meshCreate(vertices, vertexCount, indices, indexCount, GL_STATIC_DRAW, GL_STATIC_DRAW, options.packVertices ? VertexPacked : VertexFloat,
+                      quantizationBox, options.positionStream);
+}
+
+namespace detail
+{
+
+/* distance from the origin to the closest point of a triangle (Ericson, "Real-Time Collision Detection", 5.1.5) */
+float triangleOriginDistance(const Vector3D& a, const Vector3D& b, const Vector3D& c)
+{
+    const Vector3D ab = b - a;
+    const Vector3D ac = c - a;
+    const Vector3D ap = -a;
+
+    const float d1 = dot(ab, ap);
+    const float d2 = dot(ac, ap);
+    if(d1 <= 0.0f && d2 <= 0.0f)
+    {
+        return length(a);
+    }
+
+    const Vector3D bp = -b;
+    const float d3 = dot(ab, bp);
+    const float d4 = dot(ac, bp);
+    if(d3 >= 0.0f && d4 <= d3)
+    {
+        return length(b);
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        return length(a + d1 / (d1 - d3) * ab);
+    }
+
+    const Vector3D cp = -c;
+    const float d5 = dot(ab, cp);
+    const float d6 = dot(ac, cp);
+    if(d6 >= 0.0f && d5 <= d6)
+    {
+        return length(c);
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        return length(a + d2 / (d2 - d6) * ac);
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if(va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    {
+        return length(b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b));
+    }
+
+    const float denom = 1.0f / (va + vb + vc);
+    return length(a + vb * denom * ab + vc * denom * ac);
+}
+
+}
+
+void modelComputeBounds(Model &model, const Vertex *vertices, const unsigned int *indices)
+{
+    model.materialBounds.resize(model.material.size());
+    for(std::size_t i = 0; i < model.material.size(); i++)
+    {
+        const MaterialRange& range = model.material[i];
+        model.materialBounds[i] = meshRangeBounds(vertices, indices, {range.indexOffset, range.indexCount});
+    }
+
+    /* coarser levels cut through the full detail surface, so every level gets its own distance */
+    const auto rangesDistance = [vertices, indices](const std::vector<IndexRange>& ranges)
+    {
+        float distance = std::numeric_limits<float>::max();
+        for(const auto& range : ranges)
+        {
+            for(unsigned int i = range.offset; i + 2 < range.offset + range.count; i += 3)
+            {
+                distance = std::min(distance, detail::triangleOriginDistance(vertices[indices[i]].pos, vertices[indices[i + 1]].pos,
+                                                                             vertices[indices[i + 2]].pos));
+            }
+        }
+        return distance == std::numeric_limits<float>::max() ? 0.0f : distance;
+    };
+
+    std::vector<IndexRange> ranges;
+    for(const auto& range : model.material)
+    {
+        ranges.push_back({range.indexOffset, range.indexCount});
+    }
+    model.originDistance = rangesDistance(ranges);
+
+    for(auto& level : model.lods)
+    {
+        level.originDistance = rangesDistance(level.material);
+        model.originDistance = std::min(model.originDistance, level.originDistance);
+    }
+}
+
+void modelKeepOccluder(Model &model, const Vertex *vertices, std::size_t vertexCount, const unsigned int *indices,
+                       const ModelLoadOptions &options)
+{
+    if(options.occluderRadius <= 0.0f || model.mesh.boundsRadius < options.occluderRadius || !model.parts.empty())
+    {
+        return;
+    }
+
+    model.occluderPositions.resize(vertexCount);
+    for(std::size_t i = 0; i < vertexCount; i++)
+    {
+        model.occluderPositions[i] = vertices[i].pos;
+    }
+    for(const auto& range : model.material)
+    {
+        model.occluderIndices.insert(model.occluderIndices.end(), indices + range.indexOffset,
+                                     indices + range.indexOffset + range.indexCount);
+    }
+}
+
+MeshBox modelBox(const std::vector<ModelData> &data)
+{
+    MeshBox box;
+    for(const auto& d : data)
+    {
+        meshBoxExtend(box, meshBox(d.vertices.data(), d.vertices.size()));
+    }
+    return box;
+}
+
+std::vector<MaterialRange> modelInternMaterials(const std::vector<Material> &materials, const std::vector<MaterialRange> &ranges,
+                                                bool vertexMaterials)
+{
+    std::vector<unsigned int> ids(materials.size());
+    const unsigned int first = vertexMaterials ? materialInternBlock(materials) : 0;
+    for(std::size_t i = 0; i < materials.size(); i++)
+    {
+        ids[i] = vertexMaterials ? first + static_cast<unsigned int>(i) : materialIntern(materials[i]);
+    }
+
+    std::vector<MaterialRange> result = ranges;
+    for(auto& range : result)
+    {
+        range.materialId = ids.at(range.materialId);
+    }
+    return result;
+}
+
+std::vector<Model> modelCreate(const std::vector<ModelData> &data, const ModelLoadOptions &options)
+{
+    std::vector<Model> models;
+    models.reserve(data.size());
+
+    const MeshBox box = options.sharedQuantization ? modelBox(data) : MeshBox{};
+
+    for(const auto& d : data)
+    {
+        Model& model = models.emplace_back();
+        model.mesh = modelMeshCreate(d.vertices.data(), d.vertices.size(), d.indices.data(), d.indices.size(), options,
+                                     options.sharedQuantization ? &box : nullptr);
+        model.name = d.name;
+        model.material = modelInternMaterials(d.materials, d.material, !d.parts.empty());
+        model.vertexMaterialCount = d.parts.empty() ? 0 : static_cast<unsigned int>(d.materials.size());
+        model.lods = d.lods;
+        model.meshlets = d.meshlets;
+        model.instances = d.instances;
+        model.parts = d.parts;
+        modelComputeBounds(model, d.vertices.data(), d.indices.data());
+        modelKeepOccluder(model, d.vertices.data(), d.vertices.size(), d.indices.data(), options);
+    }
+
+    return models;
+}
+
+/* level of detail chain: each level targets MODEL_LOD_RATIO of the triangles of the previous one and has to keep at
+ * most MODEL_LOD_MIN_REDUCTION of them, collapses are limited to MODEL_LOD_MAX_ERROR times the bounding radius */
+constexpr std::size_t MODEL_MAX_LODS = 4;
+constexpr std::size_t MODEL_LOD_MIN_TRIANGLES = 64;
+constexpr float MODEL_LOD_RATIO = 0.5f;
+constexpr float MODEL_LOD_MIN_REDUCTION = 0.9f;
+constexpr float MODEL_LOD_MAX_ERROR = 0.25f;
+
+/* triangles per meshlet, small enough for the cones to stay narrow on curved surfaces */
+constexpr unsigned int MODEL_MESHLET_TRIANGLES = 64;
+
+/* a coarser level is selected once its projected error is below this fraction of the allowed error */
+constexpr float MODEL_LOD_HYSTERESIS = 0.75f;
+
+namespace detail
+{
+
+/* index ranges of the materials and the LOD levels, indices not covered by any of them get their own ranges */
+std::vector<std::pair<std::size_t, std::size_t>> indexRanges(const ModelData& model)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> used;
+    for(const auto& material : model.material)
+    {
+        used.emplace_back(material.indexOffset, material.indexCount);
+    }
+    for(const auto& lod : model.lods)
+    {
+        for(const auto& range : lod.material)
+        {
+            used.emplace_back(range.offset, range.count);
+        }
+    }
+    /* meshlets sort before the range they start, so they replace it and are optimized on their own */
+    for(const auto& meshlet : model.meshlets)
+    {
+        used.emplace_back(meshlet.range.offset, meshlet.range.count);
+    }
+    std::sort(used.begin(), used.end());
+
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    std::size_t covered = 0;
+
+    for(const auto& [offset, count] : used)
+    {
+        /* lods[0] repeats the material ranges, meshlets split them */
+        if(offset < covered || count == 0)
+        {
+            continue;
+        }
+        if(offset > covered)
+        {
+            ranges.emplace_back(covered, offset - covered);
+        }
+        ranges.emplace_back(offset, count);
+        covered = offset + count;
+    }
+
+    if(model.indices.size() > covered)
+    {
+        ranges.emplace_back(covered, model.indices.size() - covered);
+    }
+
+    return ranges;
+}
+
+/* same triangles and material ranges, only the vertex data may differ */
+bool sameTopology(const ModelData& a, const ModelData& b)
+{
+    if(a.vertices.size() != b.vertices.size() || a.indices != b.indices || a.material.size() != b.material.size())
+    {
+        return false;
+    }
+
+    for(std::size_t m = 0; m < a.material.size(); m++)
+    {
+        const MaterialRange& ra = a.material[m];
+        const MaterialRange& rb = b.material[m];
+        if(ra.indexOffset != rb.indexOffset || ra.indexCount != rb.indexCount ||
+           !materialEqual(a.materials[ra.materialId], b.materials[rb.materialId]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* orthonormal frame spanned by three vertices, false if they are collinear */
+bool vertexFrame(const std::vector<Vertex>& vertices, const std::size_t corners[3], Vector3D frame[3])
+{
+    const Vector3D a = vertices[corners[1]].pos - vertices[corners[0]].pos;
+    const Vector3D normal = cross(a, vertices[corners[2]].pos - vertices[corners[0]].pos);
+    if(length(a) == 0.0f || length(normal) <= 1e-6f * dot(a, a))
+    {
+        return false;
+    }
+
+    frame[0] = normalize(a);
+    frame[2] = normalize(normal);
+    frame[1] = cross(frame[2], frame[0]);
+    return true;
+}
+
+/* finds the rotation, uniform scale and translation that maps the vertices of a onto the vertices of b (in the same
+ * order), false if there is none, e.g. for mirrored or differently textured copies */
+bool similarityTransform(const ModelData& a, const ModelData& b, Matrix4D& transform)
+{
+    const std::vector<Vertex>& va = a.vertices;
+    const std::vector<Vertex>& vb = b.vertices;
+    if(va.empty())
+    {
+        return false;
+    }
+
+    /* frame of the first vertex, the vertex furthest from it and the one spanning the largest triangle with both */
+    std::size_t corners[3] = {0, 0, 0};
+    float extent = 0.0f;
+    for(std::size_t i = 0; i < va.size(); i++)
+    {
+        const float d = length(va[i].pos - va[0].pos);
+        if(d > extent)
+        {
+            extent = d;
+            corners[1] = i;
+        }
+    }
+    float best = 0.0f;
+    for(std::size_t i = 0; i < va.size(); i++)
+    {
+        const float area = length(cross(va[corners[1]].pos - va[0].pos, va[i].pos - va[0].pos));
+        if(area > best)
+        {
+            best = area;
+            corners[2] = i;
+        }
+    }
+
+    Vector3D fa[3], fb[3];
+    if(!vertexFrame(va, corners, fa) || !vertexFrame(vb, corners, fb))
+    {
+        return false;
+    }
+
+    const float scale = length(vb[corners[1]].pos - vb[0].pos) / extent;
+
+    /* rotation fb * transpose(fa), maps the frame of a onto the frame of b */
+    Matrix3D rotation;
+    for(int r = 0; r < 3; r++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            rotation(r, c) = fa[0][c] * fb[0][r] + fa[1][c] * fb[1][r] + fa[2][c] * fb[2][r];
+        }
+    }
+
+    const Vector3D translation = vb[0].pos - scale * (rotation * va[0].pos);
+    transform = Matrix4D::translation(translation) * Matrix4D(rotation) * Matrix4D::scale(scale, scale, scale);
+
+    /* positions within float precision of the coordinates, normals and uvs as written in the file */
+    const float tolerance = 1e-5f * (1.0f + length(vb[0].pos) + scale * extent);
+    for(std::size_t i = 0; i < va.size(); i++)
+    {
+        const Vector3D normal = rotation * Vector3D(va[i].normal.x, va[i].normal.y, va[i].normal.z);
+        if(length(translation + scale * (rotation * va[i].pos) - vb[i].pos) > tolerance ||
+           length(normal - Vector3D(vb[i].normal.x, vb[i].normal.y, vb[i].normal.z)) > 1e-3f ||
+           std::fabs(va[i].uv.x - vb[i].uv.x) > 1e-5f || std::fabs(va[i].uv.y - vb[i].uv.y) > 1e-5f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* sum of vertex cache misses over all models */
+float vertexCacheMisses(const std::vector<ModelData>& data)
+{
+    float misses = 0.0f;
+    for(const auto& model : data)
+    {
+        VertexCacheStats stats = meshAnalyzeVertexCache(model.indices.data(), model.indices.size(), model.vertices.size());
+        misses += (1.0f - stats.hitRate) * model.indices.size();
+    }
+    return misses;
+}
+
+}
+
+std::size_t modelInstance(std::vector<ModelData> &data)
+{
+    std::vector<ModelData> unique;
+    std::size_t removed = 0;
+
+    for(auto& model : data)
+    {
+        Matrix4D transform;
+        auto original = std::find_if(unique.begin(), unique.end(), [&](const ModelData& candidate)
+        {
+            return detail::sameTopology(candidate, model) && detail::similarityTransform(candidate, model, transform);
+        });
+
+        if(original == unique.end())
+        {
+            unique.push_back(std::move(model));
+            continue;
+        }
+
+        if(original->instances.empty())
+        {
+            original->instances.push_back(Matrix4D::identity());
+        }
+        original->instances.push_back(transform);
+        removed++;
+    }
+
+    data = std::move(unique);
+    return removed;
+}
+
+void modelMerge(std::vector<ModelData> &data, const std::string &name)
+{
+    /* the part value is stored in the int16 w of packed positions */
+    constexpr std::size_t MAX_MATERIALS = (static_cast<std::size_t>(std::numeric_limits<std::int16_t>::max()) + 1) / VERTEX_PART_COUNT;
+    if(data.size() > VERTEX_PART_COUNT)
+    {
+        throw std::runtime_error("[Model] too many objects to merge: " + std::to_string(data.size()));
+    }
+
+    ModelData merged;
+    merged.name = name;
+
+    /* materials of all objects in order of first use */
+    std::vector<std::vector<unsigned int>> materialIds(data.size());
+    for(std::size_t part = 0; part < data.size(); part++)
+    {
+        const ModelData& model = data[part];
+        merged.parts.push_back(model.name);
+
+        for(const auto& material : model.materials)
+        {
+            auto it = std::find_if(merged.materials.begin(), merged.materials.end(),
+                                   [&material](const Material& m) { return materialEqual(m, material); });
+            materialIds[part].push_back(static_cast<unsigned int>(it - merged.materials.begin()));
+            if(it == merged.materials.end())
+            {
+                merged.materials.push_back(material);
+            }
+        }
+    }
+
+    if(merged.materials.size() > MAX_MATERIALS)
+    {
+        throw std::runtime_error("[Model] too many materials to merge: " + std::to_string(merged.materials.size()));
+    }
+
+    /* one range with the triangles of all parts grouped by material, each vertex is copied once per material that uses
+     * it, the copies carry part and material in their part value */
+    constexpr unsigned int NONE = ~0u;
+    std::vector<unsigned int> copies;
+    for(unsigned int m = 0; m < merged.materials.size(); m++)
+    {
+        for(std::size_t part = 0; part < data.size(); part++)
+        {
+            const ModelData& model = data[part];
+            copies.assign(model.vertices.size(), NONE);
+
+            for(const auto& r : model.material)
+            {
+                if(materialIds[part][r.materialId] != m)
+                {
+                    continue;
                 }
+                for(unsigned int i = r.indexOffset; i < r.indexOffset + r.indexCount; i++)
+                {
+                    const unsigned int v = model.indices[i];
+                    if(copies[v] == NONE)
+                    {
+                        copies[v] = static_cast<unsigned int>(merged.vertices.size());
+                        Vertex vertex = model.vertices[v];
+                        vertex.normal.w = static_cast<float>(part + VERTEX_PART_COUNT * m);
+                        merged.vertices.push_back(vertex);
+                    }
+                    merged.indices.push_back(copies[v]);
+                }
+            }
+        }
+    }
+
+    MaterialRange range;
+    range.indexCount = static_cast<unsigned int>(merged.indices.size());
+    merged.material.push_back(range);
+
+    data.clear();
+    data.push_back(std::move(merged));
+}
+
+void modelProcess(std::vector<ModelData> &data, const ModelLoadOptions &options, const std::string &label)
+{
+    std::size_t indexCount = 0;
+    std::size_t vertexCount = 0;
+    for(const auto& model : data)
+    {
+        indexCount += model.indices.size();
+        vertexCount += model.vertices.size();
+    }
+
+    if(indexCount == 0)
+    {
+        return;
+    }
+
+    /* objects are merged before all other steps, vertices of different parts or materials are never welded since
+     * their part values differ */
+    if(options.mergeObjects && data.size() > 1)
+    {
+        std::size_t ranges = 0;
+        for(const auto& model : data)
+        {
+            ranges += model.material.size();
+        }
+
+        const std::size_t objects = data.size();
+        modelMerge(data, std::filesystem::path(label).stem().string());
+
+        std::cout << "[Model] " << label << ": merged " << objects << " objects with " << data[0].materials.size()
+                  << " materials into one draw range instead of " << ranges << std::endl;
+    }
+
+    /* copies are dropped before the other steps, so they only process the remaining objects */
+    const std::size_t objectCount = data.size();
+    const std::size_t copies = options.instanceObjects ? modelInstance(data) : 0;
+    if(copies > 0)
+    {
+        indexCount = 0;
+        vertexCount = 0;
+        for(const auto& model : data)
+        {
+            indexCount += model.indices.size();
+            vertexCount += model.vertices.size();
+        }
+    }
+
+    if(options.weldVertices)
+    {
+        float missesBefore = detail::vertexCacheMisses(data);
+        std::size_t verticesBefore = vertexCount;
+
+        vertexCount = 0;
+        for(auto& model : data)
+        {
+            meshWeld(model.vertices, model.indices);
+            vertexCount += model.vertices.size();
+        }
+
+        float missesAfter = detail::vertexCacheMisses(data);
+
+        const float savedKB = static_cast<float>((verticesBefore - vertexCount) * sizeof(Vertex)) / 1024.0f;
+        std::cout << "[Model] " << label << ": welded " << verticesBefore << " -> " << vertexCount << " vertices ("
+                  << savedKB << " KB saved), post-transform cache hit rate "
+                  << 100.0f * (1.0f - missesBefore / indexCount) << "% -> " << 100.0f * (1.0f - missesAfter / indexCount) << "%" << std::endl;
+    }
+
+    if(options.buildLods)
+    {
+        std::size_t triangles[MODEL_MAX_LODS] = {};
+        std::size_t modelsWithLods = 0;
+
+        for(auto& model : data)
+        {
+            modelBuildLods(model);
+            for(std::size_t l = 0; l < model.lods.size(); l++)
+            {
+                for(const auto& range : model.lods[l].material)
+                {
+                    triangles[l] += range.count / 3;
+                }
+            }
+            modelsWithLods += model.lods.size() > 1;
+        }
+
+        indexCount = 0;
+        for(const auto& model : data)
+        {
+            indexCount += model.indices.size();
+        }
+
+        std::cout << "[Model] " << label << ": built LODs for " << modelsWithLods << "/" << data.size() << " objects, triangles";
+        for(std::size_t l = 0; l < MODEL_MAX_LODS; l++)
+        {
+            std::cout << (l == 0 ? " " : " / ") << triangles[l];
+        }
+        std::cout << std::endl;
+    }
+
+    /* before the index optimization, which then reorders the triangles of each meshlet */
+    if(options.buildMeshlets)
+    {
+        std::size_t meshlets = 0;
+        std::size_t cones = 0;
+        for(auto& model : data)
+        {
+            modelBuildMeshlets(model, MODEL_MESHLET_TRIANGLES);
+            meshlets += model.meshlets.size();
+            cones += std::count_if(model.meshlets.begin(), model.meshlets.end(), [](const Meshlet& m) { return m.coneCutoff < 1.0f; });
+        }
+
+        std::cout << "[Model] " << label << ": built " << meshlets << " meshlets of up to " << MODEL_MESHLET_TRIANGLES
+                  << " triangles, " << cones << " with a normal cone" << std::endl;
+    }
+
+    if(options.optimizeIndices)
+    {
+        const float triangleCount = static_cast<float>(indexCount / 3);
+        float missesBefore = detail::vertexCacheMisses(data);
+
+        for(auto& model : data)
+        {
+            /* triangles never move between material ranges, so the draw ranges stay intact */
+            for(const auto& [offset, count] : detail::indexRanges(model))
+            {
+                meshOptimizeVertexCache(model.indices.data() + offset, count, model.vertices.size());
+                meshOptimizeOverdraw(model.indices.data() + offset, count, model.vertices);
+            }
+            meshOptimizeVertexFetch(model.vertices, model.indices);
+        }
+
+        vertexCount = 0;
+        for(const auto& model : data)
+        {
+            vertexCount += model.vertices.size();
+        }
+
+        float missesAfter = detail::vertexCacheMisses(data);
+
+        std::cout << "[Model] " << label << ": optimized index order, ACMR " << missesBefore / triangleCount << " -> " << missesAfter / triangleCount
+                  << ", ATVR " << missesBefore / vertexCount << " -> " << missesAfter / vertexCount << std::endl;
+    }
+
+    if(copies > 0)
+    {
+        /* every copy would have had its own processed vertex/index data and one draw per material range */
+        std::size_t savedBytes = 0;
+        std::size_t draws = 0;
+        std::size_t instanced = 0;
+        for(const auto& model : data)
+        {
+            if(model.instances.size() > 1)
+            {
+                const std::size_t extra = model.instances.size() - 1;
+                savedBytes += extra * (model.vertices.size() * sizeof(Vertex) + model.indices.size() * sizeof(unsigned int));
+                draws += extra * model.material.size();
+                instanced++;
             }
         }
+
+        std::cout << "[Model] " << label << ": instanced " << copies + instanced << "/" << objectCount << " objects as "
+                  << instanced << " meshes, " << savedBytes / 1024.0f << " KB saved, " << draws
+                  << " draws collapsed into instanced draws" << std::endl;
+    }
+}
+
+void modelBuildLods(ModelData &model)
+{
+    model.lods.clear();
+
+    ModelLod& full = model.lods.emplace_back();
+    std::vector<IndexRange> ranges;
+    std::size_t triangleCount = 0;
+    for(const auto& material : model.material)
+    {
+        ranges.push_back({material.indexOffset, material.indexCount});
+        triangleCount += material.indexCount / 3;
+    }
+    full.material = ranges;
+
+    if(triangleCount < MODEL_LOD_MIN_TRIANGLES)
+    {
+        return;
+    }
+
+    /* collapses are limited relative to the size of the model */
+    Mesh bounds;
+    meshComputeBounds(bounds, model.vertices.data(), model.vertices.size());
+    const float maxError = MODEL_LOD_MAX_ERROR * bounds.boundsRadius;
+
+    /* every level is simplified from the full detail triangles, so errors do not accumulate along the chain */
+    const std::vector<unsigned int> fullIndices = model.indices;
+    std::vector<unsigned int> indices;
+    std::vector<IndexRange> lodRanges;
+    float ratio = 1.0f;
+
+    while(model.lods.size() < MODEL_MAX_LODS)
+    {
+        ratio *= MODEL_LOD_RATIO;
+        const float error = meshSimplify(model.vertices, fullIndices, ranges, ratio, maxError, indices, lodRanges);
+
+        const std::size_t previousCount = triangleCount;
+        triangleCount = indices.size() / 3;
+        if(static_cast<float>(triangleCount) > MODEL_LOD_MIN_REDUCTION * static_cast<float>(previousCount))
+        {
+            break;
+        }
+
+        ModelLod& lod = model.lods.emplace_back();
+        lod.error = std::max(error, model.lods[model.lods.size() - 2].error);
+        for(auto range : lodRanges)
+        {
+            range.offset += static_cast<unsigned int>(model.indices.size());
+            lod.material.push_back(range);
+        }
+        model.indices.insert(model.indices.end(), indices.begin(), indices.end());
+    }
+}
+
+void modelBuildMeshlets(ModelData &model, unsigned int maxTriangles)
+{
+    if(model.lods.empty())
+    {
+        ModelLod& full = model.lods.emplace_back();
+        for(const auto& material : model.material)
+        {
+            full.material.push_back({material.indexOffset, material.indexCount});
+        }
+    }
+
+    model.meshlets.clear();
+    std::vector<Meshlet> meshlets;
+    std::vector<IndexRange> meshletRanges;
+
+    /* levels are built on their own, so a level never shares a meshlet with another one */
+    for(auto& lod : model.lods)
+    {
+        meshBuildMeshlets(model.vertices, model.indices, lod.material, maxTriangles, meshlets, meshletRanges);
+
+        lod.meshlets.clear();
+        for(auto range : meshletRanges)
+        {
+            range.offset += static_cast<unsigned int>(model.meshlets.size());
+            lod.meshlets.push_back(range);
+        }
+        model.meshlets.insert(model.meshlets.end(), meshlets.begin(), meshlets.end());
+    }
+}
+
+unsigned int modelLodSelect(const Model &model, const Matrix4D &modelMatrix, const Camera &camera, float pixelError)
+{
+    if(model.lods.size() < 2)
+    {
+        return 0;
+    }
+
+    const Vector3D center = modelMatrix * Vector4D(model.mesh.boundsCenter.x, model.mesh.boundsCenter.y, model.mesh.boundsCenter.z, 1.0f);
+    const float scale = std::max({length(Vector3D(modelMatrix[0])), length(Vector3D(modelMatrix[1])), length(Vector3D(modelMatrix[2]))});
+
+    /* distance to the closest point of the bounding sphere, full detail if the camera is inside */
+    const float distance = length(center - cameraPosition(camera)) - model.mesh.boundsRadius * scale;
+    if(distance <= camera.nearPlane)
+    {
+        return 0;
+    }
+
+    const float pixelsPerUnit = cameraPixelScale(camera) / distance;
+    auto projectedError = [&](unsigned int lod) { return model.lods[lod].error * scale * pixelsPerUnit; };
+
+    const unsigned int lodCount = static_cast<unsigned int>(model.lods.size());
+    unsigned int lod = std::min(model.lod, lodCount - 1);
+    while(lod > 0 && projectedError(lod) > pixelError)
+    {
+        lod--;
+    }
+    while(lod + 1 < lodCount && projectedError(lod + 1) < MODEL_LOD_HYSTERESIS * pixelError)
+    {
+        lod++;
+    }
+    return lod;
+}
+
+IndexRange modelLodRange(const Model &model, unsigned int lod, std::size_t material)
+{
+    if(lod < model.lods.size())
+    {
+        return model.lods[lod].material[material];
+    }
+    return {model.material[material].indexOffset, model.material[material].indexCount};
+}
+
+namespace detail
+{
+
+/* reports the GPU memory of the vertex and index buffers against the unpacked layout */
+void reportPacking(const std::vector<Model>& models, const std::string& label)
+{
+    std::size_t packedBytes = 0;
+    std::size_t floatBytes = 0;
+    for(const auto& model : models)
+    {
+        const Mesh& mesh = model.mesh;
+        const std::size_t vertexSize = mesh.format == VertexPacked ? sizeof(PackedVertex) : sizeof(Vertex);
+        packedBytes += mesh.size_vbo * vertexSize + mesh.size_ibo * meshIndexSize(mesh);
+        floatBytes += mesh.size_vbo * sizeof(Vertex) + mesh.size_ibo * sizeof(unsigned int);
+    }
+
+    std::cout << "[Model] " << label << ": packed vertex/index buffers " << floatBytes / 1024.0f << " KB -> "
+              << packedBytes / 1024.0f << " KB" << std::endl;
+}
+
+/* cold start, parses and processes the OBJ file and writes the cache for the next run */
+std::vector<ModelData> modelBuild(const std::string& filepath, const ModelLoadOptions& options)
+{
+    std::vector<std::string> sources;
+    std::vector<ModelData> data = modelParse(filepath, &sources);
+    modelProcess(data, options, filepath);
+    meshCacheWrite(meshCachePath(filepath), meshCacheOptions(options), data, sources);
+    return data;
+}
+
+}
+
+std::vector<Model> modelLoad(const std::string &filepath, const ModelLoadOptions &options)
+{
+    std::vector<Model> models;
+
+    /* warm start, upload straight from the mapped cache */
+    MeshCache cache;
+    if(meshCacheOpen(meshCachePath(filepath), meshCacheOptions(options), cache))
+    {
+        models = meshCacheCreate(cache, options);
+        meshCacheClose(cache);
+    }
+    else
+    {
+        models = modelCreate(detail::modelBuild(filepath, options), options);
+    }
+
+    if(options.packVertices)
+    {
+        detail::reportPacking(models, filepath);
+    }
+    return models;
+}
+
+std::vector<ModelData> modelLoadData(const std::string &filepath, const ModelLoadOptions &options)
+{
+    MeshCache cache;
+    if(meshCacheOpen(meshCachePath(filepath), meshCacheOptions(options), cache))
+    {
+        std::vector<ModelData> data = meshCacheData(cache);
+        meshCacheClose(cache);
+        return data;
+    }
+
+    return detail::modelBuild(filepath, options);
+}
+
+void modelBenchmark(const std::string &filepath, unsigned int iterations)
+{
+    using Clock = std::chrono::steady_clock;
+
+    FileMap file = fileMapOpen(filepath);
+    const double megabytes = static_cast<double>(file.size) / (1024.0 * 1024.0);
+    fileMapClose(file);
+
+    iterations = std::max(iterations, 1u);
+
+    auto measure = [&](auto parse, std::vector<ModelData>& result)
+    {
+        auto start = Clock::now();
+        for(unsigned int i = 0; i < iterations; i++)
+        {
+            result = parse(filepath);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return megabytes * iterations / seconds;
+    };
+
+    std::vector<ModelData> streamResult;
+    std::vector<ModelData> mappedResult;
+    std::vector<ModelData> parallelResult;
+
+    const unsigned int threads = parallelThreadCount();
+
+    double streamRate = measure([](const std::string& path) { return detail::streamParse(path); }, streamResult);
+    double mappedRate = measure([](const std::string& path) { return modelParse(path, nullptr, 1); }, mappedResult);
+    double parallelRate = measure([threads](const std::string& path) { return modelParse(path, nullptr, threads); }, parallelResult);
+
+    bool identical = detail::sameModels(streamResult, mappedResult) && detail::sameModels(streamResult, parallelResult);
+
+    auto row = [](const std::string& label) { return "        " + label + std::string(label.size() < 32 ? 32 - label.size() : 0, ' '); };
+
+    std::cout << "[Model] " << filepath << " (" << megabytes << " MB, " << iterations << " iterations)\n"
+              << row("getline/stringstream:") << streamRate << " MB/s\n"
+              << row("memory mapped, 1 thread:") << mappedRate << " MB/s (x" << mappedRate / streamRate << ")\n"
+              << row("memory mapped, " + std::to_string(threads) + " threads:") << parallelRate << " MB/s (x" << parallelRate / streamRate << ")\n"
+              << row("output identical:") << (identical ? "yes" : "NO") << std::endl;
+}
+
+std::vector<Vertex> verticesLoad(const std::string &filepath)
+{
+    std::vector<ModelData> models = modelParse(filepath);
+
+    if(models.size() > 1)
+    {
+        throw std::runtime_error("[Flag] More than one object not supported");
     }
 
-    return glVertices;
+    return models.empty() ? std::vector<Vertex>() : std::move(models[0].vertices);
 }
 
 void modelDelete(std::vector<Model> &models)
@@ -1,29 +1,319 @@
 #pragma once
 
+#include "camera.h"
+#include "material.h"
 #include "mesh.h"
 
-struct Material
+/* level of detail of a model, its triangles are stored in the index buffer of the model behind the full detail ones */
+struct ModelLod
 {
-    std::string name;
-
-    Vector3D emission;
-    Vector3D ambient;
-    Vector3D diffuse;
-    Vector3D specular;
-    float shininess;
+    float error = 0.0f;                 // largest distance to the full detail surface (object space units)
+    std::vector<IndexRange> material;   // one index range per material of the model
+    float originDistance = 0.0f;        // distance of the closest triangle of this level to the origin
 
-    unsigned int indexOffset;
-    unsigned int indexCount;
+    /* one range of meshlets per material range, indices into Model::meshlets, empty if no meshlets were built (see
+     * ModelLoadOptions::buildMeshlets) */
+    std::vector<IndexRange> meshlets;
 };
 
 struct Model
 {
     Mesh mesh;
     std::string name;
-    std::vector<Material> material;
+
+    /* draw ranges, the material ids index the material table (see material.h) */
+    std::vector<MaterialRange> material;
+
+    /* number of materials the vertices of a merged model select from, consecutive ids starting at the material id of
+     * its range (see VERTEX_PART_COUNT in mesh.h), 0 if the vertices do not select materials */
+    unsigned int vertexMaterialCount = 0;
+
+    /* lods[0] is the full detail model (same ranges as material), empty if no LODs were built */
+    std::vector<ModelLod> lods;
+
+    /* clusters of the material ranges of all levels, in index order within each range (see ModelLod::meshlets) */
+    std::vector<Meshlet> meshlets;
+
+    /* currently selected level (see modelLodSelect(...)) */
+    unsigned int lod = 0;
+
+    /* object space bounding volumes of the full detail triangles of each material range, they also contain the
+     * coarser levels since simplification only collapses onto existing vertices (see modelComputeBounds(...)) */
+    std::vector<MeshBounds> materialBounds;
+
+    /* distance from the object space origin to the closest triangle of any level, a closed model around the origin
+     * completely covers the sphere of this radius (see modelComputeBounds(...), ModelLod::originDistance per level) */
+    float originDistance = 0.0f;
+
+    /* transformations of the copies of the object relative to its vertices, the first one is the identity, empty if
+     * the object has no copies (see ModelLoadOptions::instanceObjects) */
+    std::vector<Matrix4D> instances;
+
+    /* names of the objects merged into this model, indexed by the part index of the vertices (see Vertex::normal),
+     * empty if the model was not merged (see ModelLoadOptions::mergeObjects) */
+    std::vector<std::string> parts;
+
+    /* CPU copy of the full detail triangles for the software occlusion buffer (see occlusion.h), empty unless the model
+     * is large enough (see ModelLoadOptions::occluderRadius) */
+    std::vector<Vector3D> occluderPositions;
+    std::vector<unsigned int> occluderIndices;
+};
+
+/* CPU side data of a model, i.e. everything that is needed to create its mesh */
+struct ModelData
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+
+    /* distinct materials of the object, the material ids of the ranges index this list until the model is created */
+    std::vector<Material> materials;
+    std::vector<MaterialRange> material;
+    std::vector<ModelLod> lods;
+    std::vector<Meshlet> meshlets;      // see Model::meshlets
+    std::vector<Matrix4D> instances;    // see Model::instances
+    std::vector<std::string> parts;     // see Model::parts
 };
 
-std::vector<Model> modelLoad(const std::string &filepath);
+/* optional processing steps applied to the parsed data before the meshes are created */
+struct ModelLoadOptions
+{
+    /* share vertices with identical position, normal and uv instead of one vertex per face corner */
+    bool weldVertices = true;
+
+    /* reorder triangles per material range for the vertex cache and overdraw, then vertices for fetch locality */
+    bool optimizeIndices = true;
+
+    /* simplify each material range into coarser levels of detail (see meshSimplify(...) and modelLodSelect(...)) */
+    bool buildLods = true;
+
+    /* split the ranges of every level into clusters of up to 64 triangles with bounding sphere and normal cone, so
+     * hidden parts of large objects can be culled on the CPU (see modelBuildMeshlets(...) and meshletCull(...)), off by
+     * default as small objects are cheaper to draw as a whole */
+    bool buildMeshlets = false;
+
+    /* upload quantized vertices and 16 bit indices (see PackedVertex), does not change the cached data */
+    bool packVertices = true;
+
+    /* quantize the packed positions of all objects within the bounding box of the whole file instead of per object, so
+     * the meshes share posScale/posOffset and their ranges can be merged into multi draw calls (see drawbatch.h) */
+    bool sharedQuantization = false;
+
+    /* keep a single object for copies of an object that only differ by rotation, uniform scale and translation and
+     * draw them instanced (see modelInstance(...)), off by default as some files look up their parts by name */
+    bool instanceObjects = false;
+
+    /* merge all objects of the file into a single object with one draw range, every vertex keeps the index of its
+     * object as part index and selects its material, so the shader can move the parts with a palette of transforms and
+     * the whole file is one draw (see modelMerge(...)) */
+    bool mergeObjects = false;
+
+    /* also upload a position stream for depth only passes (see Mesh::positionVao), off by default as it adds up to half
+     * of the vertex memory of packed meshes and depth passes can read the interleaved vertices as well */
+    bool positionStream = false;
+
+    /* upload into ranges of a shared arena instead of separate buffers per mesh (see mesharena.h), the vertex format
+     * and position stream of the arena override packVertices and positionStream */
+    MeshArena* arena = nullptr;
+
+    /* keep the full detail triangles of models with at least this bounding radius on the CPU, so they can hide other
+     * objects in the software occlusion buffer (see modelKeepOccluder(...)), 0 keeps none */
+    float occluderRadius = 0.0f;
+};
+
+/**
+ * @brief Loads all objects of an OBJ file (including the materials of its MTL file) and creates a mesh for each of them.
+ * The processed data is stored in a binary cache next to the OBJ file (see meshcache.h), later calls upload directly
+ * from the cache as long as the OBJ/MTL files and the options did not change.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param options Processing steps applied to the parsed data.
+ *
+ * @return One model per object ('o' command) in the file.
+ */
+std::vector<Model> modelLoad(const std::string &filepath, const ModelLoadOptions &options = ModelLoadOptions());
+
+/**
+ * @brief Same as modelLoad(...), but only produces the CPU side data and never touches OpenGL, so it can run on a
+ * worker thread. The meshes are created later with modelCreate(...) or modelMeshCreate(...).
+ *
+ * @param filepath Path to the OBJ file.
+ * @param options Processing steps applied to the parsed data.
+ *
+ * @return CPU side data for each object ('o' command) in the file.
+ */
+std::vector<ModelData> modelLoadData(const std::string &filepath, const ModelLoadOptions &options = ModelLoadOptions());
+
+/**
+ * @brief Parses all objects of an OBJ file (including the materials of its MTL file) without touching OpenGL. The file
+ * is memory mapped and scanned in place, so no allocations happen per line. Large files are split into line aligned
+ * chunks that are parsed on worker threads, index references are resolved in a merge step afterwards.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param sources Optional list that receives the paths of all files that were read (the OBJ file and its MTL files).
+ * @param threadCount Maximum number of parser threads, 0 uses all hardware threads.
+ *
+ * @return CPU side data for each object ('o' command) in the file.
+ */
+std::vector<ModelData> modelParse(const std::string &filepath, std::vector<std::string>* sources = nullptr, unsigned int threadCount = 0);
+
+/**
+ * @brief Applies the processing steps selected in the options to parsed model data and reports their effect on stdout.
+ *
+ * @param data Parsed model data (see modelParse(...)).
+ * @param options Processing steps to apply.
+ * @param label Name used in the report, e.g. the path of the OBJ file.
+ */
+void modelProcess(std::vector<ModelData> &data, const ModelLoadOptions &options, const std::string &label);
+
+/**
+ * @brief Removes objects that are copies of an earlier object up to rotation, uniform scale and translation and adds
+ * their transformations to ModelData::instances of the earlier object. Vertices are compared in file order, so this has
+ * to run on parsed data before vertices are welded or reordered.
+ *
+ * @param data Parsed model data (see modelParse(...)).
+ *
+ * @return Number of removed copies.
+ */
+std::size_t modelInstance(std::vector<ModelData>& data);
+
+/**
+ * @brief Merges all objects into one. The vertices of object i get the part index i and the index of their material in
+ * the distinct materials of all objects (see VERTEX_PART_COUNT), vertices used by several materials are duplicated.
+ * The triangles of all objects form a single range, grouped by material. Triangles outside of material ranges are
+ * dropped, they are never drawn. Has to run on parsed data before levels of detail are built.
+ *
+ * @param data Parsed model data (see modelParse(...)), replaced by a single object.
+ * @param name Name of the merged object, the names of the objects are kept in ModelData::parts.
+ */
+void modelMerge(std::vector<ModelData>& data, const std::string& name);
+
+/**
+ * @brief Creates the meshes for parsed model data.
+ *
+ * @param data Parsed model data (see modelParse(...)).
+ * @param options Load options, selects the vertex format of the meshes.
+ *
+ * @return One model with initialized mesh per entry in data.
+ */
+std::vector<Model> modelCreate(const std::vector<ModelData> &data, const ModelLoadOptions &options = ModelLoadOptions());
+
+/**
+ * @brief Adds the materials of model data to the material table (see materialIntern(...)). Has to run on the OpenGL
+ * thread, as the table is shared by all models.
+ *
+ * @param materials Distinct materials of the object (see ModelData::materials).
+ * @param ranges Material ranges with ids into materials.
+ * @param vertexMaterials The vertices select their material (merged models, see modelMerge(...)), the materials are
+ * added as one block of consecutive ids (see materialInternBlock(...)).
+ *
+ * @return Material ranges with ids into the material table.
+ */
+std::vector<MaterialRange> modelInternMaterials(const std::vector<Material> &materials, const std::vector<MaterialRange> &ranges,
+                                                bool vertexMaterials = false);
+
+/**
+ * @brief Creates the mesh of a model with the vertex format and buffers selected in the load options.
+ *
+ * @param vertices Pointer to the first vertex of the mesh.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to the first index of the mesh.
+ * @param indexCount Number of indices.
+ * @param options Load options.
+ * @param quantizationBox Box the packed positions are quantized in (see ModelLoadOptions::sharedQuantization),
+ * nullptr for the bounding box of the vertices.
+ *
+ * @return Initialized mesh.
+ */
+Mesh modelMeshCreate(const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount, const ModelLoadOptions &options,
+                     const MeshBox* quantizationBox = nullptr);
+
+/**
+ * @brief Computes the bounding volumes of the material ranges of a model (Model::materialBounds) and the distance of
+ * its closest triangle to the origin (Model::originDistance and per level), the bounds of the whole model are computed with its mesh.
+ *
+ * @param model Model with material ranges.
+ * @param vertices Vertices of the model.
+ * @param indices Index buffer of the model.
+ */
+void modelComputeBounds(Model &model, const Vertex* vertices, const unsigned int* indices);
+
+/**
+ * @brief Copies the positions and the full detail triangles of a model to Model::occluderPositions and
+ * Model::occluderIndices if its bounding radius reaches ModelLoadOptions::occluderRadius. Merged models are skipped
+ * since their parts move against each other.
+ *
+ * @param model Model with material ranges and mesh.
+ * @param vertices Vertices of the model.
+ * @param vertexCount Number of vertices.
+ * @param indices Index buffer of the model.
+ * @param options Load options.
+ */
+void modelKeepOccluder(Model &model, const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices,
+                       const ModelLoadOptions &options);
+
+/**
+ * @brief Bounding box of all objects of a file, used to quantize them together (see
+ * ModelLoadOptions::sharedQuantization).
+ *
+ * @param data Objects of the file.
+ *
+ * @return Box containing the vertices of all objects.
+ */
+MeshBox modelBox(const std::vector<ModelData> &data);
+
+/**
+ * @brief Builds the levels of detail of parsed model data. Each level halves the triangle count of the previous one
+ * (simplified from the full detail triangles), the chain ends early when a level does not remove enough triangles.
+ *
+ * @param model Parsed model data, the LOD triangles are appended to its indices.
+ */
+void modelBuildLods(ModelData &model);
+
+/**
+ * @brief Splits the material ranges of every level of detail of parsed model data into meshlets (see
+ * meshBuildMeshlets(...)). The triangles are reordered within their ranges. Creates lods[0] from the material ranges if
+ * no levels of detail were built.
+ *
+ * @param model Parsed model data, receives ModelData::meshlets and ModelLod::meshlets.
+ * @param maxTriangles Largest number of triangles per meshlet.
+ */
+void modelBuildMeshlets(ModelData &model, unsigned int maxTriangles);
+
+/**
+ * @brief Selects the level of detail of a model from the projected size of its simplification error. A coarser level
+ * is only selected once its error is clearly below the threshold, so models near the switching distance do not flicker
+ * between two levels.
+ *
+ * @param model Model with initialized mesh, model.lod is the currently selected level.
+ * @param modelMatrix Transformation of the model into world space.
+ * @param camera Camera the model is seen from (position, fov and image height are used).
+ * @param pixelError Largest allowed error on screen in pixels.
+ *
+ * @return Selected level, an index into model.lods (0 if the model has no LODs).
+ */
+unsigned int modelLodSelect(const Model &model, const Matrix4D &modelMatrix, const Camera &camera, float pixelError);
+
+/**
+ * @brief Index range of a material in a level of detail.
+ *
+ * @param model Model to draw.
+ * @param lod Level of detail (see modelLodSelect(...)).
+ * @param material Index of the material.
+ *
+ * @return Range to draw with meshDraw(...).
+ */
+IndexRange modelLodRange(const Model &model, unsigned int lod, std::size_t material);
+
+/**
+ * @brief Measures the parsing throughput (MB/s) of the memory mapped parser against the previous getline/stringstream
+ * parser and checks that both produce the same data. Results are written to stdout.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param iterations Number of times each parser runs over the file.
+ */
+void modelBenchmark(const std::string &filepath, unsigned int iterations);
+
 std::vector<Vertex> verticesLoad(const std::string &filepath);
 void modelDelete(std::vector<Model>& models);
 void modelDelete(Model& model);
@@ -0,0 +1,361 @@
+#include "occlusion.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace detail
+{
+
+/* edge function a * x + b * y + c, positive on the inner side of the edge from (x0, y0) to (x1, y1) of a counter
+ * clockwise triangle */
+struct Edge
+{
+    float a, b, c;
+};
+
+Edge edgeCreate(float x0, float y0, float x1, float y1)
+{
+    Edge edge;
+    edge.a = y0 - y1;
+    edge.b = x1 - x0;
+    edge.c = -(edge.a * x0 + edge.b * y0);
+    return edge;
+}
+
+/* rasterizes the rows [rowBegin, rowEnd) of a triangle, the buffer keeps the closest depth of every pixel center */
+void rasterizeTriangle(OcclusionBuffer& buffer, const OcclusionTriangle& triangle, unsigned int rowBegin, unsigned int rowEnd)
+{
+    float x[3] = {triangle.x[0], triangle.x[1], triangle.x[2]};
+    float y[3] = {triangle.y[0], triangle.y[1], triangle.y[2]};
+    float z[3] = {triangle.z[0], triangle.z[1], triangle.z[2]};
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(area < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    const float minY = std::max(std::floor(std::min({y[0], y[1], y[2]})), static_cast<float>(rowBegin));
+    const float maxY = std::min(std::ceil(std::max({y[0], y[1], y[2]})), static_cast<float>(rowEnd));
+    const float minX = std::max(std::floor(std::min({x[0], x[1], x[2]})), 0.0f);
+    const float maxX = std::min(std::ceil(std::max({x[0], x[1], x[2]})), static_cast<float>(buffer.width));
+    if(minY >= maxY || minX >= maxX)
+    {
+        return;
+    }
+
+    const Edge edges[3] = {edgeCreate(x[1], y[1], x[2], y[2]), edgeCreate(x[2], y[2], x[0], y[0]), edgeCreate(x[0], y[0], x[1], y[1])};
+
+    /* depth plane z = za * x + zb * y + zc from the barycentric weights of vertex 1 and 2 */
+    const float za = (edges[1].a * (z[1] - z[0]) + edges[2].a * (z[2] - z[0])) / area;
+    const float zb = (edges[1].b * (z[1] - z[0]) + edges[2].b * (z[2] - z[0])) / area;
+    const float zc = z[0] - za * x[0] - zb * y[0];
+
+    /* groups of four pixels start at multiples of 4, so rows never cross the end of the buffer */
+    const unsigned int xBegin = static_cast<unsigned int>(minX) & ~3u;
+    const unsigned int xEnd = static_cast<unsigned int>(maxX);
+
+    for(unsigned int row = static_cast<unsigned int>(minY); row < static_cast<unsigned int>(maxY); row++)
+    {
+        const float py = static_cast<float>(row) + 0.5f;
+        float* depth = buffer.depth.data() + static_cast<std::size_t>(row) * buffer.width;
+
+#ifdef OCCLUSION_SSE
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 e[3], step[3];
+        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(xBegin)), offsets);
+        for(int k = 0; k < 3; k++)
+        {
+            e[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[k].a), px), _mm_set1_ps(edges[k].b * py + edges[k].c));
+            step[k] = _mm_set1_ps(4.0f * edges[k].a);
+        }
+        __m128 pz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+        const __m128 zStep = _mm_set1_ps(4.0f * za);
+        const __m128 uncovered = _mm_set1_ps(std::numeric_limits<float>::max());
+        const __m128 zero = _mm_setzero_ps();
+
+        for(unsigned int column = xBegin; column < xEnd; column += 4)
+        {
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+            if(_mm_movemask_ps(inside) != 0)
+            {
+                const __m128 covered = _mm_or_ps(_mm_and_ps(inside, pz), _mm_andnot_ps(inside, uncovered));
+                _mm_storeu_ps(depth + column, _mm_min_ps(_mm_loadu_ps(depth + column), covered));
+            }
+            for(int k = 0; k < 3; k++)
+            {
+                e[k] = _mm_add_ps(e[k], step[k]);
+            }
+            pz = _mm_add_ps(pz, zStep);
+        }
+#else
+        for(unsigned int column = xBegin; column < xEnd; column++)
+        {
+            const float px = static_cast<float>(column) + 0.5f;
+            bool inside = true;
+            for(int k = 0; k < 3 && inside; k++)
+            {
+                inside = edges[k].a * px + edges[k].b * py + edges[k].c >= 0.0f;
+            }
+            if(inside)
+            {
+                depth[column] = std::min(depth[column], za * px + zb * py + zc);
+            }
+        }
+#endif
+    }
+}
+
+/* farthest depth of every pixel and its 8 neighbours, separated into a horizontal and a vertical pass */
+void dilateFar(const std::vector<float>& depth, unsigned int width, unsigned int height, std::vector<float>& result)
+{
+    std::vector<float> rows(depth.size());
+    for(unsigned int y = 0; y < height; y++)
+    {
+        const float* src = depth.data() + static_cast<std::size_t>(y) * width;
+        float* dst = rows.data() + static_cast<std::size_t>(y) * width;
+        for(unsigned int x = 0; x < width; x++)
+        {
+            dst[x] = std::max({src[x > 0 ? x - 1 : x], src[x], src[x + 1 < width ? x + 1 : x]});
+        }
+    }
+
+    result.resize(depth.size());
+    for(unsigned int y = 0; y < height; y++)
+    {
+        const float* above = rows.data() + static_cast<std::size_t>(y + 1 < height ? y + 1 : y) * width;
+        const float* row = rows.data() + static_cast<std::size_t>(y) * width;
+        const float* below = rows.data() + static_cast<std::size_t>(y > 0 ? y - 1 : y) * width;
+        float* dst = result.data() + static_cast<std::size_t>(y) * width;
+        for(unsigned int x = 0; x < width; x++)
+        {
+            dst[x] = std::max({above[x], row[x], below[x]});
+        }
+    }
+}
+
+}
+
+OcclusionBuffer occlusionBufferCreate(unsigned int width, unsigned int height)
+{
+    if(width == 0 || height == 0 || width % 4 != 0)
+    {
+        throw std::runtime_error("[Occlusion] buffer width has to be a positive multiple of 4");
+    }
+
+    OcclusionBuffer buffer;
+    buffer.width = width;
+    buffer.height = height;
+    buffer.depth.assign(static_cast<std::size_t>(width) * height, 1.0f);
+
+    unsigned int w = width, h = height;
+    while(true)
+    {
+        buffer.levelWidth.push_back(w);
+        buffer.levelHeight.push_back(h);
+        buffer.levels.emplace_back(static_cast<std::size_t>(w) * h, 1.0f);
+        if(w == 1 && h == 1)
+        {
+            break;
+        }
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+    return buffer;
+}
+
+void occlusionClear(OcclusionBuffer &buffer, const Matrix4D &viewProj)
+{
+    buffer.viewProj = viewProj;
+    buffer.triangles.clear();
+}
+
+void occlusionAddOccluder(OcclusionBuffer &buffer, const Matrix4D &transformation, const Vector3D *positions,
+                          const unsigned int *indices, std::size_t indexCount)
+{
+    const Matrix4D modelViewProj = buffer.viewProj * transformation;
+    const float width = static_cast<float>(buffer.width);
+    const float height = static_cast<float>(buffer.height);
+
+    for(std::size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        OcclusionTriangle triangle;
+        bool clipped = false;
+        for(int k = 0; k < 3 && !clipped; k++)
+        {
+            const Vector4D clip = modelViewProj * Vector4D(positions[indices[i + k]], 1.0f);
+
+            /* clipping would only add triangles close to the camera, skipping them is conservative */
+            clipped = clip.w <= 0.0f || clip.z < -clip.w;
+            triangle.x[k] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+            triangle.y[k] = (clip.y / clip.w * 0.5f + 0.5f) * height;
+            triangle.z[k] = clip.z / clip.w;
+        }
+        if(clipped)
+        {
+            continue;
+        }
+
+        const float minX = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+        const float maxX = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+        const float minY = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+        const float maxY = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+        const float minZ = std::min({triangle.z[0], triangle.z[1], triangle.z[2]});
+        if(maxX < 0.0f || minX > width || maxY < 0.0f || minY > height || minZ > 1.0f)
+        {
+            continue;
+        }
+        buffer.triangles.push_back(triangle);
+    }
+    buffer.stats.occluders++;
+}
+
+void occlusionRasterize(OcclusionBuffer &buffer, ParallelPool* pool)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::fill(buffer.depth.begin(), buffer.depth.end(), 1.0f);
+
+    /* every thread owns a band of rows, so no pixel is written by two of them */
+    const unsigned int threads = pool ? static_cast<unsigned int>(pool->workers.size()) + 1 : 1;
+    const unsigned int bands = std::clamp(threads, 1u, buffer.height);
+    const auto rasterizeBand = [&buffer, bands](std::size_t band)
+    {
+        const unsigned int rowBegin = static_cast<unsigned int>(band * buffer.height / bands);
+        const unsigned int rowEnd = static_cast<unsigned int>((band + 1) * buffer.height / bands);
+        for(const auto& triangle : buffer.triangles)
+        {
+            detail::rasterizeTriangle(buffer, triangle, rowBegin, rowEnd);
+        }
+    };
+    if(pool && bands > 1)
+    {
+        parallelPoolRun(*pool, bands, rasterizeBand);
+    }
+    else
+    {
+        rasterizeBand(0);
+    }
+
+    detail::dilateFar(buffer.depth, buffer.width, buffer.height, buffer.levels[0]);
+    for(std::size_t l = 1; l < buffer.levels.size(); l++)
+    {
+        const std::vector<float>& src = buffer.levels[l - 1];
+        const unsigned int srcWidth = buffer.levelWidth[l - 1];
+        const unsigned int srcHeight = buffer.levelHeight[l - 1];
+        std::vector<float>& dst = buffer.levels[l];
+        for(unsigned int y = 0; y < buffer.levelHeight[l]; y++)
+        {
+            const std::size_t y0 = static_cast<std::size_t>(2 * y) * srcWidth;
+            const std::size_t y1 = static_cast<std::size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth;
+            for(unsigned int x = 0; x < buffer.levelWidth[l]; x++)
+            {
+                const unsigned int x0 = 2 * x;
+                const unsigned int x1 = std::min(2 * x + 1, srcWidth - 1);
+                dst[static_cast<std::size_t>(y) * buffer.levelWidth[l] + x] =
+                    std::max({src[y0 + x0], src[y0 + x1], src[y1 + x0], src[y1 + x1]});
+            }
+        }
+    }
+
+    buffer.stats.triangles += buffer.triangles.size();
+    buffer.stats.rasterMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool occlusionTest(OcclusionBuffer &buffer, const Vector3D &center, const Vector3D &extent)
+{
+    if(buffer.triangles.empty())
+    {
+        return true;
+    }
+    buffer.stats.tested++;
+
+    const float width = static_cast<float>(buffer.width);
+    const float height = static_cast<float>(buffer.height);
+    float minX = std::numeric_limits<float>::max(), maxX = -minX;
+    float minY = minX, maxY = -minX;
+    float minZ = minX;
+    for(int c = 0; c < 8; c++)
+    {
+        const Vector3D corner = center + Vector3D(c & 1 ? extent.x : -extent.x, c & 2 ? extent.y : -extent.y,
+                                                  c & 4 ? extent.z : -extent.z);
+        const Vector4D clip = buffer.viewProj * Vector4D(corner, 1.0f);
+        if(clip.w <= 0.0f || clip.z < -clip.w)
+        {
+            return true;
+        }
+
+        const float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+        const float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip.z / clip.w);
+    }
+    if(maxX < 0.0f || minX > width || maxY < 0.0f || minY > height)
+    {
+        return true;
+    }
+
+    unsigned int x0 = static_cast<unsigned int>(std::clamp(minX, 0.0f, width - 1.0f));
+    unsigned int x1 = static_cast<unsigned int>(std::clamp(maxX, 0.0f, width - 1.0f));
+    unsigned int y0 = static_cast<unsigned int>(std::clamp(minY, 0.0f, height - 1.0f));
+    unsigned int y1 = static_cast<unsigned int>(std::clamp(maxY, 0.0f, height - 1.0f));
+
+    /* the level where the rectangle covers at most 2x2 texels */
+    std::size_t level = 0;
+    while(level + 1 < buffer.levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+    {
+        level++;
+        x0 /= 2;
+        x1 /= 2;
+        y0 /= 2;
+        y1 /= 2;
+    }
+
+    const std::vector<float>& farthest = buffer.levels[level];
+    const unsigned int levelWidth = buffer.levelWidth[level];
+    for(unsigned int y = y0; y <= y1; y++)
+    {
+        for(unsigned int x = x0; x <= x1; x++)
+        {
+            if(minZ <= farthest[static_cast<std::size_t>(y) * levelWidth + x])
+            {
+                return true;
+            }
+        }
+    }
+
+    buffer.stats.occluded++;
+    return false;
+}
+
+std::size_t occlusionCull(OcclusionBuffer &buffer, CullList &list)
+{
+    std::size_t hidden = 0;
+    for(std::size_t i = 0; i < list.radius.size() && !buffer.triangles.empty(); i++)
+    {
+        /* boxes grown by the radius */
+        const float r = list.radius[i];
+        if(list.visible[i] && !occlusionTest(buffer, Vector3D(list.centerX[i], list.centerY[i], list.centerZ[i]),
+                                             Vector3D(list.extentX[i] + r, list.extentY[i] + r, list.extentZ[i] + r)))
+        {
+            list.visible[i] = 0;
+            hidden++;
+        }
+    }
+    return hidden;
+}
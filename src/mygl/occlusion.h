@@ -0,0 +1,120 @@
+#pragma once
+
+#include "culling.h"
+
+#include <cstddef>
+#include <vector>
+
+struct ParallelPool;
+
+/* resolution of the software depth buffer, the width has to be a multiple of 4 (one SSE register of pixels) */
+constexpr unsigned int OCCLUSION_WIDTH = 256;
+constexpr unsigned int OCCLUSION_HEIGHT = 128;
+
+/* triangle of an occluder in pixel coordinates of the buffer with its normalized device depth */
+struct OcclusionTriangle
+{
+    float x[3], y[3], z[3];
+};
+
+/* counters of the occlusion buffer, accumulated over the frames since they were reset */
+struct OcclusionStats
+{
+    std::size_t occluders = 0;      // meshes added to the buffer
+    std::size_t triangles = 0;      // triangles rasterized, i.e. in front of the near plane and not outside the buffer
+    std::size_t tested = 0;         // volumes tested against the hierarchy
+    std::size_t occluded = 0;       // volumes hidden by the occluders
+    double rasterMs = 0.0;          // time spent rasterizing and building the hierarchy
+};
+
+/*
+ * Low resolution depth buffer rendered on the CPU from a few large occluders, bounding volumes that are completely
+ * behind them are culled before their draws are recorded.
+ * The occluders are added with occlusionAddOccluder(...), which only transforms and clips their triangles, then
+ * occlusionRasterize(...) splits the rows of the buffer into one band per thread of a pool and each thread rasterizes all
+ * triangles into its band, four pixels at a time with SSE. Depth is the normalized device z in [-1, 1], which is affine
+ * in screen space, so it is interpolated without perspective correction and the buffer keeps the closest depth.
+ * Pixels are only tested at their centers, so the farthest depth of every pixel and its 8 neighbours is taken as the
+ * first level of the hierarchy, i.e. partially covered pixels at the silhouettes of the occluders hide nothing. Every
+ * further level stores the farthest depth of 2x2 texels of the previous one (hierarchical z).
+ * occlusionTest(...) projects the box of a volume, picks the level where its screen rectangle covers at most 2x2 texels
+ * and hides it if its closest depth is behind all of them.
+ */
+struct OcclusionBuffer
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+    Matrix4D viewProj;
+
+    std::vector<OcclusionTriangle> triangles;   // occluder triangles of the frame
+    std::vector<float> depth;                   // width x height, rows from the bottom of the image
+
+    /* levels[0] has the size of the buffer, every further level halves it (rounded up) down to a single texel */
+    std::vector<std::vector<float>> levels;
+    std::vector<unsigned int> levelWidth, levelHeight;
+
+    OcclusionStats stats;
+};
+
+/**
+ * @brief Allocates the depth buffer and the hierarchy.
+ *
+ * @param width Width in pixels, e.g. OCCLUSION_WIDTH.
+ * @param height Height in pixels, e.g. OCCLUSION_HEIGHT.
+ *
+ * @return Buffer without occluders, every volume is visible until occlusionRasterize(...) was called.
+ */
+OcclusionBuffer occlusionBufferCreate(unsigned int width, unsigned int height);
+
+/**
+ * @brief Removes the occluders of the previous frame and sets the view of the next one.
+ *
+ * @param buffer Buffer to clear.
+ * @param viewProj Projection matrix times view matrix of the camera.
+ */
+void occlusionClear(OcclusionBuffer& buffer, const Matrix4D& viewProj);
+
+/**
+ * @brief Transforms the triangles of an occluder into the buffer. Triangles that cross the near plane are skipped and
+ * both sides of every triangle occlude, the occluder has to be opaque and drawn without face culling.
+ *
+ * @param buffer Buffer of the frame (see occlusionClear(...)).
+ * @param transformation Model matrix of the occluder.
+ * @param positions Object space vertex positions.
+ * @param indices Three indices per triangle.
+ * @param indexCount Number of indices.
+ */
+void occlusionAddOccluder(OcclusionBuffer& buffer, const Matrix4D& transformation, const Vector3D* positions,
+                          const unsigned int* indices, std::size_t indexCount);
+
+/**
+ * @brief Rasterizes the occluders of the frame on the threads of a pool and builds the hierarchy.
+ *
+ * @param buffer Buffer with the occluders of the frame.
+ * @param pool Started pool whose workers and calling thread get one band of rows each, nullptr rasterizes all rows on
+ * the calling thread.
+ */
+void occlusionRasterize(OcclusionBuffer& buffer, ParallelPool* pool);
+
+/**
+ * @brief Tests a world space box against the rasterized occluders of the frame.
+ *
+ * @param buffer Rasterized buffer of the frame.
+ * @param center Center of the box.
+ * @param extent Half extents of the box.
+ *
+ * @return False if the box is completely behind the occluders, true if it may be visible or reaches in front of the
+ * near plane.
+ */
+bool occlusionTest(OcclusionBuffer& buffer, const Vector3D& center, const Vector3D& extent);
+
+/**
+ * @brief Hides the volumes of a list that are completely behind the occluders of the buffer. Only clears entries of
+ * CullList::visible, so it is used after frustumCull(...). Volumes that reach in front of the near plane are kept.
+ *
+ * @param buffer Rasterized buffer of the frame.
+ * @param list Volumes to test.
+ *
+ * @return Number of volumes that were visible before and are hidden now.
+ */
+std::size_t occlusionCull(OcclusionBuffer& buffer, CullList& list);
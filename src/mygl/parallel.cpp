@@ -0,0 +1,102 @@
+#include "parallel.h"
+
+namespace detail
+{
+
+/* runs tasks of the current run until none are left */
+void poolRunTasks(ParallelPool& pool)
+{
+    for(std::size_t i = pool.next++; i < pool.taskCount; i = pool.next++)
+    {
+        try
+        {
+            (*pool.task)(i);
+        }
+        catch(...)
+        {
+            pool.errors[i] = std::current_exception();
+        }
+    }
+}
+
+void poolWorker(ParallelPool& pool)
+{
+    std::size_t run = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.wake.wait(lock, [&pool, run] { return pool.stop || pool.run != run; });
+            if(pool.stop)
+            {
+                return;
+            }
+            run = pool.run;
+        }
+
+        poolRunTasks(pool);
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if(--pool.busy == 0)
+        {
+            pool.done.notify_one();
+        }
+    }
+}
+
+}
+
+void parallelPoolStart(ParallelPool &pool, unsigned int threadCount)
+{
+    pool.stop = false;
+    for(unsigned int i = 1; i < threadCount; i++)
+    {
+        pool.workers.emplace_back(detail::poolWorker, std::ref(pool));
+    }
+}
+
+void parallelPoolRun(ParallelPool &pool, std::size_t count, const std::function<void(std::size_t)> &f)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.task = &f;
+        pool.taskCount = count;
+        pool.next = 0;
+        pool.errors.assign(count, nullptr);
+        pool.busy = pool.workers.size();
+        pool.run++;
+    }
+    pool.wake.notify_all();
+
+    detail::poolRunTasks(pool);
+
+    /* the workers still read the task until they are done */
+    {
+        std::unique_lock<std::mutex> lock(pool.mutex);
+        pool.done.wait(lock, [&pool] { return pool.busy == 0; });
+        pool.task = nullptr;
+    }
+
+    for(auto& error : pool.errors)
+    {
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void parallelPoolStop(ParallelPool &pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stop = true;
+    }
+    pool.wake.notify_all();
+
+    for(auto& worker : pool.workers)
+    {
+        worker.join();
+    }
+    pool.workers.clear();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Number of worker threads to use for parallel work.
+ *
+ * @param requested Requested number of threads, 0 selects the number of hardware threads.
+ *
+ * @return Thread count >= 1.
+ */
+inline unsigned int parallelThreadCount(unsigned int requested = 0)
+{
+    if(requested == 0)
+    {
+        requested = std::thread::hardware_concurrency();
+    }
+    return std::max(requested, 1u);
+}
+
+/**
+ * @brief Calls f(i) for every i in [0, count), each call on its own thread (the first one on the calling thread).
+ * Intended for a small number of coarse tasks. If any call throws, the first exception is rethrown after all threads
+ * finished.
+ *
+ * @param count Number of tasks.
+ * @param f Function to execute for each task index.
+ */
+template<typename F>
+void parallelFor(std::size_t count, F f)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> threads;
+    threads.reserve(count > 0 ? count - 1 : 0);
+
+    auto run = [&errors, &f](std::size_t i)
+    {
+        try
+        {
+            f(i);
+        }
+        catch(...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    for(std::size_t i = 1; i < count; i++)
+    {
+        threads.emplace_back(run, i);
+    }
+
+    if(count > 0)
+    {
+        run(0);
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for(auto& error : errors)
+    {
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/*
+ * Worker threads that are kept alive between calls of parallelPoolRun(...), for small tasks that are split up every
+ * frame where starting a thread per task (see parallelFor(...)) would cost about as much as the work itself. The
+ * workers sleep on a condition variable between the runs and take the tasks of a run from a shared counter together
+ * with the calling thread.
+ */
+struct ParallelPool
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stop = false;
+
+    /* current run, only changed while no worker is busy */
+    const std::function<void(std::size_t)>* task = nullptr;
+    std::size_t taskCount = 0;
+    std::atomic<std::size_t> next{0};
+    std::vector<std::exception_ptr> errors;
+    std::size_t run = 0;            // number of the current run, workers wake up when it changes
+    std::size_t busy = 0;           // workers that haven't finished the current run
+};
+
+/**
+ * @brief Starts the worker threads of a pool.
+ *
+ * @param pool Pool to start.
+ * @param threadCount Number of threads working on a run including the calling thread (see parallelThreadCount(...)),
+ * so threadCount - 1 workers are started.
+ */
+void parallelPoolStart(ParallelPool& pool, unsigned int threadCount);
+
+/**
+ * @brief Calls f(i) for every i in [0, count) on the workers of a pool and the calling thread and returns when all calls
+ * finished. If any call throws, the first exception is rethrown.
+ *
+ * @param pool Started pool, a pool without workers runs all tasks on the calling thread.
+ * @param count Number of tasks.
+ * @param f Function to execute for each task index.
+ */
+void parallelPoolRun(ParallelPool& pool, std::size_t count, const std::function<void(std::size_t)>& f);
+
+/**
+ * @brief Stops and joins the worker threads of a pool.
+ *
+ * @param pool Pool to stop.
+ */
+void parallelPoolStop(ParallelPool& pool);
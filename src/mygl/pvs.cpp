@@ -0,0 +1,471 @@
+#include "pvs.h"
+#include "filemap.h"
+#include "occlusion.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace detail
+{
+
+constexpr char PVS_MAGIC[8] = {'V', 'C', 'P', 'V', 'S', '\0', '\0', '\0'};
+constexpr std::uint32_t PVS_VERSION = 3;
+
+/* resolution of the cube map faces rasterized around each sample */
+constexpr unsigned int PVS_BUFFER_SIZE = 64;
+
+struct PvsHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t faceCells;
+    std::uint32_t bandCount;        // band boundaries following the header
+    std::uint32_t padding;
+    std::uint64_t partCount;
+    std::uint64_t words;
+    std::uint64_t key;
+};
+
+/* 64 bit FNV-1a continued from hash */
+std::uint64_t pvsHash(std::uint64_t hash, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(std::size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint64_t pvsKey(const std::vector<PvsPart>& parts, const std::vector<float>& bands, unsigned int faceCells)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    const std::uint32_t layout[] = {PVS_VERSION, faceCells, PVS_BUFFER_SIZE};
+    hash = pvsHash(hash, layout, sizeof(layout));
+    hash = pvsHash(hash, bands.data(), bands.size() * sizeof(float));
+    for(const auto& part : parts)
+    {
+        const Model& model = *part.model;
+        hash = pvsHash(hash, &part.transformation, sizeof(Matrix4D));
+        hash = pvsHash(hash, &model.mesh.boundsBox, sizeof(MeshBox));
+        hash = pvsHash(hash, model.occluderPositions.data(), model.occluderPositions.size() * sizeof(Vector3D));
+        hash = pvsHash(hash, model.occluderIndices.data(), model.occluderIndices.size() * sizeof(unsigned int));
+    }
+    return hash;
+}
+
+/* direction of a point (u, v) in [-1, 1] on a cube map face, the faces are +x, -x, +y, -y, +z, -z */
+Vector3D faceDirection(unsigned int face, float u, float v)
+{
+    const unsigned int axis = face / 2;
+    Vector3D direction;
+    direction[axis] = face % 2 == 0 ? 1.0f : -1.0f;
+    direction[(axis + 1) % 3] = u;
+    direction[(axis + 2) % 3] = v;
+    return normalize(direction);
+}
+
+/* cell of a direction within a band, the face of the largest component, the other two are projected onto it */
+std::size_t directionCell(const Vector3D& direction, unsigned int faceCells)
+{
+    const float a[3] = {std::fabs(direction.x), std::fabs(direction.y), std::fabs(direction.z)};
+    const unsigned int axis = a[0] >= a[1] && a[0] >= a[2] ? 0 : (a[1] >= a[2] ? 1 : 2);
+    const unsigned int face = 2 * axis + (direction[axis] < 0.0f ? 1 : 0);
+    const float major = a[axis];
+
+    const auto cellOf = [faceCells, major](float coordinate)
+    {
+        const int c = static_cast<int>((coordinate / major * 0.5f + 0.5f) * static_cast<float>(faceCells));
+        return static_cast<std::size_t>(std::clamp(c, 0, static_cast<int>(faceCells) - 1));
+    };
+    const std::size_t u = cellOf(direction[(axis + 1) % 3]);
+    const std::size_t v = cellOf(direction[(axis + 2) % 3]);
+
+    return (static_cast<std::size_t>(face) * faceCells + v) * faceCells + u;
+}
+
+/* view looking along one of the cube map directions from a position */
+Matrix4D faceView(const Vector3D& position, unsigned int face)
+{
+    const Vector3D forward = faceDirection(face, 0.0f, 0.0f);
+    const Vector3D worldUp = face / 2 == 1 ? Vector3D(0.0f, 0.0f, 1.0f) : Vector3D(0.0f, 1.0f, 0.0f);
+    const Vector3D right = normalize(cross(forward, worldUp));
+    const Vector3D up = cross(right, forward);
+    return Matrix4D(right.x, right.y, right.z, -dot(right, position),
+                    up.x, up.y, up.z, -dot(up, position),
+                    -forward.x, -forward.y, -forward.z, dot(forward, position),
+                    0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+/* distance of the farthest occluder triangle the ray from the scene origin along direction hits, 0 if it hits none */
+float outermostHit(const std::vector<Vector3D>& triangles, const Vector3D& direction)
+{
+    float farthest = 0.0f;
+    for(std::size_t i = 0; i + 2 < triangles.size(); i += 3)
+    {
+        /* Moeller-Trumbore with the ray starting at the origin */
+        const Vector3D& a = triangles[i];
+        const Vector3D e1 = triangles[i + 1] - a;
+        const Vector3D e2 = triangles[i + 2] - a;
+        const Vector3D p = cross(direction, e2);
+        const float det = dot(e1, p);
+        if(std::fabs(det) < 1e-12f)
+        {
+            continue;
+        }
+        const Vector3D s = -a;
+        const float u = dot(s, p) / det;
+        const Vector3D q = cross(s, e1);
+        const float v = dot(direction, q) / det;
+        const float t = dot(e2, q) / det;
+        if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > farthest)
+        {
+            farthest = t;
+        }
+    }
+    return farthest;
+}
+
+/* marks the parts that are visible in any direction from a position */
+void sampleVisibility(OcclusionBuffer& buffer, const std::vector<PvsPart>& parts, const std::vector<std::size_t>& occluders,
+                      const CullList& boxes, CullList& list, const Matrix4D& projection, const Vector3D& position,
+                      std::uint64_t* visible)
+{
+    for(unsigned int face = 0; face < 6; face++)
+    {
+        const Matrix4D viewProj = projection * faceView(position, face);
+        list = boxes;
+        frustumCull(frustumCreate(viewProj), list);
+
+        /* occluders outside of the face can't hide anything in it */
+        occlusionClear(buffer, viewProj);
+        for(std::size_t o : occluders)
+        {
+            if(list.visible[o])
+            {
+                const Model& model = *parts[o].model;
+                occlusionAddOccluder(buffer, parts[o].transformation, model.occluderPositions.data(), model.occluderIndices.data(),
+                                     model.occluderIndices.size());
+            }
+        }
+        occlusionRasterize(buffer, nullptr);
+        occlusionCull(buffer, list);
+
+        for(std::size_t i = 0; i < parts.size(); i++)
+        {
+            visible[i / 64] |= static_cast<std::uint64_t>(list.visible[i] != 0) << (i % 64);
+        }
+    }
+}
+
+/* reads a cache with the expected layout, anything else in the header (or a corrupt one) is rejected before allocating */
+bool pvsRead(const std::string& cachePath, unsigned int faceCells, std::size_t bandCount, std::size_t partCount, Pvs& pvs)
+{
+    std::ifstream in(cachePath, std::ios::binary);
+    PvsHeader header;
+    if(!in.is_open() || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+       std::memcmp(header.magic, PVS_MAGIC, sizeof(PVS_MAGIC)) != 0 || header.version != PVS_VERSION)
+    {
+        return false;
+    }
+
+    if(header.faceCells != faceCells || header.bandCount != bandCount || header.partCount != partCount ||
+       header.words != (partCount + 63) / 64)
+    {
+        return false;
+    }
+    const std::size_t cells = bandCount > 1 ? (bandCount - 1) * 6 * static_cast<std::size_t>(faceCells) * faceCells : 0;
+
+    std::error_code error;
+    const std::uintmax_t fileSize = std::filesystem::file_size(cachePath, error);
+    if(error || fileSize != sizeof(PvsHeader) + bandCount * sizeof(float) + cells * header.words * sizeof(std::uint64_t))
+    {
+        return false;
+    }
+
+    Pvs result;
+    result.faceCells = header.faceCells;
+    result.partCount = header.partCount;
+    result.words = header.words;
+    result.key = header.key;
+    result.bands.resize(header.bandCount);
+    result.bits.resize(cells * header.words);
+    if(!in.read(reinterpret_cast<char*>(result.bands.data()), result.bands.size() * sizeof(float)) ||
+       !in.read(reinterpret_cast<char*>(result.bits.data()), result.bits.size() * sizeof(std::uint64_t)))
+    {
+        return false;
+    }
+
+    pvs = std::move(result);
+    return true;
+}
+
+void pvsWrite(const std::string& cachePath, const Pvs& pvs)
+{
+    PvsHeader header = {};
+    std::memcpy(header.magic, PVS_MAGIC, sizeof(PVS_MAGIC));
+    header.version = PVS_VERSION;
+    header.faceCells = pvs.faceCells;
+    header.bandCount = static_cast<std::uint32_t>(pvs.bands.size());
+    header.partCount = pvs.partCount;
+    header.words = pvs.words;
+    header.key = pvs.key;
+
+    /* write to a temporary file of this writer first like the mesh cache, a cache is either complete or not there at all */
+    const std::string tmpPath = fileTempPath(cachePath);
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!out.is_open())
+        {
+            std::cerr << "[PVS] Couldn't write cache file at " << cachePath << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(pvs.bands.data()), pvs.bands.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(pvs.bits.data()), pvs.bits.size() * sizeof(std::uint64_t));
+        if(!out)
+        {
+            std::cerr << "[PVS] Couldn't write cache file at " << cachePath << std::endl;
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(tmpPath, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, cachePath, error);
+    if(error)
+    {
+        std::cerr << "[PVS] Couldn't write cache file at " << cachePath << ": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+}
+
+std::string pvsCachePath(const std::string &objFilepath)
+{
+    return std::filesystem::path(objFilepath).replace_extension(".vcpvs").string();
+}
+
+Pvs pvsBake(const std::vector<PvsPart> &parts, const std::vector<float> &bands, unsigned int faceCells, unsigned int threadCount,
+            const std::atomic<bool>* cancel)
+{
+    Pvs pvs;
+    pvs.faceCells = faceCells;
+    pvs.bands = bands;
+    pvs.partCount = parts.size();
+    pvs.words = (parts.size() + 63) / 64;
+    pvs.key = detail::pvsKey(parts, bands, faceCells);
+
+    const std::size_t faceSize = static_cast<std::size_t>(faceCells) * faceCells;
+    const std::size_t cells = bands.size() > 1 ? (bands.size() - 1) * 6 * faceSize : 0;
+    pvs.bits.assign(cells * pvs.words, 0);
+
+    CullList boxes;
+    std::vector<std::size_t> occluders;
+    std::vector<Vector3D> triangles;    // occluder triangles in scene space
+    float sceneRadius = 0.0f;
+    for(std::size_t i = 0; i < parts.size(); i++)
+    {
+        const Model& model = *parts[i].model;
+        cullListAddBox(boxes, parts[i].transformation, model.mesh.boundsBox);
+        if(!model.occluderIndices.empty())
+        {
+            occluders.push_back(i);
+        }
+        for(unsigned int index : model.occluderIndices)
+        {
+            triangles.push_back(Vector3D(parts[i].transformation * Vector4D(model.occluderPositions[index], 1.0f)));
+        }
+        const Vector3D center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+        const Vector3D extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+        sceneRadius = std::max(sceneRadius, length(center) + length(extent));
+    }
+    if(cells == 0 || parts.empty())
+    {
+        return pvs;
+    }
+
+    /* 90 degree faces reaching from close to the sample to beyond the farthest part */
+    const float farPlane = bands.back() + sceneRadius;
+    const Matrix4D projection = Matrix4D::perspective(0.5f * static_cast<float>(M_PI), 1.0f, 1e-3f * farPlane, farPlane);
+
+    /* the samples are the corners of the cells at the band boundaries, every sample is shared by up to 8 cells */
+    const unsigned int faceSamples = faceCells + 1;
+    const std::size_t samples = bands.size() * 6 * faceSamples * faceSamples;
+    std::vector<std::uint64_t> sampled(samples * pvs.words, 0);
+
+    /* a sample below the outermost occluder along its direction may be inside of the geometry and would see nothing
+     * behind the triangles around it, it is skipped and contributes to no cell */
+    const std::size_t directions = 6 * faceSamples * faceSamples;
+    std::vector<float> surface(directions);
+    for(std::size_t d = 0; d < directions; d++)
+    {
+        const unsigned int face = static_cast<unsigned int>(d / (faceSamples * faceSamples));
+        const unsigned int v = static_cast<unsigned int>(d / faceSamples % faceSamples);
+        const unsigned int u = static_cast<unsigned int>(d % faceSamples);
+        surface[d] = detail::outermostHit(triangles, detail::faceDirection(face, 2.0f * u / faceCells - 1.0f, 2.0f * v / faceCells - 1.0f));
+    }
+
+    std::atomic<std::size_t> next{0};
+    parallelFor(std::max(threadCount, 1u), [&](std::size_t)
+    {
+        OcclusionBuffer buffer = occlusionBufferCreate(detail::PVS_BUFFER_SIZE, detail::PVS_BUFFER_SIZE);
+        CullList list;
+
+        for(std::size_t sample = next++; sample < samples; sample = next++)
+        {
+            if(cancel && *cancel)
+            {
+                return;
+            }
+
+            const std::size_t band = sample / (6 * faceSamples * faceSamples);
+            const unsigned int face = static_cast<unsigned int>(sample / (faceSamples * faceSamples) % 6);
+            const unsigned int v = static_cast<unsigned int>(sample / faceSamples % faceSamples);
+            const unsigned int u = static_cast<unsigned int>(sample % faceSamples);
+
+            if(bands[band] <= surface[sample % directions])
+            {
+                continue;
+            }
+
+            const Vector3D direction = detail::faceDirection(face, 2.0f * u / faceCells - 1.0f, 2.0f * v / faceCells - 1.0f);
+            detail::sampleVisibility(buffer, parts, occluders, boxes, list, projection, direction * bands[band],
+                                     sampled.data() + sample * pvs.words);
+        }
+    });
+    if(cancel && *cancel)
+    {
+        return Pvs{};
+    }
+
+    /* a cell sees what is visible from its 4 corners on its inner and outer boundary, cells without a corner above the
+     * occluders are unknown */
+    std::vector<std::uint64_t> corners(pvs.bits.size(), 0);
+    std::vector<char> known(cells, 0);
+    for(std::size_t cell = 0; cell < cells; cell++)
+    {
+        const std::size_t band = cell / (6 * faceSize);
+        const std::size_t face = cell / faceSize % 6;
+        const std::size_t v = cell % faceSize / faceCells;
+        const std::size_t u = cell % faceCells;
+        for(std::size_t corner = 0; corner < 8; corner++)
+        {
+            const std::size_t sample = (((band + corner / 4) * 6 + face) * faceSamples + v + corner / 2 % 2) * faceSamples + u + corner % 2;
+            if(bands[band + corner / 4] <= surface[sample % directions])
+            {
+                continue;
+            }
+            known[cell] = 1;
+            for(std::size_t w = 0; w < pvs.words; w++)
+            {
+                corners[cell * pvs.words + w] |= sampled[sample * pvs.words + w];
+            }
+        }
+    }
+
+    /* positions between the samples of a cell are also close to the samples of its neighbours, in the same and the
+     * adjacent bands. Neighbours beyond the edge of a face are the cells of the adjacent face the direction through
+     * their center falls into. Unknown cells keep every part and add nothing to their neighbours */
+    const std::size_t bandCells = 6 * faceSize;
+    std::vector<std::size_t> neighbours;
+    for(std::size_t faceCell = 0; faceCell < bandCells; faceCell++)
+    {
+        const unsigned int face = static_cast<unsigned int>(faceCell / faceSize);
+        const int v = static_cast<int>(faceCell % faceSize / faceCells);
+        const int u = static_cast<int>(faceCell % faceCells);
+
+        neighbours.clear();
+        for(int dv = -1; dv <= 1; dv++)
+        {
+            for(int du = -1; du <= 1; du++)
+            {
+                const float nu = 2.0f * (static_cast<float>(u + du) + 0.5f) / faceCells - 1.0f;
+                const float nv = 2.0f * (static_cast<float>(v + dv) + 0.5f) / faceCells - 1.0f;
+                neighbours.push_back(detail::directionCell(detail::faceDirection(face, nu, nv), faceCells));
+            }
+        }
+
+        for(std::size_t band = 0; band + 1 < bands.size(); band++)
+        {
+            const std::size_t cell = band * bandCells + faceCell;
+            if(!known[cell])
+            {
+                std::fill_n(pvs.bits.data() + cell * pvs.words, pvs.words, ~std::uint64_t(0));
+                continue;
+            }
+            for(std::size_t neighbourBand = band > 0 ? band - 1 : 0; neighbourBand <= band + 1 && neighbourBand + 1 < bands.size(); neighbourBand++)
+            {
+                for(std::size_t neighbour : neighbours)
+                {
+                    const std::size_t other = neighbourBand * bandCells + neighbour;
+                    for(std::size_t w = 0; w < pvs.words; w++)
+                    {
+                        pvs.bits[cell * pvs.words + w] |= corners[other * pvs.words + w];
+                    }
+                }
+            }
+        }
+    }
+
+    return pvs;
+}
+
+Pvs pvsLoad(const std::string &cachePath, const std::vector<PvsPart> &parts, const std::vector<float> &bands, unsigned int faceCells,
+            unsigned int threadCount, const std::atomic<bool>* cancel)
+{
+    const std::uint64_t key = detail::pvsKey(parts, bands, faceCells);
+
+    Pvs pvs;
+    if(detail::pvsRead(cachePath, faceCells, bands.size(), parts.size(), pvs) && pvs.key == key && pvs.bands == bands)
+    {
+        std::cout << "[PVS] " << cachePath << ": loaded from cache" << std::endl;
+        return pvs;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    pvs = pvsBake(parts, bands, faceCells, threadCount, cancel);
+    if(pvs.bands.empty())
+    {
+        return pvs;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[PVS] " << cachePath << ": baked " << pvs.bits.size() / std::max<std::size_t>(pvs.words, 1) << " cells of "
+              << parts.size() << " parts in " << ms << " ms on " << std::max(threadCount, 1u) << " threads" << std::endl;
+
+    detail::pvsWrite(cachePath, pvs);
+    return pvs;
+}
+
+int pvsCell(const Pvs &pvs, const Vector3D &position)
+{
+    const float distance = length(position);
+    if(pvs.bands.size() < 2 || distance < pvs.bands.front() || distance >= pvs.bands.back())
+    {
+        return -1;
+    }
+    const std::size_t band = static_cast<std::size_t>(std::upper_bound(pvs.bands.begin(), pvs.bands.end(), distance) - pvs.bands.begin()) - 1;
+
+    return static_cast<int>(band * 6 * pvs.faceCells * pvs.faceCells + detail::directionCell(position, pvs.faceCells));
+}
+
+bool pvsVisible(const Pvs &pvs, int cell, std::size_t part)
+{
+    if(cell < 0 || part >= pvs.partCount)
+    {
+        return true;
+    }
+    return (pvs.bits[static_cast<std::size_t>(cell) * pvs.words + part / 64] >> (part % 64)) & 1u;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "model.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* cells per side of each cube map face the view directions are discretized into */
+constexpr unsigned int PVS_FACE_CELLS = 6;
+
+/* part of a rigid scene, the bounding box of its mesh is tested, models with occluder triangles hide other parts (see
+ * ModelLoadOptions::occluderRadius) */
+struct PvsPart
+{
+    const Model* model = nullptr;
+    Matrix4D transformation;    // scene space
+};
+
+/*
+ * Potentially visible sets of the parts of a rigid scene, e.g. the planet in planet space. The camera position is split
+ * into its direction from the scene origin, discretized into the cells of a cube map with faceCells x faceCells cells
+ * per face, and its distance, discretized into bands. Each cell of each band stores a bitset with one bit per part,
+ * parts without their bit are hidden from every camera position within the cell, whatever the view direction.
+ * The sets are baked from sample positions at the corners of the cells on the band boundaries, which are shared by the
+ * neighbouring cells: the occluders are rasterized into the software occlusion buffer (see occlusion.h) once per cube
+ * map face around each sample and the parts are tested against it. A cell gets the parts visible from its 8 corners,
+ * visibility between the samples is covered by adding the sets of the neighbouring cells, across the edges of the
+ * faces and in the adjacent bands.
+ * The sets are approximate, not conservative: a part seen only from positions between the samples, through a gap
+ * narrower than the sample spacing, can be missing from them. Samples below the outermost occluder triangle along
+ * their direction from the origin could be inside of geometry and are skipped, cells with no other corner keep every
+ * part, so the bands can start at the surface of the scene.
+ */
+struct Pvs
+{
+    unsigned int faceCells = 0;
+    std::vector<float> bands;       // distances of the band boundaries, ascending, bands.size() - 1 bands
+    std::size_t partCount = 0;
+    std::size_t words = 0;          // 64 bit words per cell
+    std::vector<std::uint64_t> bits;
+
+    std::uint64_t key = 0;          // hash of the parts, the occluders and the layout the sets were baked from
+};
+
+/**
+ * @brief Path of the PVS cache file that belongs to an OBJ file (same directory and name with extension .vcpvs).
+ *
+ * @param objFilepath Path to the OBJ file.
+ *
+ * @return Path to the cache file.
+ */
+std::string pvsCachePath(const std::string& objFilepath);
+
+/**
+ * @brief Bakes the potentially visible sets of a scene, the cells are distributed over worker threads.
+ *
+ * @param parts Parts of the scene, the bit of a part is its index.
+ * @param bands Band boundaries, at least two ascending distances from the scene origin.
+ * @param faceCells Cells per cube map face side, e.g. PVS_FACE_CELLS.
+ * @param threadCount Number of worker threads (see parallelThreadCount(...)).
+ * @param cancel Stops the bake early when set (optional), e.g. the stop flag of an AssetLoader.
+ *
+ * @return Baked sets, sets without bands if the bake was cancelled.
+ */
+Pvs pvsBake(const std::vector<PvsPart>& parts, const std::vector<float>& bands, unsigned int faceCells, unsigned int threadCount,
+            const std::atomic<bool>* cancel = nullptr);
+
+/**
+ * @brief Loads the sets of a scene from a cache file, or bakes them and writes the cache if it is missing or was baked
+ * from different parts, occluders or layout.
+ *
+ * @param cachePath Path to the cache file (see pvsCachePath(...)).
+ * @param parts Parts of the scene.
+ * @param bands Band boundaries.
+ * @param faceCells Cells per cube map face side.
+ * @param threadCount Number of worker threads for baking.
+ * @param cancel Stops baking early when set (optional), a cancelled bake writes no cache.
+ *
+ * @return Loaded or baked sets, sets without bands if baking was cancelled.
+ */
+Pvs pvsLoad(const std::string& cachePath, const std::vector<PvsPart>& parts, const std::vector<float>& bands, unsigned int faceCells,
+            unsigned int threadCount, const std::atomic<bool>* cancel = nullptr);
+
+/**
+ * @brief Looks up the cell of a camera position in O(1).
+ *
+ * @param pvs Baked sets.
+ * @param position Camera position in scene space.
+ *
+ * @return Index of the cell, -1 if the position is outside of all bands.
+ */
+int pvsCell(const Pvs& pvs, const Vector3D& position);
+
+/**
+ * @brief Checks the bit of a part in the set of a cell.
+ *
+ * @param pvs Baked sets.
+ * @param cell Cell of the camera (see pvsCell(...)), -1 makes every part visible.
+ * @param part Index of the part.
+ *
+ * @return False if the part is hidden from everywhere in the cell.
+ */
+bool pvsVisible(const Pvs& pvs, int cell, std::size_t part);
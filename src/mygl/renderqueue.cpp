@@ -0,0 +1,293 @@
+#include "renderqueue.h"
+#include "material.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace detail
+{
+
+constexpr unsigned int KEY_PASS_SHIFT = 60;
+constexpr unsigned int KEY_PROGRAM_SHIFT = 52;
+constexpr unsigned int KEY_VAO_SHIFT = 44;
+constexpr unsigned int KEY_MATERIAL_SHIFT = 36;
+constexpr unsigned int KEY_DEPTH_SHIFT = 12;
+constexpr std::uint64_t KEY_DEPTH_MAX = (1u << 24) - 1;
+constexpr std::size_t KEY_ID_COUNT = 256;
+
+/* small id of a value for the key, ids are assigned in the order the values first appear */
+template<typename T>
+std::uint64_t keyId(std::vector<T>& ids, T value, const char* what)
+{
+    auto it = std::find(ids.begin(), ids.end(), value);
+    if(it != ids.end())
+    {
+        return static_cast<std::uint64_t>(it - ids.begin());
+    }
+    if(ids.size() == KEY_ID_COUNT)
+    {
+        throw std::runtime_error(std::string("[RenderQueue] more than 256 ") + what + " per frame");
+    }
+    ids.push_back(value);
+    return ids.size() - 1;
+}
+
+/* programs reading only positions are drawn with the position stream of the mesh if it has one */
+GLuint commandVao(const RenderCommand& command)
+{
+    return command.program->positionStream && command.mesh->positionVao != 0 ? command.mesh->positionVao : command.mesh->vao;
+}
+
+eRenderPass entryPass(const RenderQueueEntry& entry)
+{
+    return static_cast<eRenderPass>(entry.key >> KEY_PASS_SHIFT);
+}
+
+/* depth and color writes of a pass, later passes only shade the fragments the depth pass left visible */
+void passState(eRenderPass pass, bool depthPrepass)
+{
+    const bool depthOnly = pass == RenderPassDepth;
+    glColorMask(!depthOnly, !depthOnly, !depthOnly, !depthOnly);
+    glDepthMask(depthOnly || !depthPrepass);
+    glDepthFunc(depthPrepass && !depthOnly ? GL_EQUAL : GL_LESS);
+}
+
+bool sameQuantization(const Mesh& a, const Mesh& b)
+{
+    return a.format == b.format && std::memcmp(&a.posScale, &b.posScale, sizeof(Vector3D)) == 0 &&
+           std::memcmp(&a.posOffset, &b.posOffset, sizeof(Vector3D)) == 0;
+}
+
+/* state that has to be set before drawing next after previous (nullptr for the first draw) */
+struct StateChange
+{
+    bool program = true;
+    bool vao = true;
+    bool material = true;
+    bool matrix = true;
+    bool visibleList = true;
+    bool quantization = true;
+
+    std::size_t count() const
+    {
+        return program + vao + material + matrix + visibleList + quantization;
+    }
+};
+
+StateChange stateChange(const RenderCommand* previous, const RenderCommand& next)
+{
+    StateChange change;
+    if(previous)
+    {
+        change.program = previous->program != next.program;
+        change.vao = commandVao(*previous) != commandVao(next);
+        change.material = previous->materialId != next.materialId;
+        change.matrix = previous->matrix != next.matrix;
+        change.visibleList = previous->visibleList != next.visibleList;
+        change.quantization = change.program || !sameQuantization(*previous->mesh, *next.mesh);
+    }
+    return change;
+}
+
+}
+
+void renderQueueClear(RenderQueue &queue)
+{
+    queue.commands.clear();
+    queue.matrices.clear();
+    queue.entries.clear();
+    queue.programs.clear();
+    queue.vaos.clear();
+}
+
+unsigned int renderQueueMatrix(RenderQueue &queue, const Matrix4D &matrix)
+{
+    queue.matrices.push_back(matrix);
+    return static_cast<unsigned int>(queue.matrices.size() - 1);
+}
+
+void renderQueuePush(RenderQueue &queue, eRenderPass pass, const RenderCommand &command, float depth)
+{
+    if(command.range.count == 0)
+    {
+        return;
+    }
+
+    const std::uint64_t program = detail::keyId(queue.programs, command.program, "programs");
+    const std::uint64_t vao = detail::keyId(queue.vaos, detail::commandVao(command), "VAOs");
+    const std::uint64_t quantizedDepth = static_cast<std::uint64_t>(std::clamp(depth, 0.0f, 1.0f) * detail::KEY_DEPTH_MAX);
+
+    RenderQueueEntry entry;
+    entry.key = static_cast<std::uint64_t>(pass) << detail::KEY_PASS_SHIFT |
+                program << detail::KEY_PROGRAM_SHIFT |
+                vao << detail::KEY_VAO_SHIFT |
+                static_cast<std::uint64_t>(command.materialId & 0xffu) << detail::KEY_MATERIAL_SHIFT |
+                quantizedDepth << detail::KEY_DEPTH_SHIFT;
+    entry.command = static_cast<std::uint32_t>(queue.commands.size());
+
+    queue.commands.push_back(command);
+    queue.entries.push_back(entry);
+}
+
+void renderQueueSort(RenderQueue &queue)
+{
+    std::vector<RenderQueueEntry>& entries = queue.entries;
+    std::vector<RenderQueueEntry>& scratch = queue.scratch;
+    scratch.resize(entries.size());
+
+    /* least significant digit first, 8 bits per pass, stable so earlier digits keep their order */
+    for(unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        std::size_t histogram[256] = {};
+        for(const auto& entry : entries)
+        {
+            histogram[(entry.key >> shift) & 0xffu]++;
+        }
+
+        /* all keys share this digit, the pass would not change the order */
+        if(entries.empty() || histogram[(entries[0].key >> shift) & 0xffu] == entries.size())
+        {
+            continue;
+        }
+
+        std::size_t offset = 0;
+        for(std::size_t& count : histogram)
+        {
+            const std::size_t c = count;
+            count = offset;
+            offset += c;
+        }
+        for(const auto& entry : entries)
+        {
+            scratch[histogram[(entry.key >> shift) & 0xffu]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void renderQueueSubmit(RenderQueue &queue, const Matrix4D& viewProj)
+{
+    transformUpload(queue.transforms, queue.matrices, viewProj);
+
+    RenderQueueStats& stats = queue.stats;
+    stats = RenderQueueStats{};
+    stats.commands = queue.commands.size();
+
+    /* state changes a submission in recorded order would need */
+    for(std::size_t i = 0; i < queue.commands.size(); i++)
+    {
+        stats.unsortedStateChanges += detail::stateChange(i > 0 ? &queue.commands[i - 1] : nullptr, queue.commands[i]).count();
+    }
+
+    DrawBatch& batch = queue.batch;
+    drawBatchClear(batch);
+
+    /* sorted by pass first, so depth commands lead the entries */
+    const bool depthPrepass = !queue.entries.empty() && detail::entryPass(queue.entries.front()) == RenderPassDepth;
+    eRenderPass pass = RenderPassCount;
+
+    const RenderCommand* previous = nullptr;
+    for(const auto& entry : queue.entries)
+    {
+        const RenderCommand& command = queue.commands[entry.command];
+        const detail::StateChange change = detail::stateChange(previous, command);
+        const std::size_t changes = change.count();
+
+        /* identical state, the range joins the pending multi draw */
+        const bool instanced = command.instanceCount > 1 || command.indirectCommand != 0;
+        const bool passChange = detail::entryPass(entry) != pass;
+        stats.depthCommands += detail::entryPass(entry) == RenderPassDepth;
+        if(queue.merge && !instanced && !passChange && changes == 0 && batch.mesh && drawBatchCompatible(batch, *command.mesh))
+        {
+            drawBatchAdd(batch, *command.mesh, command.range);
+            previous = &command;
+            continue;
+        }
+
+        if(batch.mesh)
+        {
+            drawBatchSubmit(batch);
+            drawBatchClear(batch);
+            stats.drawCalls++;
+        }
+
+        if(passChange)
+        {
+            pass = detail::entryPass(entry);
+            detail::passState(pass, depthPrepass);
+        }
+
+        const RenderProgram& program = *command.program;
+        if(change.program)
+        {
+            glUseProgram(program.id);
+            if(program.bind)
+            {
+                program.bind();
+            }
+        }
+        if(change.vao)
+        {
+            glBindVertexArray(detail::commandVao(command));
+        }
+        if(change.material)
+        {
+            materialBind(command.materialId);
+        }
+        if(change.matrix)
+        {
+            transformBind(command.matrix);
+        }
+        if(change.visibleList)
+        {
+            gpuCullBind(command.visibleList);
+        }
+        if(change.quantization)
+        {
+            shaderUniform(program.posScale, command.mesh->posScale);
+            shaderUniform(program.posOffset, command.mesh->posOffset);
+            shaderUniform(program.packedVertex, command.mesh->format == VertexPacked);
+        }
+        stats.stateChanges += changes;
+        previous = &command;
+
+        /* the shaders add gl_InstanceID to the transform id or to the start of the visible list */
+        if(command.indirectCommand != 0)
+        {
+            meshDrawIndirect(*command.mesh, (command.indirectCommand - 1) * sizeof(GpuCullCommand));
+            stats.drawCalls++;
+            stats.indirectDraws++;
+            continue;
+        }
+        if(instanced)
+        {
+            meshDrawInstanced(*command.mesh, command.range.offset, command.range.count, command.instanceCount);
+            stats.drawCalls++;
+            stats.instances += command.instanceCount;
+            continue;
+        }
+
+        drawBatchAdd(batch, *command.mesh, command.range);
+    }
+
+    if(batch.mesh)
+    {
+        drawBatchSubmit(batch);
+        drawBatchClear(batch);
+        stats.drawCalls++;
+    }
+
+    if(depthPrepass)
+    {
+        detail::passState(RenderPassOpaque, false);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void renderQueueDelete(RenderQueue &queue)
+{
+    transformBufferDelete(queue.transforms);
+    queue = RenderQueue{};
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "drawbatch.h"
+#include "gpuculling.h"
+#include "shader.h"
+#include "transform.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* passes of a frame, in submission order */
+enum eRenderPass
+{
+    RenderPassDepth = 0,    // depth only, the opaque pass then tests with GL_EQUAL and does not write depth
+    RenderPassOpaque,
+    RenderPassCount,
+};
+
+/* program of queued draws, the queue sets the per draw uniforms through the handles */
+struct RenderProgram
+{
+    GLuint id = 0;
+
+    UniformHandle posScale, posOffset;
+    UniformHandle packedVertex;     // optional, not every vertex shader decodes packed normals
+
+    /* reads only the position and part attributes, draws use the position stream of their mesh if it has one (see
+     * Mesh::positionVao) */
+    bool positionStream = false;
+
+    /* sets the per frame uniforms of the program after it was bound (optional) */
+    std::function<void()> bind;
+};
+
+/* one draw of the queue, referenced by the sort key */
+struct RenderCommand
+{
+    const RenderProgram* program = nullptr;
+    const Mesh* mesh = nullptr;
+    IndexRange range;
+    unsigned int materialId = 0;
+    unsigned int matrix = 0;        // transform id, index into RenderQueue::matrices (see renderQueueMatrix(...))
+    unsigned int instanceCount = 1; // instances use the consecutive transform ids starting at matrix
+    unsigned int visibleList = 0;   // or read them from the visible list of the GPU culling pass (see gpuCullBind(...))
+
+    /* 1 + index of the indirect draw command with the visible instance count of the list (see gpuCullAddDraw(...)),
+     * replaces range and instanceCount, 0 for direct draws */
+    unsigned int indirectCommand = 0;
+};
+
+/* sort key and index of a command */
+struct RenderQueueEntry
+{
+    std::uint64_t key = 0;
+    std::uint32_t command = 0;
+};
+
+struct RenderQueueStats
+{
+    std::size_t commands = 0;
+    std::size_t drawCalls = 0;
+    std::size_t instances = 0;      // drawn by instanced draw calls
+    std::size_t indirectDraws = 0;  // draw calls with GPU written instance counts, their instances are not counted
+    std::size_t depthCommands = 0;  // of the depth pre-pass
+
+    /* program, VAO, material, model matrix, visible list and quantization changes of the sorted submission and of a submission in
+     * recorded order, the difference is what sorting saved */
+    std::size_t stateChanges = 0;
+    std::size_t unsortedStateChanges = 0;
+};
+
+/*
+ * Records the draws of a frame and submits them sorted by a 64 bit key with as few state changes as possible. From the
+ * most significant bits down the key holds
+ *   pass (4 bits) | program (8 bits) | VAO (8 bits) | material (8 bits) | depth (24 bits) | unused (12 bits)
+ * so draws are grouped by state and ordered front to back within a group. Programs and VAOs get small ids in the
+ * order they are first pushed in a frame. Consecutive draws with identical state are merged into one multi draw call,
+ * draws of more than one instance and indirect draws are submitted on their own with one instanced or indirect draw
+ * call.
+ * The model matrices of a frame are uploaded once into a transform buffer (see transform.h), draws only select their
+ * transform id.
+ * If the frame has draws in RenderPassDepth they only write depth, and the following passes test with GL_EQUAL without
+ * writing depth, so every opaque fragment is shaded at most once. The opaque draws then have to be covered by the depth
+ * pass with identical positions (invariant gl_Position).
+ */
+struct RenderQueue
+{
+    std::vector<RenderCommand> commands;
+    std::vector<Matrix4D> matrices;
+    TransformBuffer transforms;
+
+    std::vector<RenderQueueEntry> entries;
+    std::vector<RenderQueueEntry> scratch;  // radix sort buffer
+
+    /* key ids of the current frame */
+    std::vector<const RenderProgram*> programs;
+    std::vector<GLuint> vaos;
+
+    /* merge draws with identical state into multi draw calls, disable to compare with one call per command */
+    bool merge = true;
+    DrawBatch batch;
+
+    RenderQueueStats stats;     // of the last submission
+};
+
+/**
+ * @brief Removes all commands and matrices, the allocated storage is kept.
+ *
+ * @param queue Queue to clear.
+ */
+void renderQueueClear(RenderQueue& queue);
+
+/**
+ * @brief Stores a model matrix for the commands of the current frame, commands sharing a matrix index are drawn
+ * without selecting it again.
+ *
+ * @param queue Queue of the frame.
+ * @param matrix Model matrix.
+ *
+ * @return Index for RenderCommand::matrix.
+ */
+unsigned int renderQueueMatrix(RenderQueue& queue, const Matrix4D& matrix);
+
+/**
+ * @brief Records a draw.
+ *
+ * @param queue Queue of the frame.
+ * @param pass Pass of the draw.
+ * @param command Draw, program and mesh have to stay valid until the queue is submitted.
+ * @param depth View depth of the draw divided by the far plane, clamped to [0, 1].
+ */
+void renderQueuePush(RenderQueue& queue, eRenderPass pass, const RenderCommand& command, float depth);
+
+/**
+ * @brief Sorts the recorded commands by their keys (radix sort, byte positions shared by all keys are skipped).
+ *
+ * @param queue Queue to sort.
+ */
+void renderQueueSort(RenderQueue& queue);
+
+/**
+ * @brief Uploads the transforms of the frame and draws the sorted commands, state is only set when it changes. Leaves no
+ * program and VAO bound, restores the default depth and color state (GL_LESS, writes enabled) and updates the
+ * statistics of the queue.
+ *
+ * @param queue Sorted queue.
+ * @param viewProj View-projection matrix of the frame, premultiplied into the transforms.
+ */
+void renderQueueSubmit(RenderQueue& queue, const Matrix4D& viewProj);
+
+/**
+ * @brief Deletes the transform buffer of a queue. Has to be called before the OpenGL context is destroyed.
+ *
+ * @param queue Queue to delete.
+ */
+void renderQueueDelete(RenderQueue& queue);
@@ -1,5 +1,6 @@
 #include "shader.h"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -57,6 +58,109 @@ namespace detail
             throw std::runtime_error((std::string("[Shader] ERROR link shaderprogram: \n") + programLog));
         }
     }
+
+    /* locations of all active uniforms outside of uniform blocks, looked up once so setting them needs no GL query */
+    std::vector<ShaderUniformInfo> reflectUniforms(GLuint handle)
+    {
+        GLint count = 0;
+        GLint maxLength = 0;
+        glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<ShaderUniformInfo> uniforms;
+        std::string buffer(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = GL_NONE;
+            glGetActiveUniform(handle, static_cast<GLuint>(i), maxLength, &length, &size, &type, &buffer[0]);
+            std::string name(buffer.data(), static_cast<std::size_t>(length));
+
+            /* members of uniform blocks have no location */
+            GLint location = glGetUniformLocation(handle, name.c_str());
+            if(location < 0)
+            {
+                continue;
+            }
+
+            /* arrays are reported as "name[0]", elements are not guaranteed to have consecutive locations */
+            const std::size_t bracket = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0 ? name.size() - 3 : std::string::npos;
+            if(bracket == std::string::npos)
+            {
+                uniforms.push_back({name, location, type});
+                continue;
+            }
+
+            const std::string base = name.substr(0, bracket);
+            uniforms.push_back({base, location, type});
+            for(GLint e = 0; e < size; e++)
+            {
+                std::string element = base + "[" + std::to_string(e) + "]";
+                uniforms.push_back({element, glGetUniformLocation(handle, element.c_str()), type});
+            }
+        }
+
+        std::sort(uniforms.begin(), uniforms.end(), [](const ShaderUniformInfo& a, const ShaderUniformInfo& b) { return a.name < b.name; });
+        return uniforms;
+    }
+
+    void bindUniformBlocks(GLuint handle)
+    {
+        static const std::pair<const char*, eUniformBinding> blocks[] = {
+            {"MaterialBlock", MaterialBinding},
+            {"FrameData", FrameBinding},
+        };
+
+        for(const auto& [name, binding] : blocks)
+        {
+            GLuint index = glGetUniformBlockIndex(handle, name);
+            if(index != GL_INVALID_INDEX)
+            {
+                glUniformBlockBinding(handle, index, binding);
+            }
+        }
+    }
+
+    /* sampler values are program state, so the program is bound for the assignment and the previous one restored */
+    void bindSamplers(GLuint handle)
+    {
+        static const std::pair<const char*, eTextureUnit> samplers[] = {
+            {"uVisibleTransforms", VisibleTransformUnit},
+            {"uImpostorColor", ImpostorColorUnit},
+            {"uImpostorNormal", ImpostorNormalUnit},
+            {"uTransforms", TransformUnit},
+        };
+
+        GLint previous = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        for(const auto& [name, unit] : samplers)
+        {
+            GLint location = glGetUniformLocation(handle, name);
+            if(location >= 0)
+            {
+                glUseProgram(handle);
+                glUniform1i(location, unit);
+            }
+        }
+        glUseProgram(static_cast<GLuint>(previous));
+    }
+
+    std::string readSource(const std::string& path, const char* kind)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+        {
+            std::cerr << "[Shader] Couldn't open " << kind << " shader file at " << path << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error(std::string("[Shader] Couldn't open ") + kind + " shader file at " + path);
+        }
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
 }
 
 ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
@@ -77,44 +181,84 @@ ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &f
     glAttachShader(program.id, program._fragmentID);
 
     detail::link(program.id);
+    detail::bindUniformBlocks(program.id);
+    detail::bindSamplers(program.id);
+    program.uniforms = detail::reflectUniforms(program.id);
 
     return program;
 }
 
-ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
+ShaderProgram shaderCreateFeedback(const std::string &vertexSource, const std::string &geometrySource, const std::vector<std::string> &varyings)
 {
-    std::ifstream vertexFile(vertexPath);
-    std::ifstream fragmentFile(fragmentPath);
+    ShaderProgram program;
+    program.id = glCreateProgram();
+    program._vertexID = glCreateShader(GL_VERTEX_SHADER);
+    program._geometryID = geometrySource.empty() ? 0 : glCreateShader(GL_GEOMETRY_SHADER);
 
-    if(!vertexFile.is_open())
+    if(!program._vertexID || (!program._geometryID && !geometrySource.empty()) || !program.id)
     {
-        std::cerr << "[Shader] Couldn't open vertex shader file at " << std::endl;
+        std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
         std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't open vertex shader file at " + vertexPath);
+        throw std::runtime_error("[Shader] Couldn't create shader program!");
     }
 
-    if(!fragmentFile.is_open())
+    detail::compile(program._vertexID, vertexSource.c_str(), vertexSource.size());
+    glAttachShader(program.id, program._vertexID);
+
+    /* without a geometry shader the vertex shader outputs are captured */
+    if(program._geometryID)
     {
-        std::cerr << "[Shader] Couldn't open fragment shader file at " << std::endl;
-        std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't open fragment shader file at " + fragmentPath);
+        detail::compile(program._geometryID, geometrySource.c_str(), geometrySource.size());
+        glAttachShader(program.id, program._geometryID);
     }
 
-    std::stringstream vertexSourceBuffer;
-    vertexSourceBuffer << vertexFile.rdbuf();
+    /* the captured outputs are part of the link */
+    std::vector<const char*> names;
+    for(const auto& varying : varyings)
+    {
+        names.push_back(varying.c_str());
+    }
+    glTransformFeedbackVaryings(program.id, static_cast<GLsizei>(names.size()), names.data(), GL_INTERLEAVED_ATTRIBS);
+
+    detail::link(program.id);
+    detail::bindUniformBlocks(program.id);
+    detail::bindSamplers(program.id);
+    program.uniforms = detail::reflectUniforms(program.id);
+
+    return program;
+}
 
-    std::stringstream fragmentSourceBuffer;
-    fragmentSourceBuffer << fragmentFile.rdbuf();
+void shaderSourceLoad(const std::string &vertexPath, const std::string &fragmentPath, std::string &vertexSource, std::string &fragmentSource)
+{
+    vertexSource = detail::readSource(vertexPath, "vertex");
+    fragmentSource = detail::readSource(fragmentPath, "fragment");
+}
+
+ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
+{
+    std::string vertexSource, fragmentSource;
+    shaderSourceLoad(vertexPath, fragmentPath, vertexSource, fragmentSource);
 
-    return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str());
+    return shaderCreate(vertexSource, fragmentSource);
+}
+
+ShaderProgram shaderLoadFeedback(const std::string &vertexPath, const std::string &geometryPath, const std::vector<std::string> &varyings)
+{
+    return shaderCreateFeedback(detail::readSource(vertexPath, "vertex"),
+                                geometryPath.empty() ? std::string() : detail::readSource(geometryPath, "geometry"), varyings);
 }
 
 void shaderDelete(const ShaderProgram &program)
 {
-    glDetachShader(program.id, program._vertexID);
-    glDetachShader(program.id, program._fragmentID);
-    glDeleteShader(program._vertexID);
-    glDeleteShader(program._fragmentID);
+    /* programs have a fragment or a geometry shader, vertex only transform feedback programs neither */
+    for(GLuint shader : {program._vertexID, program._fragmentID, program._geometryID})
+    {
+        if(shader != 0)
+        {
+            glDetachShader(program.id, shader);
+            glDeleteShader(shader);
+        }
+    }
 
     glDeleteProgram(program.id);
 }
@@ -123,55 +267,106 @@ void shaderDelete(const ShaderProgram &program)
 namespace detail
 {
 
-GLint uniform_index(ShaderProgram &shader, const std::string &name)
+#ifndef NDEBUG
+void checkType(const UniformHandle& handle, GLenum type)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    /* int covers bool and sampler uniforms as well */
+    const bool matches = type == GL_INT ? handle.type != GL_FLOAT && handle.type != GL_FLOAT_VEC2 && handle.type != GL_FLOAT_VEC3 &&
+                                          handle.type != GL_FLOAT_VEC4 && handle.type != GL_FLOAT_MAT4
+                                        : handle.type == type;
+    if(handle.location >= 0 && !matches)
+    {
+        throw std::runtime_error("[Shader] uniform type mismatch at location " + std::to_string(handle.location));
+    }
+}
+#else
+inline void checkType(const UniformHandle&, GLenum) {}
+#endif
+
+}
+
+UniformHandle shaderUniformHandle(const ShaderProgram &shader, const std::string &name, bool required)
+{
+    auto it = std::lower_bound(shader.uniforms.begin(), shader.uniforms.end(), name,
+                               [](const ShaderUniformInfo& info, const std::string& n) { return info.name < n; });
+    if(it != shader.uniforms.end() && it->name == name)
+    {
+        return {it->location, it->type};
+    }
+
+#ifndef NDEBUG
+    if(required)
     {
         std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
         std::cerr.flush();
         throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
     }
+#endif
+    return {};
+}
+
+void shaderUniform(const UniformHandle &handle, const Matrix4D &value)
+{
+    detail::checkType(handle, GL_FLOAT_MAT4);
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, value.ptr());
+}
+
+void shaderUniform(const UniformHandle &handle, const Vector2D &value)
+{
+    detail::checkType(handle, GL_FLOAT_VEC2);
+    glUniform2f(handle.location, value.x, value.y);
+}
+
+void shaderUniform(const UniformHandle &handle, const Vector3D &value)
+{
+    detail::checkType(handle, GL_FLOAT_VEC3);
+    glUniform3f(handle.location, value.x, value.y, value.z);
+}
 
-    return index;
+void shaderUniform(const UniformHandle &handle, const Vector4D &value)
+{
+    detail::checkType(handle, GL_FLOAT_VEC4);
+    glUniform4f(handle.location, value.x, value.y, value.z, value.w);
 }
 
+void shaderUniform(const UniformHandle &handle, int value)
+{
+    detail::checkType(handle, GL_INT);
+    glUniform1i(handle.location, value);
+}
+
+void shaderUniform(const UniformHandle &handle, float value)
+{
+    detail::checkType(handle, GL_FLOAT);
+    glUniform1f(handle.location, value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D& value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniformMatrix4fv(index, 1, GL_FALSE, value.ptr());
+    shaderUniform(shaderUniformHandle(shader, name), value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, int value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1i(index, value);
+    shaderUniform(shaderUniformHandle(shader, name), value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector2D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform2f(index, vec.x, vec.y);
+    shaderUniform(shaderUniformHandle(shader, name), vec);
 }
 
-
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector3D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform3f(index, vec.x, vec.y, vec.z);
+    shaderUniform(shaderUniformHandle(shader, name), vec);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector4D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-
-    glUniform4f(index, vec.x, vec.y, vec.z, vec.w);
+    shaderUniform(shaderUniformHandle(shader, name), vec);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, float value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1f(index, value);
+    shaderUniform(shaderUniformHandle(shader, name), value);
 }
@@ -2,11 +2,48 @@
 
 #include "base.h"
 
+#include <vector>
+
+/* binding points of the uniform blocks shared by all programs, blocks are bound by name when a program is linked */
+enum eUniformBinding
+{
+    MaterialBinding = 0,   // MaterialBlock (see material.h)
+    FrameBinding = 1,      // FrameData (see frame.h)
+};
+
+/* texture units of the samplers shared by all programs, samplers are assigned by name when a program is linked */
+enum eTextureUnit
+{
+    VisibleTransformUnit = 0,  // uVisibleTransforms, visible lists of the GPU culling pass (see gpuculling.h)
+    ImpostorColorUnit = 1,     // uImpostorColor, pre-rendered views of distant models (see impostor.h)
+    ImpostorNormalUnit = 2,    // uImpostorNormal
+    TransformUnit = 3,         // uTransforms, transforms of the frame (see transform.h)
+};
+
+/* active uniform of a linked program, arrays get one entry per element ("a[0]", "a[1]", ...) and one for their name */
+struct ShaderUniformInfo
+{
+    std::string name;
+    GLint location = -1;
+    GLenum type = GL_NONE;
+};
+
 struct ShaderProgram
 {
     GLuint id = 0;
     GLuint _vertexID = 0;
     GLuint _fragmentID = 0;
+    GLuint _geometryID = 0;     // only transform feedback programs (see shaderCreateFeedback(...))
+
+    /* filled by reflection when the program is linked, sorted by name */
+    std::vector<ShaderUniformInfo> uniforms;
+};
+
+/* precomputed location of a uniform (see shaderUniformHandle(...)), setting it involves no name lookup */
+struct UniformHandle
+{
+    GLint location = -1;    // -1 if the program has no such uniform, values set for it are ignored by OpenGL
+    GLenum type = GL_NONE;  // checked against the value type in debug builds
 };
 
 /**
@@ -20,7 +57,19 @@ struct ShaderProgram
 ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath);
 
 /**
- * @brief Function to compile and link vertex and fragement source strings to create shader program.
+ * @brief Reads the vertex and fragment shader source files without touching OpenGL, e.g. to read them on a worker
+ * thread and compile them later with shaderCreate(...).
+ *
+ * @param vertexPath Path to vertex shader file.
+ * @param fragmentPath Path to fragment shader file.
+ * @param vertexSource Receives the vertex shader code.
+ * @param fragmentSource Receives the fragment shader code.
+ */
+void shaderSourceLoad(const std::string& vertexPath, const std::string& fragmentPath, std::string& vertexSource, std::string& fragmentSource);
+
+/**
+ * @brief Function to compile and link vertex and fragement source strings to create shader program. The active
+ * uniforms are reflected into ShaderProgram::uniforms and the shared uniform blocks are bound (see eUniformBinding).
  *
  * @param vertexSource Source string holding vertex shader code.
  * @param fragmentSource Source string holding fragment shader code.
@@ -29,6 +78,32 @@ ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragm
  */
 ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource);
 
+/**
+ * @brief Function to compile and link a transform feedback program from vertex and geometry shader source strings. The
+ * program has no fragment shader, the outputs of the geometry shader are captured interleaved into the buffer bound to
+ * GL_TRANSFORM_FEEDBACK_BUFFER index 0, draws with it should enable GL_RASTERIZER_DISCARD. Uniforms are reflected and
+ * blocks are bound as in shaderCreate(...).
+ *
+ * @param vertexSource Source string holding vertex shader code.
+ * @param geometrySource Source string holding geometry shader code, empty to capture the vertex shader outputs.
+ * @param varyings Names of the captured geometry (or vertex) shader outputs, in buffer order.
+ *
+ * @return Shader program.
+ */
+ShaderProgram shaderCreateFeedback(const std::string& vertexSource, const std::string& geometrySource, const std::vector<std::string>& varyings);
+
+/**
+ * @brief Function to load vertex and geometry shader from file and create a transform feedback program (see
+ * shaderCreateFeedback(...)).
+ *
+ * @param vertexPath Path to vertex shader file.
+ * @param geometryPath Path to geometry shader file, empty to capture the vertex shader outputs.
+ * @param varyings Names of the captured geometry (or vertex) shader outputs, in buffer order.
+ *
+ * @return Shader program.
+ */
+ShaderProgram shaderLoadFeedback(const std::string& vertexPath, const std::string& geometryPath, const std::vector<std::string>& varyings);
+
 /**
  * @brief Cleanup and delete all shaders of a shader program and the program itself. Has to be called for each shader program after it is not used anymore.
  *
@@ -89,3 +164,64 @@ void shaderUniform(ShaderProgram& shader, const std::string& name, int value);
  * @param value Value to which the uniform should be set.
  */
 void shaderUniform(ShaderProgram& shader, const std::string& name, float value);
+
+/**
+ * @brief Looks up the location of a uniform in the reflection table of a program. In debug builds a missing uniform
+ * throws like setting it by name does.
+ *
+ * @param shader Linked shader program.
+ * @param name Uniform name, array elements as "name[i]".
+ * @param required If false, a missing uniform returns an invalid handle without the debug check (for uniforms only
+ * some programs use).
+ *
+ * @return Handle for the shaderUniform(...) overloads below.
+ */
+UniformHandle shaderUniformHandle(const ShaderProgram& shader, const std::string& name, bool required = true);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, const Matrix4D& value);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, const Vector2D& value);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, const Vector3D& value);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, const Vector4D& value);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle (int, bool and sampler uniforms).
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, int value);
+
+/**
+ * @brief Function to set uniform of the currently used shader program by handle.
+ *
+ * @param handle Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& handle, float value);
@@ -0,0 +1,76 @@
+#include "transform.h"
+#include "mesh.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(sizeof(TransformGpu) == TRANSFORM_TEXELS * 4 * sizeof(float), "TransformGpu has to consist of whole RGBA32F texels");
+
+void transformUpload(TransformBuffer &buffer, const std::vector<Matrix4D> &models, const Matrix4D &viewProj)
+{
+    if(buffer.buffer == 0)
+    {
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        buffer.maxCount = static_cast<std::size_t>(maxTexels) / TRANSFORM_TEXELS;
+
+        glGenBuffers(1, &buffer.buffer);
+        glGenTextures(1, &buffer.texture);
+    }
+
+    std::size_t count = models.size();
+    if(count > buffer.maxCount)
+    {
+        std::cerr << "[Transform] " << count << " transforms in a frame, only " << buffer.maxCount << " are drawn" << std::endl;
+        count = buffer.maxCount;
+    }
+
+    /* the texture keeps referring to the buffer object when its storage is reallocated */
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer.buffer);
+    if(count > buffer.capacity || buffer.capacity == 0)
+    {
+        buffer.capacity = std::max({buffer.capacity * 2, count, std::size_t(256)});
+        glBufferData(GL_TEXTURE_BUFFER, buffer.capacity * sizeof(TransformGpu), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    buffer.data.resize(count);
+    for(std::size_t i = 0; i < count; i++)
+    {
+        TransformGpu& transform = buffer.data[i];
+        transform.model = models[i];
+        transform.modelViewProj = viewProj * models[i];
+
+        /* column c of the transposed inverse is row c of the inverse */
+        const Matrix4D inv = inverse(models[i]);
+        for(int c = 0; c < 3; c++)
+        {
+            for(int r = 0; r < 3; r++)
+            {
+                transform.normal[c][r] = inv(c, r);
+            }
+            transform.normal[c][3] = 0.0f;
+        }
+    }
+
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, buffer.data.size() * sizeof(TransformGpu), buffer.data.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + TransformUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, buffer.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer.buffer);
+    glCheckError();
+}
+
+void transformBind(unsigned int id)
+{
+    /* the attribute array is never enabled, so every vertex reads this constant */
+    glVertexAttribI1ui(eDataIdx::TransformId, id);
+}
+
+void transformBufferDelete(TransformBuffer &buffer)
+{
+    glDeleteBuffers(1, &buffer.buffer);
+    glDeleteTextures(1, &buffer.texture);
+    buffer = TransformBuffer{};
+}
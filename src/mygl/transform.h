@@ -0,0 +1,59 @@
+#pragma once
+
+#include "base.h"
+
+#include <vector>
+
+/* layout of a transform in the transform texture buffer (see default.vert), matrices are column major, every column is
+ * one RGBA32F texel */
+struct TransformGpu
+{
+    Matrix4D model;
+    float normal[3][4];     // mat3 transpose(inverse(model)), every column padded to a vec4
+    Matrix4D modelViewProj;
+};
+
+/* texels of a transform in the texture buffer */
+constexpr unsigned int TRANSFORM_TEXELS = sizeof(TransformGpu) / (4 * sizeof(float));
+
+/*
+ * Model matrices of the objects drawn in a frame together with their normal matrix and model-view-projection matrix,
+ * computed once per object on the CPU instead of per vertex in the shaders. They are stored in a buffer that grows with
+ * the number of transforms and is read through a texture buffer bound to TransformUnit, OpenGL 3.3 guarantees at least
+ * 65536 texels for it, uniform blocks only 16 KB. The shaders index it with the transform id of the draw, passed as the
+ * constant vertex attribute eDataIdx::TransformId (see transformBind(...)), plus gl_InstanceID for instanced draws.
+ */
+struct TransformBuffer
+{
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    std::size_t capacity = 0;       // transforms the buffer holds
+    std::size_t maxCount = 0;       // transforms the texture buffer can address (GL_MAX_TEXTURE_BUFFER_SIZE)
+    std::vector<TransformGpu> data;
+};
+
+/**
+ * @brief Computes the derived matrices of the transforms and uploads them with a single glBufferSubData call, then binds
+ * the texture buffer to TransformUnit (see eTextureUnit in shader.h). The buffer is created on first use and grows when
+ * a frame has more transforms than it holds. Transforms beyond the size limit of texture buffers are dropped with a
+ * warning, the objects using them are not drawn.
+ *
+ * @param buffer Transform buffer.
+ * @param models Model matrices, their indices are the transform ids.
+ * @param viewProj View-projection matrix of the frame.
+ */
+void transformUpload(TransformBuffer& buffer, const std::vector<Matrix4D>& models, const Matrix4D& viewProj);
+
+/**
+ * @brief Selects the transform of the following draw calls.
+ *
+ * @param id Index of the model matrix passed to transformUpload(...).
+ */
+void transformBind(unsigned int id);
+
+/**
+ * @brief Deletes the buffer and its texture.
+ *
+ * @param buffer Transform buffer to delete.
+ */
+void transformBufferDelete(TransformBuffer& buffer);
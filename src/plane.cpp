@@ -1,81 +1,125 @@
 #include "plane.h"
 
+#include <algorithm>
+#include <map>
 #include <stdexcept>
 
-Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePath)
+namespace detail
 {
-    std::vector<Model> models = modelLoad(planeFilePath);
 
-    if(models.size() != Plane::ePart::PART_COUNT)
+/* slot of a part in Plane::partTransformations, -1 for unknown names */
+int planePartSlot(const std::string& name)
+{
+    static const std::map<std::string, int> slots = {
+        {"Propeller", Plane::PROPELLER},
+        {"WheelCarcassBack", Plane::WHEEL_CARCASS_BACK},
+        {"TyreBack", Plane::TYRE_BACK},
+        {"WheelCarcassLeft", Plane::WHEEL_CARCASS_LEFT},
+        {"TyreLeft", Plane::TYRE_LEFT},
+        {"WheelCarcassRight", Plane::WHEEL_CARCASS_RIGHT},
+        {"TyreRight", Plane::TYRE_RIGHT},
+        {"Hull", Plane::HULL},
+        {"StrobeRudder", Plane::STROBE_RUDDER},
+        {"LightLeftWing", Plane::LIGHT_LEFT_WING},
+        {"StrobeRightWing", Plane::STROBE_RIGHT_WING},
+        {"StrobeLeftWing", Plane::STROBE_LEFT_WING},
+        {"LightRightWing", Plane::LIGHT_RIGHT_WING},
+        {"LightRudder", Plane::LIGHT_RUDDER},
+        {"FlagConnector", Plane::FLAG_CONNECTOR},
+    };
+
+    auto it = slots.find(name);
+    return it == slots.end() ? -1 : it->second;
+}
+
+}
+
+ModelLoadOptions planeLoadOptions(MeshArena* arena)
+{
+    ModelLoadOptions options;
+    options.arena = arena;
+    options.mergeObjects = true;
+    return options;
+}
+
+Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePath, MeshArena* arena)
+{
+    std::vector<Model> models = modelLoad(planeFilePath, planeLoadOptions(arena));
+
+    if(models.size() != 1)
     {
-        throw std::runtime_error("[Plane] number of parts do not match!" + std::to_string(models.size()));
+        throw std::runtime_error("[Plane] expected one merged model, got " + std::to_string(models.size()));
     }
 
+    Plane plane = planeCreate();
+    planeSetModel(plane, models[0]);
+
+    plane.flag = flagCreate(flagFilePath);
+
+    return plane;
+}
+
+Plane planeCreate()
+{
     Plane plane;
-    plane.partModel.resize(models.size());
     plane.partTransformations.resize(Plane::ePart::PART_COUNT, Matrix4D::identity());
     plane.position = plane.basePosition;
+    plane.flagModelMatrix = flagPlane::trans;
 
-    for(const auto& obj : models)
+    return plane;
+}
+
+void planeSetModel(Plane &plane, const Model &obj)
+{
+    if(obj.parts.size() != Plane::ePart::PART_COUNT)
     {
-        if(obj.name == "Propeller")plane.partModel[Plane::PROPELLER] = obj;
-        else if(obj.name == "WheelCarcassBack") plane.partModel[Plane::WHEEL_CARCASS_BACK] = obj;
-        else if(obj.name == "TyreBack") plane.partModel[Plane::TYRE_BACK] = obj;
-        else if(obj.name == "WheelCarcassLeft") plane.partModel[Plane::WHEEL_CARCASS_LEFT] = obj;
-        else if(obj.name == "TyreLeft") plane.partModel[Plane::TYRE_LEFT] = obj;
-        else if(obj.name == "WheelCarcassRight") plane.partModel[Plane::WHEEL_CARCASS_RIGHT] = obj;
-        else if(obj.name == "TyreRight") plane.partModel[Plane::TYRE_RIGHT] = obj;
-        else if(obj.name == "Hull") plane.partModel[Plane::HULL] = obj;
-        else if(obj.name == "StrobeRudder")
-        {
-            plane.partModel[Plane::STROBE_RUDDER] = obj;
-            plane.emissionColors[Plane::STROBE_RUDDER] = obj.material[0].emission;
-        }
-        else if(obj.name == "LightLeftWing") 
-        {
-            plane.partModel[Plane::LIGHT_LEFT_WING] = obj;
-            plane.emissionColors[Plane::LIGHT_LEFT_WING] = obj.material[0].emission;
-        }
-        else if(obj.name == "StrobeRightWing")
-        {
-            plane.partModel[Plane::STROBE_RIGHT_WING] = obj;
-            plane.emissionColors[Plane::STROBE_RIGHT_WING] = obj.material[0].emission;
-        }
-        else if(obj.name == "StrobeLeftWing")
-        {
-            plane.partModel[Plane::STROBE_LEFT_WING] = obj;
-            plane.emissionColors[Plane::STROBE_LEFT_WING] = obj.material[0].emission;
-        }
-        else if(obj.name == "LightRightWing")
+        throw std::runtime_error("[Plane] number of parts do not match!" + std::to_string(obj.parts.size()));
+    }
+
+    plane.partSlots.clear();
+    for(const auto& name : obj.parts)
+    {
+        const int slot = detail::planePartSlot(name);
+        if(slot < 0)
         {
-            plane.partModel[Plane::LIGHT_RIGHT_WING] = obj;
-            plane.emissionColors[Plane::LIGHT_RIGHT_WING] = obj.material[0].emission;
+            throw std::runtime_error("[Plane] unkown part name: " + name);
         }
-        else if(obj.name == "LightRudder")
+        plane.partSlots.push_back(slot);
+    }
+    plane.model = obj;
+
+    /* the lights and strobes are the only emissive materials of the plane, the vertices of the merged plane select
+     * them relative to the material id of its range */
+    plane.emissionColors.clear();
+    for(const auto& range : obj.material)
+    {
+        for(unsigned int id = range.materialId; id < range.materialId + std::max(obj.vertexMaterialCount, 1u); id++)
         {
-            plane.partModel[Plane::LIGHT_RUDDER] = obj;
-            plane.emissionColors[Plane::LIGHT_RUDDER] = obj.material[0].emission;
+            const Vector3D emission = materialGet(id).emission;
+            if(emission.x != 0.0f || emission.y != 0.0f || emission.z != 0.0f)
+            {
+                plane.emissionColors[id] = emission;
+            }
         }
-        else if(obj.name == "FlagConnector") plane.partModel[Plane::FLAG_CONNECTOR] = obj;
-        else throw std::runtime_error("[Plane] unkown part name: " + obj.name);
     }
+}
 
-    plane.flag = flagCreate(flagFilePath);
-    plane.flagModelMatrix = flagPlane::trans;
-
-    return plane;
+void planePalette(const Plane &plane, std::vector<Matrix4D> &palette)
+{
+    palette.clear();
+    for(int slot : plane.partSlots)
+    {
+        palette.push_back(plane.transformation * plane.partTransformations[slot]);
+    }
 }
 
 void planeDelete(Plane &plane)
 {
     flagDelete(plane.flag);
+    modelDelete(plane.model);
 
-    for (auto &model : plane.partModel)
-    {
-        modelDelete(model);
-    }
-
-    plane.partModel.clear();
+    plane.model = Model{};
+    plane.partSlots.clear();
     plane.partTransformations.clear();
 }
 
@@ -178,9 +222,8 @@ float getSpeedFov(Plane &plane)
 
 void setEmission(Plane &plane, bool emission)
 {
-    for (auto const& [part, color] : plane.emissionColors)
+    for (auto const& [materialId, color] : plane.emissionColors)
     {
-        /* assumes that each part in emission color has only one material */
-        plane.partModel[part].material[0].emission = emission ? color : Vector3D(0.0f, 0.0f, 0.0f);
+        materialSetEmission(materialId, emission ? color : Vector3D(0.0f, 0.0f, 0.0f));
     }
 }
@@ -47,9 +47,14 @@ struct Plane
         PART_COUNT
     };
 
+    /* all parts merged into one model, the vertices of each part select their transform from a palette of
+     * PART_COUNT consecutive transforms (see planePalette(...)) */
+    Model model;
+    std::vector<int> partSlots;     // ePart of each part index of the model
     std::vector<Matrix4D> partTransformations;
-    std::vector<Model> partModel;
-    std::map<int, Vector3D> emissionColors;
+
+    /* emission of the light materials, keyed by material id */
+    std::map<unsigned int, Vector3D> emissionColors;
 
     Matrix4D transformation = Matrix4D::identity();
     Matrix4D rotation = Matrix4D::identity();
@@ -79,12 +84,47 @@ struct Plane
     Matrix4D flagNegativeRotation = Matrix4D::identity();
 };
 
+/**
+ * @brief Load options of the plane model, its parts are merged into a single mesh (see ModelLoadOptions::mergeObjects).
+ *
+ * @param arena Optional arena the mesh is allocated from.
+ *
+ * @return Options for modelLoad(...) or loaderRequestModel(...).
+ */
+ModelLoadOptions planeLoadOptions(MeshArena* arena = nullptr);
+
 /**
  * @brief Initializes the plane object with all its meshes, including its flag object. Initially, the plane is placed according to 'basePosition'.
  *
+ * @param arena Optional arena the plane mesh is allocated from (the flag always gets its own buffers).
+ *
  * @return Initialized plane.
  */
-Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePath);
+Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePath, MeshArena* arena = nullptr);
+
+/**
+ * @brief Initializes the plane object without any meshes, the model is set with planeSetModel(...) and the flag is
+ * set with flagCreate(...) later, e.g. when they are loaded asynchronously (see loader.h).
+ *
+ * @return Plane without model.
+ */
+Plane planeCreate();
+
+/**
+ * @brief Sets the merged model of the plane, the slot of each part is selected by its name.
+ *
+ * @param plane Plane to set the model of.
+ * @param obj Model loaded with planeLoadOptions(...) with initialized mesh.
+ */
+void planeSetModel(Plane& plane, const Model& obj);
+
+/**
+ * @brief Transforms of the parts in part index order of the plane model, drawn with the first one as transform id.
+ *
+ * @param plane Plane with model.
+ * @param palette Receives one world transform per part (cleared first).
+ */
+void planePalette(const Plane& plane, std::vector<Matrix4D>& palette);
 
 /**
  * @brief Deletes the given plane object, including its flag object.
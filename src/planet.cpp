@@ -2,36 +2,63 @@
 
 #include <stdexcept>
 
-Planet planetLoad(const std::string &planetFilePath)
+Planet planetLoad(const std::string &planetFilePath, MeshArena* arena)
 {
 
     Planet planet;
-    planet.partModel = modelLoad(planetFilePath);
+    ModelLoadOptions options;
+    options.arena = arena;
+    std::vector<Model> models = modelLoad(planetFilePath, options);
 
-    if(planet.partModel.size() <= 0)
+    if(models.size() <= 0)
     {
         throw std::runtime_error("[Planet] no parts could be loaded!");
     }
 
-    /* go over all models and find all materials with emission -> save in emission color map */
-    for (size_t part_id = 0u; part_id < planet.partModel.size(); part_id++)
+    for (const auto& model : models)
     {
-        std::map<int, Vector3D> emissionColors;
-        for (auto mat_id=0u; mat_id < planet.partModel[part_id].material.size(); mat_id++)
-        {
-            auto mat = planet.partModel[part_id].material[mat_id];
-            if (mat.emission.x > 0.0f || mat.emission.y > 0.0f || mat.emission.z > 0.0f)
-            {
-                emissionColors[mat_id] = planet.partModel[part_id].material[mat_id].emission;
-            }
-        }
-        if (emissionColors.size() > 0)
+        planetAddPart(planet, model);
+    }
+
+    return planet;
+}
+
+void planetAddPart(Planet &planet, const Model &model)
+{
+    const size_t part_id = planet.partModel.size();
+    planet.partModel.push_back(model);
+
+    /* the body is the part around the planet center */
+    if (length(model.mesh.boundsCenter) < model.mesh.boundsRadius)
+    {
+        planet.bodyPart = static_cast<int>(part_id);
+    }
+
+    /* find all materials with emission -> save in emission color map */
+    std::map<int, Vector3D> emissionColors;
+    for (auto mat_id=0u; mat_id < model.material.size(); mat_id++)
+    {
+        const Material& mat = materialGet(model.material[mat_id].materialId);
+        if (mat.emission.x > 0.0f || mat.emission.y > 0.0f || mat.emission.z > 0.0f)
         {
-            planet.emissionColors[part_id] = emissionColors;
+            emissionColors[mat_id] = mat.emission;
         }
     }
+    if (emissionColors.size() > 0)
+    {
+        planet.emissionColors[part_id] = emissionColors;
+    }
+}
+
+float planetOccluderRadius(const Planet &planet)
+{
+    if (planet.bodyPart < 0)
+    {
+        return 0.0f;
+    }
 
-    return planet;
+    const Model& body = planet.partModel[planet.bodyPart];
+    return body.lod < body.lods.size() ? body.lods[body.lod].originDistance : body.originDistance;
 }
 
 void planetDelete(Planet &planet)
@@ -42,6 +69,7 @@ void planetDelete(Planet &planet)
     }
 
     planet.partModel.clear();
+    planet.bodyPart = -1;
 }
 
 void planetRotate(Planet &planet, Vector3D rotationVec, float planeSpeed, float dt)
@@ -61,7 +89,7 @@ void setEmisson(Planet &planet, bool emission)
         for (auto &mat_pair : emission_colors) {
             int mat_id = mat_pair.first;
             Vector3D color = mat_pair.second;
-            planet.partModel[part_id].material[mat_id].emission = emission ? color : Vector3D(0.0, 0.0, 0.0);
+            materialSetEmission(planet.partModel[part_id].material[mat_id].materialId, emission ? color : Vector3D(0.0, 0.0, 0.0));
         }
     }
 }
@@ -14,14 +14,37 @@ struct Planet
     Matrix4D rotation = Matrix4D::identity();
 
     Vector3D position = {0.0, 0.0, 0.0};
+
+    /* index of the part around the planet center, -1 until it is loaded (see planetOccluderRadius(...)) */
+    int bodyPart = -1;
 };
 
 /**
  * @brief Initializes the planet object with all its meshes.
  *
+ * @param arena Optional arena the meshes are allocated from.
+ *
  * @return Initialized planet.
  */
-Planet planetLoad(const std::string &planetFilePath);
+Planet planetLoad(const std::string &planetFilePath, MeshArena* arena = nullptr);
+
+/**
+ * @brief Adds a part to the planet, e.g. when the parts are loaded asynchronously (see loader.h).
+ *
+ * @param planet Planet to extend.
+ * @param model Model of the part with initialized mesh.
+ */
+void planetAddPart(Planet &planet, const Model &model);
+
+/**
+ * @brief Radius of a sphere around the planet position that is completely covered by the planet body at its currently
+ * selected level of detail, everything behind this sphere is hidden (see horizonCull(...)).
+ *
+ * @param planet Planet with loaded parts.
+ *
+ * @return Occluder radius in planet space, 0 if the body is not loaded yet.
+ */
+float planetOccluderRadius(const Planet &planet);
 
 /**
  * @brief Deletes the given planet object.
@@ -1,15 +1,24 @@
 #version 330 core
 
+/* std140 layout of MaterialGpu in material.h */
 struct Material
 {
-    vec3 diffuse;
+    vec4 diffuse;
+    vec4 emission;
+    vec4 ambient;
+    vec4 specular;   // w is the shininess
 };
 
-out vec4 FragColor;
+layout(std140) uniform MaterialBlock
+{
+    Material uMaterials[256];   // MATERIAL_MAX_COUNT
+};
 
-uniform Material uMaterial;
+flat in uint tMaterialId;
+
+out vec4 FragColor;
 
 void main(void)
 {
-    FragColor = vec4(uMaterial.diffuse, 1.0);
+    FragColor = vec4(uMaterials[tMaterialId].diffuse.rgb, 1.0);
 }
@@ -0,0 +1,69 @@
+#version 330 core
+/* GPU culling pass (see gpuculling.h), one point per candidate, rasterization is discarded */
+
+layout(location = 0) in vec4 aSphere;       // world space center and radius
+layout(location = 1) in uint aTransformId;  // written to the visible list if the sphere is visible
+
+/* frustum planes (see Frustum in culling.h) */
+uniform vec4 uPlanes[6];
+
+/* sphere hiding everything behind its horizon (see horizonCull in culling.h), a radius of 0 disables the test */
+uniform vec3 uViewPosition;
+uniform vec4 uOccluder;
+
+/* pixel scale of the camera and smallest diameter in pixels (see contributionCull in culling.h), 0 disables the test */
+uniform vec2 uContribution;
+
+flat out uint vTransformId;
+flat out int vVisible;
+
+bool insideFrustum(vec3 center, float radius)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        if (dot(uPlanes[p].xyz, center) + uPlanes[p].w + radius < 0.0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool behindHorizon(vec3 center, float radius)
+{
+    vec3 toOccluder = uOccluder.xyz - uViewPosition;
+    float distance = length(toOccluder);
+    if (uOccluder.w <= 0.0 || distance <= uOccluder.w)
+    {
+        return false;
+    }
+
+    /* half angle of the horizon cone and distance of the horizon plane from the camera along its axis */
+    vec3 axis = toOccluder / distance;
+    float coneAngle = asin(uOccluder.w / distance);
+    float horizon = (distance * distance - uOccluder.w * uOccluder.w) / distance;
+
+    vec3 toVolume = center - uViewPosition;
+    float volumeDistance = length(toVolume);
+    float along = dot(toVolume, axis);
+    if (volumeDistance <= radius || along - radius < horizon)
+    {
+        return false;
+    }
+
+    float angle = acos(clamp(along / volumeDistance, -1.0, 1.0));
+    return angle + asin(radius / volumeDistance) <= coneAngle;
+}
+
+bool belowContribution(vec3 center, float radius)
+{
+    float distance = length(center - uViewPosition);
+    return distance > radius && 2.0 * radius * uContribution.x < uContribution.y * distance;
+}
+
+void main(void)
+{
+    vTransformId = aTransformId;
+    vVisible = insideFrustum(aSphere.xyz, aSphere.w) && !behindHorizon(aSphere.xyz, aSphere.w) &&
+               !belowContribution(aSphere.xyz, aSphere.w) ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#version 330 core
+/* writes the indirect draw commands of the culled groups (see gpuCullCommands in gpuculling.h), one point per command,
+ * rasterization is discarded and the outputs are captured by transform feedback */
+
+layout(location = 0) in uvec2 aRange;       // index count and first index in the index buffer
+layout(location = 1) in int aBaseVertex;
+layout(location = 2) in uvec2 aGroup;       // first entry and candidates of the group in the visible list
+
+/* visible lists of the culling pass (see gpuCull in gpuculling.h) */
+uniform usamplerBuffer uVisibleTransforms;
+const uint HIDDEN_INSTANCE = 0xffffffffu;  // GPU_CULL_HIDDEN
+
+/* DrawElementsIndirectCommand, see GpuCullCommand */
+flat out uint tCount;
+flat out uint tInstanceCount;
+flat out uint tFirstIndex;
+flat out int tBaseVertex;
+flat out uint tBaseInstance;
+
+void main(void)
+{
+    /* the visible transform ids lead the range of the group, the first hidden entry is found by bisection */
+    uint low = 0u;
+    uint high = aGroup.y;
+    while (low < high)
+    {
+        uint middle = (low + high) / 2u;
+        if (texelFetch(uVisibleTransforms, int(aGroup.x + middle)).r == HIDDEN_INSTANCE)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1u;
+        }
+    }
+
+    tCount = aRange.x;
+    tInstanceCount = low;
+    tFirstIndex = aRange.y;
+    tBaseVertex = aBaseVertex;
+    tBaseInstance = 0u;
+}
@@ -3,17 +3,87 @@
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aUV;
+layout(location = 3) in uint aMaterialId;   // constant per draw, merged models add the material of the vertex (see materialBind in material.h)
+layout(location = 4) in uint aTransformId;  // constant per draw, instances add gl_InstanceID (see transformBind in transform.h)
+layout(location = 5) in float aPart;        // part value of merged models (see VERTEX_PART_COUNT in mesh.h)
+layout(location = 6) in uint aVisibleList;  // constant per draw, 1 + first entry of the instances in uVisibleTransforms or 0 (see gpuCullBind in gpuculling.h)
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+/* per frame data shared by all programs (see FrameDataGpu in frame.h) */
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPosition;
+    float uTime;
+};
+
+/* per object transforms of the frame, TRANSFORM_TEXELS texels each (see TransformGpu in transform.h) */
+struct Transform
+{
+    mat4 model;
+    mat3 normal;          // transpose(inverse(model))
+    mat4 modelViewProj;
+};
+
+uniform samplerBuffer uTransforms;
+
+Transform transformFetch(uint id)
+{
+    int texel = int(id) * 11;
+    Transform transform;
+    transform.model = mat4(texelFetch(uTransforms, texel), texelFetch(uTransforms, texel + 1),
+                           texelFetch(uTransforms, texel + 2), texelFetch(uTransforms, texel + 3));
+    transform.normal = mat3(texelFetch(uTransforms, texel + 4).xyz, texelFetch(uTransforms, texel + 5).xyz,
+                            texelFetch(uTransforms, texel + 6).xyz);
+    transform.modelViewProj = mat4(texelFetch(uTransforms, texel + 7), texelFetch(uTransforms, texel + 8),
+                                   texelFetch(uTransforms, texel + 9), texelFetch(uTransforms, texel + 10));
+    return transform;
+}
+
+/* transform ids of the instances that passed the GPU culling pass, the indirect draws of a group cover only those */
+uniform usamplerBuffer uVisibleTransforms;
+
+/* the part of merged models offsets the transform id into a palette, their material offsets the material id */
+const uint PART_COUNT = 256u;  // VERTEX_PART_COUNT
+
+uint transformId()
+{
+    uint instance = aVisibleList == 0u ? aTransformId + uint(gl_InstanceID)
+                                       : texelFetch(uVisibleTransforms, int(aVisibleList) - 1 + gl_InstanceID).r;
+    return instance + uint(aPart) % PART_COUNT;
+}
+
+/* decoding of packed vertices (see PackedVertex in mesh.h), identity/false for float vertices */
+uniform vec3 uPosScale;
+uniform vec3 uPosOffset;
+uniform bool uPackedVertex;
+
+/* identical to the depth pre-pass (see depth.vert), the color pass tests with GL_EQUAL */
+invariant gl_Position;
 
 out vec3 tNormal;
 out vec3 tFragPos;
+flat out uint tMaterialId;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
 void main(void)
 {
-    gl_Position = uProj * uView * uModel * vec4(aPosition, 1.0);
-    tFragPos = vec3(uModel * vec4(aPosition, 1.0));
-    tNormal = normalize(mat3(transpose(inverse(uModel))) * aNormal);
+    vec3 position = aPosition * uPosScale + uPosOffset;
+    vec3 normal = uPackedVertex ? octDecode(aNormal.xy / 32767.0) : aNormal;
+
+    Transform transform = transformFetch(transformId());
+    gl_Position = transform.modelViewProj * vec4(position, 1.0);
+    tFragPos = vec3(transform.model * vec4(position, 1.0));
+    tNormal = normalize(transform.normal * normal);
+    tMaterialId = aMaterialId + uint(aPart) / PART_COUNT;
 }
@@ -0,0 +1,6 @@
+#version 330 core
+/* depth pre-pass, color writes are disabled and depth is written by the fixed function */
+
+void main(void)
+{
+}
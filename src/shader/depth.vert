@@ -0,0 +1,44 @@
+#version 330 core
+/* depth pre-pass, reads only the position stream (see Mesh::positionVao in mesh.h) */
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 4) in uint aTransformId;  // constant per draw, instances add gl_InstanceID (see transformBind in transform.h)
+layout(location = 5) in float aPart;        // part value of merged models (see VERTEX_PART_COUNT in mesh.h)
+layout(location = 6) in uint aVisibleList;  // constant per draw, 1 + first entry of the instances in uVisibleTransforms or 0 (see gpuCullBind in gpuculling.h)
+
+/* per object transforms of the frame, TRANSFORM_TEXELS texels each (see TransformGpu in transform.h), only the
+ * model-view-projection matrix is read here */
+uniform samplerBuffer uTransforms;
+
+mat4 modelViewProjFetch(uint id)
+{
+    int texel = int(id) * 11 + 7;
+    return mat4(texelFetch(uTransforms, texel), texelFetch(uTransforms, texel + 1), texelFetch(uTransforms, texel + 2),
+                texelFetch(uTransforms, texel + 3));
+}
+
+/* transform ids of the instances that passed the GPU culling pass, the indirect draws of a group cover only those */
+uniform usamplerBuffer uVisibleTransforms;
+
+/* the part of merged models offsets the transform id into a palette, the material above it is not needed here */
+const uint PART_COUNT = 256u;  // VERTEX_PART_COUNT
+
+uint transformId()
+{
+    uint instance = aVisibleList == 0u ? aTransformId + uint(gl_InstanceID)
+                                       : texelFetch(uVisibleTransforms, int(aVisibleList) - 1 + gl_InstanceID).r;
+    return instance + uint(aPart) % PART_COUNT;
+}
+
+/* decoding of packed positions (see PackedVertex in mesh.h), identity for float vertices */
+uniform vec3 uPosScale;
+uniform vec3 uPosOffset;
+
+/* the color pass tests with GL_EQUAL, so the position has to be computed exactly as in default.vert */
+invariant gl_Position;
+
+void main(void)
+{
+    vec3 position = aPosition * uPosScale + uPosOffset;
+    gl_Position = modelViewProjFetch(transformId()) * vec4(position, 1.0);
+}
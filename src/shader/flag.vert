@@ -6,10 +6,41 @@
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aUV;
+layout(location = 3) in uint aMaterialId;   // constant per draw (see materialBind in material.h)
+layout(location = 4) in uint aTransformId;  // constant per draw, instances add gl_InstanceID (see transformBind in transform.h)
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+/* per frame data shared by all programs (see FrameDataGpu in frame.h) */
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPosition;
+    float uTime;
+};
+
+/* per object transforms of the frame, TRANSFORM_TEXELS texels each (see TransformGpu in transform.h) */
+struct Transform
+{
+    mat4 model;
+    mat3 normal;          // transpose(inverse(model))
+    mat4 modelViewProj;
+};
+
+uniform samplerBuffer uTransforms;
+
+Transform transformFetch(uint id)
+{
+    int texel = int(id) * 11;
+    Transform transform;
+    transform.model = mat4(texelFetch(uTransforms, texel), texelFetch(uTransforms, texel + 1),
+                           texelFetch(uTransforms, texel + 2), texelFetch(uTransforms, texel + 3));
+    transform.normal = mat3(texelFetch(uTransforms, texel + 4).xyz, texelFetch(uTransforms, texel + 5).xyz,
+                            texelFetch(uTransforms, texel + 6).xyz);
+    transform.modelViewProj = mat4(texelFetch(uTransforms, texel + 7), texelFetch(uTransforms, texel + 8),
+                                   texelFetch(uTransforms, texel + 9), texelFetch(uTransforms, texel + 10));
+    return transform;
+}
 
 uniform float amplitudes[3];
 uniform float phases[3];      // == phi
@@ -18,8 +49,16 @@ uniform vec2 directions[3];
 uniform float zPosMin;
 uniform float accumTime; // is updated within the main program!
 
+/* decoding of packed positions (see PackedVertex in mesh.h), the normal is recalculated from the displacement */
+uniform vec3 uPosScale;
+uniform vec3 uPosOffset;
+
+/* identical to the depth pre-pass (see depth.vert), the color pass tests with GL_EQUAL */
+invariant gl_Position;
+
 out vec3 tNormal;
 out vec3 tFragPos;
+flat out uint tMaterialId;
 
 
 float getDisplacement(vec2 pos) {
@@ -27,7 +66,7 @@ float getDisplacement(vec2 pos) {
     for (int i = 0; i < 3; i++) {
         displacement += amplitudes[i] * sin(dot(directions[i], pos) * frequencies[i] + accumTime * phases[i]);
     }
-    return displacement * (aPosition.z / zPosMin);
+    return displacement * (pos.y / zPosMin); // in the 2D pos, y equals z
 }
 
 // -------- Gives the partial derivative of the H(p, t) function w.r.t. y if (deriveY == true), otherwise w.r.t. z -------- //
@@ -51,20 +90,23 @@ void main(void)
 {
     // Calculate the partial derivatives of H(p, t) with respect to y and z
     vec2 partialDeriv;
-    vec3 modifiedPos = aPosition;
+    vec3 position = aPosition * uPosScale + uPosOffset;
+    vec3 modifiedPos = position;
 
-    modifiedPos.x += getDisplacement(aPosition.yz); // Displacement on x-axis
+    modifiedPos.x += getDisplacement(position.yz); // Displacement on x-axis
 
-    float partialDerivY = getPartialDerivative(true, aPosition.yz, accumTime);
-    float partialDerivZ = getPartialDerivative(false, aPosition.yz, accumTime);
+    float partialDerivY = getPartialDerivative(true, position.yz, accumTime);
+    float partialDerivZ = getPartialDerivative(false, position.yz, accumTime);
 
     // New normals which consider the displacement of the flag
     vec3 normal = normalize(cross(vec3(partialDerivY, 1.0f, 0.0f), vec3(partialDerivZ, 0.0f, 1.0f)));
 
 
-    gl_Position = uProj * uView * uModel * vec4(modifiedPos, 1.0);
-    tFragPos = vec3(uModel * vec4(modifiedPos, 1.0));
+    Transform transform = transformFetch(aTransformId + uint(gl_InstanceID));
+    gl_Position = transform.modelViewProj * vec4(modifiedPos, 1.0);
+    tFragPos = vec3(transform.model * vec4(modifiedPos, 1.0));
 
-    tNormal = normalize(mat3(transpose(inverse(uModel))) * normal);
+    tNormal = normalize(transform.normal * normal);
+    tMaterialId = aMaterialId;
 }
 
@@ -0,0 +1,33 @@
+#version 330 core
+
+/* pre-rendered views, color and normal are premultiplied by the coverage in alpha (see impostor.h) */
+uniform sampler2DArray uImpostorColor;
+uniform sampler2DArray uImpostorNormal;
+
+/* output of normal.frag instead of color.frag */
+uniform bool uNormals;
+
+in vec3 tUV;
+flat in mat3 tNormalMatrix;
+
+out vec4 FragColor;
+
+void main(void)
+{
+    vec4 color = texture(uImpostorColor, tUV);
+    if (color.a < 0.5)
+    {
+        discard;
+    }
+
+    if (uNormals)
+    {
+        vec4 encoded = texture(uImpostorNormal, tUV);
+        vec3 normal = normalize(tNormalMatrix * (encoded.rgb / encoded.a * 2.0 - 1.0));
+        FragColor = vec4((normal + vec3(1.0, 1.0, 1.0)) * 0.5, 1.0);
+    }
+    else
+    {
+        FragColor = vec4(color.rgb / color.a, 1.0);
+    }
+}
@@ -0,0 +1,87 @@
+#version 330 core
+/* quads of distant instances textured with the closest pre-rendered view of their model (see impostor.h) */
+
+layout(location = 0) in vec3 aCenter;       // bounding sphere center in object space
+layout(location = 1) in vec3 aCorner;       // corner of the quad in [-1, 1] and sphere radius
+layout(location = 2) in vec2 aLayer;        // layer of the model in the atlas
+layout(location = 4) in uint aTransformId;  // constant per draw, instances add gl_InstanceID (see transformBind in transform.h)
+layout(location = 6) in uint aVisibleList;  // constant per draw, 1 + first entry of the instances in uVisibleTransforms or 0 (see gpuCullBind in gpuculling.h)
+
+/* per frame data shared by all programs (see FrameDataGpu in frame.h) */
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPosition;
+    float uTime;
+};
+
+/* per object transforms of the frame, TRANSFORM_TEXELS texels each (see TransformGpu in transform.h) */
+struct Transform
+{
+    mat4 model;
+    mat3 normal;          // transpose(inverse(model))
+    mat4 modelViewProj;
+};
+
+uniform samplerBuffer uTransforms;
+
+Transform transformFetch(uint id)
+{
+    int texel = int(id) * 11;
+    Transform transform;
+    transform.model = mat4(texelFetch(uTransforms, texel), texelFetch(uTransforms, texel + 1),
+                           texelFetch(uTransforms, texel + 2), texelFetch(uTransforms, texel + 3));
+    transform.normal = mat3(texelFetch(uTransforms, texel + 4).xyz, texelFetch(uTransforms, texel + 5).xyz,
+                            texelFetch(uTransforms, texel + 6).xyz);
+    transform.modelViewProj = mat4(texelFetch(uTransforms, texel + 7), texelFetch(uTransforms, texel + 8),
+                                   texelFetch(uTransforms, texel + 9), texelFetch(uTransforms, texel + 10));
+    return transform;
+}
+
+/* transform ids of the instances that passed the GPU culling pass, the indirect draws of a group cover only those */
+uniform usamplerBuffer uVisibleTransforms;
+
+uint transformId()
+{
+    return aVisibleList == 0u ? aTransformId + uint(gl_InstanceID)
+                              : texelFetch(uVisibleTransforms, int(aVisibleList) - 1 + gl_InstanceID).r;
+}
+
+const float PI = 3.14159265;
+const float YAW_STEPS = 8.0;    // IMPOSTOR_YAW_STEPS
+const float PITCH_STEPS = 4.0;  // IMPOSTOR_PITCH_STEPS
+
+/* the depth pre-pass draws impostors with this program as well */
+invariant gl_Position;
+
+out vec3 tUV;                   // atlas coordinates and layer
+flat out mat3 tNormalMatrix;
+
+void main(void)
+{
+    Transform transform = transformFetch(transformId());
+    vec3 center = vec3(transform.model * vec4(aCenter, 1.0));
+    mat3 rotation = mat3(transform.model);
+
+    /* direction to the camera in object space (rotation and uniform scale only), views below the horizon use the
+     * horizon tiles */
+    vec3 view = normalize(transpose(rotation) * (uCameraPosition - center));
+    float yawStep = 2.0 * PI / YAW_STEPS;
+    float pitchStep = 0.5 * PI / (PITCH_STEPS - 1.0);
+    float yawIndex = mod(floor(atan(view.x, view.z) / yawStep + 0.5), YAW_STEPS);
+    float pitchIndex = min(floor(asin(clamp(view.y, 0.0, 1.0)) / pitchStep + 0.5), PITCH_STEPS - 1.0);
+
+    /* image axes of the tile (see impostorView in impostor.cpp) */
+    float yaw = yawIndex * yawStep;
+    float pitch = pitchIndex * pitchStep;
+    vec3 right = vec3(cos(yaw), 0.0, -sin(yaw));
+    vec3 up = vec3(-sin(pitch) * sin(yaw), cos(pitch), -sin(pitch) * cos(yaw));
+
+    vec3 position = center + rotation * (aCorner.z * (aCorner.x * right + aCorner.y * up));
+    gl_Position = uViewProj * vec4(position, 1.0);
+
+    tUV = vec3((yawIndex + 0.5 + 0.5 * aCorner.x) / YAW_STEPS, (pitchIndex + 0.5 + 0.5 * aCorner.y) / PITCH_STEPS, aLayer.x);
+    tNormalMatrix = transform.normal;
+}
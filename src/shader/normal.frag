@@ -4,7 +4,16 @@ in vec3 tNormal;
 in vec3 tFragPos;
 out vec4 FragColor;
 
-uniform vec3 uViewPos;
+/* per frame data shared by all programs (see FrameDataGpu in frame.h) */
+layout(std140) uniform FrameData
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPosition;
+    float uTime;
+};
+
 uniform bool isFlag;
 
 void main(void)
@@ -12,7 +21,7 @@ void main(void)
     vec3 normal = normalize(tNormal);
 
     /* for flag check if normal is facing the camera */
-    vec3 viewDir = normalize(uViewPos - tFragPos);
+    vec3 viewDir = normalize(uCameraPosition - tFragPos);
     if (isFlag && dot(normal, viewDir) < 0.0)
     {
         normal = -normal;